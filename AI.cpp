@@ -3,6 +3,7 @@
 #include "Board.h"
 #include "SuperPiece.h"
 #include "TreeSearch.h"
+#include "SearchThread.h"
 
 AI::AI()
 {
@@ -16,7 +17,25 @@ AI::AI()
   //the history table this AI is using (NULL for none)
   //(history table is NULL for no history table, so doesn't need to be a seperate setting)
   hist=new HistTable();
-  history_reset=15;
+  history_reset=0;
+  
+  //a transposition table that's kept between moves
+  tt_size=16;
+  tt=new TransTable(tt_size);
+  last_search_moves=0;
+  root_set=false;
+  root_moves=0;
+  
+  //no opening book unless given one
+  book=NULL;
+  strncpy(book_file,"",BUFFER_SIZE);
+  
+  //no endgame tables unless given some
+  tb=NULL;
+  strncpy(tb_path,"",BUFFER_SIZE);
+  syzygy=NULL;
+  strncpy(syzygy_path,"",BUFFER_SIZE);
+  syzygy_search=false;
   
   //whether or not to use the entropy (branching-factor) heuristic
   entropy_heuristic=false;
@@ -36,8 +55,42 @@ AI::AI()
   //how long the time should be if it is limited
   timeout=30.0;
   
+  //no game clock unless asked for; just the timeout per move
+  clock_time=0;
+  clock_increment=0;
+  clock_moves=0;
+  clock_remaining=0;
+  clock_moves_made=0;
+  
   //how many nodes to keep after forward-pruning (0 for no forward pruning)
   beam_width=0;
+  
+  //just the best line unless analysing
+  multipv=1;
+  
+  //forcing moves get searched deeper, a few times per line
+  extensions=4;
+  singular_extensions=false;
+  
+  //pruning near the depth limit by what the position is worth as it stands (points per ply left)
+  futility_margin=1.5;
+  reverse_futility_margin=1.0;
+  razor_margin=3.0;
+  
+  //a draw counts as this much of a loss (in points), so we play on when it's even
+  contempt=9.0;
+  
+  //stats are counted either way, but only printed when asked for
+  search_stats=false;
+  TreeSearch::clear_stats(&stats);
+  stats.output=NULL;
+  stats.iteration_hook=NULL;
+  stats.hook_data=NULL;
+  
+  //no thinking on the opponent's time unless asked for
+  ponder=false;
+  ponderer=NULL;
+  have_ponder_result=false;
 }
 
 AI::~AI()
@@ -52,7 +105,12 @@ void AI::output_ts_settings()
   printf("ab_prune=%s\n",ab_prune? "true" : "false");
   printf("\n");
   printf("history=%s\n",(hist==NULL)? "false" : "true");
-  printf("history_reset=%i                   (disregarded if history is false)\n",history_reset);
+  printf("history_reset=%i                   (disregarded if history is false; 0 for never, values are aged every move anyway)\n",history_reset);
+  printf("tt_size=%i                         (megabytes of transposition table, kept between moves; 0 for none)\n",tt_size);
+  printf("book_file=%s                       (an opening book made with --make-book; empty for none)\n",book_file);
+  printf("tb_path=%s                         (a directory of endgame tables made with --make-tables; empty for none)\n",tb_path);
+  printf("syzygy_path=%s                     (directories of Syzygy tables, separated by ':'; empty for none)\n",syzygy_path);
+  printf("syzygy_search=%s                   (disregarded if syzygy_path is empty; probe the tables during searches too, not just at the root)\n",syzygy_search? "true" : "false");
   printf("\n");
   printf("entropy_heuristic=%s\n",entropy_heuristic? "true" : "false");
   printf("distance_sum=%s                    (disregarded if entropy_heuristic is false)\n",distance_sum? "true" : "false");
@@ -65,13 +123,103 @@ void AI::output_ts_settings()
   printf("\n");
   printf("time_limit=%s\n",time_limit? "true" : "false");
   printf("timeout=%lf                        (disregarded if time_limit is false; units of seconds)\n",timeout);
+  printf("clock_time=%lf                     (disregarded if time_limit is false; 0 to use timeout for every move, else the seconds on a game clock)\n",clock_time);
+  printf("clock_increment=%lf                (disregarded if clock_time is 0; seconds added to the clock after every move)\n",clock_increment);
+  printf("clock_moves=%i                     (disregarded if clock_time is 0; moves before the clock gets clock_time more, 0 for the whole game)\n",clock_moves);
   printf("\n");
   printf("beam_width=%i                      (disregarded if entropy_heuristic is true; 0 for no forward pruning, else how many children should left after pruning)\n",beam_width);
+  printf("multipv=%i                         (how many of the best moves to find exact scores and lines for, for analysis; 1 for just the best)\n",multipv);
+  printf("extensions=%i                      (how many times a line can be searched a ply deeper for a check, only reply or recapture; 0 for never)\n",extensions);
+  printf("futility_margin=%lf                (disregarded if ab_prune is false; skip quiet moves within 3 plies of the depth limit when this much gain per ply wouldn't reach alpha; 0 for never)\n",futility_margin);
+  printf("reverse_futility_margin=%lf        (disregarded if ab_prune is false; cut a node within 3 plies of the depth limit that's this much per ply past beta; 0 for never)\n",reverse_futility_margin);
+  printf("razor_margin=%lf                   (disregarded if ab_prune is false or qs_depth is 0; try quiescent search first within 2 plies of the depth limit when this much per ply short of alpha; 0 for never)\n",razor_margin);
+  printf("contempt=%lf                       (disregarded if entropy_heuristic is true; how much worse than even a draw is for us, in points; 0 to take draws as even)\n",contempt);
+  printf("singular_extensions=%s             (disregarded if extensions is 0 or tt_size is 0; also extend a move that's much better than the rest)\n",singular_extensions? "true" : "false");
+  printf("\n");
+  printf("search_stats=%s                    (print a line of node counts, cutoffs, etc. after every search iteration)\n",search_stats? "true" : "false");
+  printf("ponder=%s                          (think on the opponent's time, about the reply we expect)\n",ponder? "true" : "false");
   printf("\n\n");
 }
 
-void AI::set_ts_option(char *variable, char *value, int buffer_size)
+//output current tree search settings as UCI option declarations
+//UCI has no floating point option type, so weights are strings (set_ts_option parses them either way)
+//the time settings are left out since the GUI gives us our time with every go command
+void AI::output_uci_options(FILE *outfile)
 {
+  fprintf(outfile,"option name max_depth type spin default %i min 1 max 100\n",max_depth);
+  fprintf(outfile,"option name qs_depth type spin default %i min 0 max 100\n",qs_depth);
+  fprintf(outfile,"option name ab_prune type check default %s\n",ab_prune? "true" : "false");
+  fprintf(outfile,"option name history type check default %s\n",(hist==NULL)? "false" : "true");
+  fprintf(outfile,"option name history_reset type spin default %i min 0 max 1000\n",history_reset);
+  fprintf(outfile,"option name tt_size type spin default %i min 0 max 4096\n",tt_size);
+  fprintf(outfile,"option name book_file type string default %s\n",(strlen(book_file)>0)? book_file : "<empty>");
+  fprintf(outfile,"option name tb_path type string default %s\n",(strlen(tb_path)>0)? tb_path : "<empty>");
+  fprintf(outfile,"option name syzygy_path type string default %s\n",(strlen(syzygy_path)>0)? syzygy_path : "<empty>");
+  fprintf(outfile,"option name syzygy_search type check default %s\n",syzygy_search? "true" : "false");
+  fprintf(outfile,"option name entropy_heuristic type check default %s\n",entropy_heuristic? "true" : "false");
+  fprintf(outfile,"option name distance_sum type check default %s\n",distance_sum? "true" : "false");
+  fprintf(outfile,"option name heur_pawn_additions type check default %s\n",heur_pawn_additions? "true" : "false");
+  fprintf(outfile,"option name heur_position_additions type check default %s\n",heur_position_additions? "true" : "false");
+  fprintf(outfile,"option name enemy_weight type string default %lf\n",enemy_weight);
+  fprintf(outfile,"option name owned_weight type string default %lf\n",owned_weight);
+  fprintf(outfile,"option name beam_width type spin default %i min 0 max 1000\n",beam_width);
+  //GUIs look for this one by its standard name (setting names aren't case sensitive)
+  fprintf(outfile,"option name MultiPV type spin default %i min 1 max %i\n",multipv,STATS_MAX_LINES);
+  fprintf(outfile,"option name extensions type spin default %i min 0 max 100\n",extensions);
+  fprintf(outfile,"option name singular_extensions type check default %s\n",singular_extensions? "true" : "false");
+  fprintf(outfile,"option name futility_margin type string default %lf\n",futility_margin);
+  fprintf(outfile,"option name reverse_futility_margin type string default %lf\n",reverse_futility_margin);
+  fprintf(outfile,"option name razor_margin type string default %lf\n",razor_margin);
+  fprintf(outfile,"option name contempt type string default %lf\n",contempt);
+  fprintf(outfile,"option name search_stats type check default %s\n",search_stats? "true" : "false");
+}
+
+//output the settings as variable=value lines, in the format load_options reads
+//(so a dump of one configuration can be used to start another run the same way)
+void AI::output_ts_config(FILE *outfile)
+{
+  fprintf(outfile,"algorithm=%s\n",(algo==USER)? "user" : (algo==RANDOM)? "random" : "tree_search");
+  fprintf(outfile,"max_depth=%i\n",max_depth);
+  fprintf(outfile,"qs_depth=%i\n",qs_depth);
+  fprintf(outfile,"ab_prune=%s\n",ab_prune? "true" : "false");
+  fprintf(outfile,"history=%s\n",(hist==NULL)? "false" : "true");
+  fprintf(outfile,"history_reset=%i\n",history_reset);
+  fprintf(outfile,"tt_size=%i\n",tt_size);
+  fprintf(outfile,"book_file=%s\n",book_file);
+  fprintf(outfile,"tb_path=%s\n",tb_path);
+  fprintf(outfile,"syzygy_path=%s\n",syzygy_path);
+  fprintf(outfile,"syzygy_search=%s\n",syzygy_search? "true" : "false");
+  fprintf(outfile,"entropy_heuristic=%s\n",entropy_heuristic? "true" : "false");
+  fprintf(outfile,"distance_sum=%s\n",distance_sum? "true" : "false");
+  fprintf(outfile,"heur_pawn_additions=%s\n",heur_pawn_additions? "true" : "false");
+  fprintf(outfile,"heur_position_additions=%s\n",heur_position_additions? "true" : "false");
+  fprintf(outfile,"enemy_weight=%lf\n",enemy_weight);
+  fprintf(outfile,"owned_weight=%lf\n",owned_weight);
+  fprintf(outfile,"time_limit=%s\n",time_limit? "true" : "false");
+  fprintf(outfile,"timeout=%lf\n",timeout);
+  fprintf(outfile,"clock_time=%lf\n",clock_time);
+  fprintf(outfile,"clock_increment=%lf\n",clock_increment);
+  fprintf(outfile,"clock_moves=%i\n",clock_moves);
+  fprintf(outfile,"beam_width=%i\n",beam_width);
+  fprintf(outfile,"multipv=%i\n",multipv);
+  fprintf(outfile,"extensions=%i\n",extensions);
+  fprintf(outfile,"singular_extensions=%s\n",singular_extensions? "true" : "false");
+  fprintf(outfile,"futility_margin=%lf\n",futility_margin);
+  fprintf(outfile,"reverse_futility_margin=%lf\n",reverse_futility_margin);
+  fprintf(outfile,"razor_margin=%lf\n",razor_margin);
+  fprintf(outfile,"contempt=%lf\n",contempt);
+  fprintf(outfile,"search_stats=%s\n",search_stats? "true" : "false");
+  fprintf(outfile,"ponder=%s\n",ponder? "true" : "false");
+}
+
+//set an option by name; returns false (with an error on stderr, leaving the setting alone) for an unknown name or a bad value
+bool AI::set_ts_option(char *variable, char *value, int buffer_size)
+{
+  //file names are the one thing that keeps its case
+  char original_value[BUFFER_SIZE];
+  strncpy(original_value,value,BUFFER_SIZE-1);
+  original_value[BUFFER_SIZE-1]='\0';
+  
   //first lower case both the variable and value
   for(int n=0; n<buffer_size && variable[n]!='\0'; n++)
   {
@@ -82,78 +230,453 @@ void AI::set_ts_option(char *variable, char *value, int buffer_size)
     value[n]=tolower(value[n]);
   }
   
-  if(!strncmp(variable,"max_depth",buffer_size))
+  //whether the variable is one we know, and whether the value made sense for it
+  bool known=true;
+  bool valid=true;
+  
+  if(!strncmp(variable,"algorithm",buffer_size))
+  {
+    if(!strncmp(value,"user",buffer_size))
+    {
+      algo=USER;
+    }
+    else if(!strncmp(value,"random",buffer_size))
+    {
+      algo=RANDOM;
+    }
+    else if(!strncmp(value,"tree_search",buffer_size))
+    {
+      algo=TREE_SEARCH;
+    }
+    else
+    {
+      valid=false;
+    }
+  }
+  else if(!strncmp(variable,"max_depth",buffer_size))
   {
-    max_depth=atoi(value);
+    valid=read_int(value,1,&max_depth);
   }
   else if(!strncmp(variable,"qs_depth",buffer_size))
   {
-    qs_depth=atoi(value);
+    valid=read_int(value,0,&qs_depth);
   }
   else if(!strncmp(variable,"ab_prune",buffer_size))
   {
-    ab_prune=string_to_bool(value,buffer_size);
+    valid=read_bool(value,&ab_prune);
   }
   else if(!strncmp(variable,"history",buffer_size))
   {
-    //remove any existing history
-    if(hist!=NULL)
+    bool use_history;
+    valid=read_bool(value,&use_history);
+    if(valid)
     {
-      delete hist;
+      //remove any existing history
+      if(hist!=NULL)
+      {
+        delete hist;
+      }
+      
+      //if we're being asked to make some history, do that
+      if(use_history)
+      {
+        hist=new HistTable();
+      }
+      //if not, set a placeholder so we know we're not using history
+      else
+      {
+        hist=NULL;
+      }
     }
-    
-    //if we're being asked to make some history, do that
-    if(string_to_bool(value,buffer_size))
+  }
+  else if(!strncmp(variable,"history_reset",buffer_size))
+  {
+    valid=read_int(value,0,&history_reset);
+  }
+  else if(!strncmp(variable,"tt_size",buffer_size))
+  {
+    valid=read_int(value,0,&tt_size);
+    if(valid)
+    {
+      if(tt!=NULL)
+      {
+        delete tt;
+      }
+      tt=(tt_size>0)? new TransTable(tt_size) : NULL;
+    }
+  }
+  //an empty name (or UCI's <empty>) means no book
+  else if(!strncmp(variable,"book_file",buffer_size))
+  {
+    if(strlen(original_value)==0 || !strcmp(original_value,"<empty>"))
     {
-      hist=new HistTable();
+      if(book!=NULL)
+      {
+        delete book;
+        book=NULL;
+      }
+      strncpy(book_file,"",BUFFER_SIZE);
     }
-    //if not, set a placeholder so we know we're not using history
     else
     {
-      hist=NULL;
+      OpeningBook *new_book=new OpeningBook();
+      valid=new_book->open(original_value);
+      if(valid)
+      {
+        if(book!=NULL)
+        {
+          delete book;
+        }
+        book=new_book;
+        strncpy(book_file,original_value,BUFFER_SIZE);
+      }
+      else
+      {
+        delete new_book;
+      }
     }
   }
-  else if(!strncmp(variable,"history_reset",buffer_size))
+  //likewise an empty directory means no tables
+  else if(!strncmp(variable,"tb_path",buffer_size))
+  {
+    if(strlen(original_value)==0 || !strcmp(original_value,"<empty>"))
+    {
+      if(tb!=NULL)
+      {
+        delete tb;
+        tb=NULL;
+      }
+      strncpy(tb_path,"",BUFFER_SIZE);
+    }
+    else
+    {
+      Tablebase *new_tb=new Tablebase();
+      valid=new_tb->open(original_value);
+      if(valid)
+      {
+        if(tb!=NULL)
+        {
+          delete tb;
+        }
+        tb=new_tb;
+        strncpy(tb_path,original_value,BUFFER_SIZE);
+      }
+      else
+      {
+        delete new_tb;
+      }
+    }
+  }
+  else if(!strncmp(variable,"syzygy_path",buffer_size))
+  {
+    if(strlen(original_value)==0 || !strcmp(original_value,"<empty>"))
+    {
+      if(syzygy!=NULL)
+      {
+        delete syzygy;
+        syzygy=NULL;
+      }
+      strncpy(syzygy_path,"",BUFFER_SIZE);
+    }
+    else
+    {
+      Syzygy *new_syzygy=new Syzygy();
+      valid=new_syzygy->open(original_value);
+      if(valid)
+      {
+        if(syzygy!=NULL)
+        {
+          delete syzygy;
+        }
+        syzygy=new_syzygy;
+        strncpy(syzygy_path,original_value,BUFFER_SIZE);
+      }
+      else
+      {
+        delete new_syzygy;
+      }
+    }
+  }
+  else if(!strncmp(variable,"syzygy_search",buffer_size))
   {
-    history_reset=atoi(value);
+    valid=read_bool(value,&syzygy_search);
   }
   else if(!strncmp(variable,"entropy_heuristic",buffer_size))
   {
-    entropy_heuristic=string_to_bool(value,buffer_size);
+    valid=read_bool(value,&entropy_heuristic);
   }
   //NOTE: THIS ONLY APPLIES WHEN ENTROPY_HEURISTIC IS TRUE
   else if(!strncmp(variable,"distance_sum",buffer_size))
   {
-    distance_sum=string_to_bool(value,buffer_size);
+    valid=read_bool(value,&distance_sum);
   }
   else if(!strncmp(variable,"heur_pawn_additions",buffer_size))
   {
-    heur_pawn_additions=string_to_bool(value,buffer_size);
+    valid=read_bool(value,&heur_pawn_additions);
   }
   else if(!strncmp(variable,"heur_position_additions",buffer_size))
   {
-    heur_position_additions=string_to_bool(value,buffer_size);
+    valid=read_bool(value,&heur_position_additions);
   }
   else if(!strncmp(variable,"enemy_weight",buffer_size))
   {
-    enemy_weight=atof(value);
+    valid=read_double(value,0,&enemy_weight);
   }
   else if(!strncmp(variable,"owned_weight",buffer_size))
   {
-    owned_weight=atof(value);
+    valid=read_double(value,0,&owned_weight);
   }
   else if(!strncmp(variable,"time_limit",buffer_size))
   {
-    time_limit=string_to_bool(value,buffer_size);
+    valid=read_bool(value,&time_limit);
   }
   else if(!strncmp(variable,"timeout",buffer_size))
   {
-    timeout=atof(value);
+    valid=read_double(value,0,&timeout);
+  }
+  //setting the clock starts it over
+  else if(!strncmp(variable,"clock_time",buffer_size))
+  {
+    valid=read_double(value,0,&clock_time);
+    if(valid)
+    {
+      clock_remaining=clock_time;
+      clock_moves_made=0;
+    }
+  }
+  else if(!strncmp(variable,"clock_increment",buffer_size))
+  {
+    valid=read_double(value,0,&clock_increment);
+  }
+  else if(!strncmp(variable,"clock_moves",buffer_size))
+  {
+    valid=read_int(value,0,&clock_moves);
   }
   else if(!strncmp(variable,"beam_width",buffer_size))
   {
-    beam_width=atoi(value);
+    int width;
+    valid=read_int(value,0,&width);
+    if(valid)
+    {
+      beam_width=width;
+    }
+  }
+  else if(!strncmp(variable,"multipv",buffer_size))
+  {
+    int lines;
+    valid=read_int(value,1,&lines) && lines<=STATS_MAX_LINES;
+    if(valid)
+    {
+      multipv=lines;
+    }
+  }
+  else if(!strncmp(variable,"extensions",buffer_size))
+  {
+    valid=read_int(value,0,&extensions);
+  }
+  else if(!strncmp(variable,"singular_extensions",buffer_size))
+  {
+    valid=read_bool(value,&singular_extensions);
+  }
+  else if(!strncmp(variable,"futility_margin",buffer_size))
+  {
+    valid=read_double(value,0,&futility_margin);
+  }
+  else if(!strncmp(variable,"reverse_futility_margin",buffer_size))
+  {
+    valid=read_double(value,0,&reverse_futility_margin);
+  }
+  else if(!strncmp(variable,"razor_margin",buffer_size))
+  {
+    valid=read_double(value,0,&razor_margin);
+  }
+  else if(!strncmp(variable,"contempt",buffer_size))
+  {
+    valid=read_double(value,-100,&contempt);
+  }
+  else if(!strncmp(variable,"search_stats",buffer_size))
+  {
+    valid=read_bool(value,&search_stats);
+  }
+  else if(!strncmp(variable,"ponder",buffer_size))
+  {
+    valid=read_bool(value,&ponder);
+  }
+  else
+  {
+    known=false;
+  }
+  
+  if(!known)
+  {
+    fprintf(stderr,"Err: Unknown setting %s\n",variable);
+    return false;
+  }
+  if(!valid)
+  {
+    fprintf(stderr,"Err: Invalid value \"%s\" for setting %s; it was left alone\n",value,variable);
+    return false;
+  }
+  
+  //values in the transposition table came from the old settings, if this is one that changes what positions are worth
+  //(limits, output, the book and so on don't, and under UCI they're set all the time)
+  const char *value_settings[]={"qs_depth","tb_path","syzygy_path","syzygy_search","entropy_heuristic","distance_sum","heur_pawn_additions","heur_position_additions",
+                                "enemy_weight","owned_weight","beam_width","extensions","singular_extensions","futility_margin","reverse_futility_margin","razor_margin","contempt",NULL};
+  for(int i=0; tt!=NULL && value_settings[i]!=NULL; i++)
+  {
+    if(!strncmp(variable,value_settings[i],buffer_size))
+    {
+      tt->clear();
+      break;
+    }
+  }
+  return true;
+}
+
+//read a whole number of at least minimum into result; false (leaving result alone) if the string isn't one
+bool AI::read_int(const char *string, int minimum, int *result)
+{
+  char *end;
+  long n=strtol(string,&end,10);
+  if(end==string || *end!='\0' || n<minimum)
+  {
+    return false;
+  }
+  *result=n;
+  return true;
+}
+
+//read a number of at least minimum into result; false (leaving result alone) if the string isn't one
+bool AI::read_double(const char *string, double minimum, double *result)
+{
+  char *end;
+  double n=strtod(string,&end);
+  if(end==string || *end!='\0' || n<minimum)
+  {
+    return false;
+  }
+  *result=n;
+  return true;
+}
+
+//read true/false (or t/f, yes/no, 1/0) into result; false (leaving result alone) if the string is anything else
+bool AI::read_bool(const char *string, bool *result)
+{
+  if(!strcmp(string,"true") || !strcmp(string,"t") || !strcmp(string,"yes") || !strcmp(string,"1"))
+  {
+    *result=true;
+    return true;
+  }
+  if(!strcmp(string,"false") || !strcmp(string,"f") || !strcmp(string,"no") || !strcmp(string,"0"))
+  {
+    *result=false;
+    return true;
   }
+  return false;
+}
+
+//set an option from an option=value string
+bool AI::set_ts_assignment(const char *assignment)
+{
+  const char *eq_sign=strchr(assignment,'=');
+  if(eq_sign==NULL)
+  {
+    fprintf(stderr,"Err: Expected variable=value, got \"%s\"\n",assignment);
+    return false;
+  }
+  
+  //set_ts_option changes its arguments, so these are copies
+  char variable[BUFFER_SIZE];
+  char value[BUFFER_SIZE];
+  size_t variable_len=eq_sign-assignment;
+  if(variable_len>=BUFFER_SIZE)
+  {
+    variable_len=BUFFER_SIZE-1;
+  }
+  strncpy(variable,assignment,variable_len);
+  variable[variable_len]='\0';
+  
+  //spaces around the = don't matter
+  while(variable_len>0 && isspace(variable[variable_len-1]))
+  {
+    variable_len--;
+    variable[variable_len]='\0';
+  }
+  const char *value_start=eq_sign+1;
+  while(isspace(*value_start))
+  {
+    value_start++;
+  }
+  strncpy(value,value_start,BUFFER_SIZE-1);
+  value[BUFFER_SIZE-1]='\0';
+  size_t value_len=strlen(value);
+  while(value_len>0 && isspace(value[value_len-1]))
+  {
+    value_len--;
+    value[value_len]='\0';
+  }
+  
+  return set_ts_option(variable,value,BUFFER_SIZE);
+}
+
+//set options from a file of option=value lines, the same as would be typed at the prompt
+bool AI::load_options(const char *fname)
+{
+  FILE *fp=fopen(fname,"r");
+  if(fp==NULL)
+  {
+    fprintf(stderr,"Err: Could not open options file %s\n",fname);
+    return false;
+  }
+  
+  //every line is checked, so all the problems in a file get reported at once
+  bool valid=true;
+  int line_number=0;
+  char line[BUFFER_SIZE];
+  while(fgets(line,BUFFER_SIZE,fp)!=NULL)
+  {
+    line_number++;
+    
+    //trim the newline and any trailing whitespace
+    size_t line_len=strlen(line);
+    while(line_len>0 && isspace(line[line_len-1]))
+    {
+      line_len--;
+      line[line_len]='\0';
+    }
+    
+    if(line_len==0 || line[0]=='#')
+    {
+      continue;
+    }
+    
+    if(!set_ts_assignment(line))
+    {
+      fprintf(stderr,"Err: (line %i of options file %s)\n",line_number,fname);
+      valid=false;
+    }
+  }
+  fclose(fp);
+  
+  return valid;
+}
+
+//forget everything learned from earlier searches
+void AI::clear_search_state()
+{
+  if(hist!=NULL)
+  {
+    delete hist;
+    hist=new HistTable();
+  }
+  if(tt!=NULL)
+  {
+    tt->clear();
+  }
+  killers.clear();
+  moves_lock.lock();
+  last_search_moves=0;
+  moves_lock.unlock();
 }
 
 bool AI::string_to_bool(char *string, int buffer_size)
@@ -273,6 +796,10 @@ void AI::configure(int player_id)
           //set the internal variable!
           set_ts_option(variable,value,BUFFER_SIZE);
         }
+        else
+        {
+          printf("Err: Expected variable=new_value, try again\n");
+        }
       }
     }
   }
@@ -372,7 +899,24 @@ bool AI::handle_load_save(const char *input_buffer, Board *board, int player_id)
   {
     //save functionality using board save_to_file method
     FILE *fp=fopen(arg_buf,"w");
-    board->save_to_file(fp,player_id);
+    if(fp==NULL)
+    {
+      fprintf(stderr,"Warn: Could not open file %s for writing; not saved!\n",arg_buf);
+      return true;
+    }
+    
+    //a .fen file gets a single FEN line instead
+    size_t arg_len=strlen(arg_buf);
+    if(arg_len>4 && !strcmp(arg_buf+arg_len-4,".fen"))
+    {
+      char fen[FEN_SIZE];
+      board->to_fen(player_id,fen);
+      fprintf(fp,"%s\n",fen);
+    }
+    else
+    {
+      board->save_to_file(fp,player_id);
+    }
     fclose(fp);
     
 #ifdef DEBUG
@@ -430,8 +974,8 @@ _Move *AI::user_move(Board *board, int player_id)
       printf("Move Selection (expected format <from file><from rank><to file><to rank>)\n");
       printf("for example a2a3 would move from location a,2 to location a,3\n");
       printf("quit or q to quit\n");
-      printf("save or s to save; save <filename.bst>\n");
-      printf("load or l to load; load <filename.bst>\n");
+      printf("save or s to save; save <filename.bst> (or <filename.fen> for FEN)\n");
+      printf("load or l to load; load <filename.bst> (or <filename.fen> for FEN)\n");
       printf("Enter move: ");
     }
     skip_prompt=false;
@@ -533,11 +1077,278 @@ _Move *AI::user_move(Board *board, int player_id)
 
 void AI::remember_move(_Move *m)
 {
+  moves_lock.lock();
   moves.push_back(m);
+  moves_lock.unlock();
+}
+
+//forget the whole movement history (e.g. when a new position is set up)
+void AI::clear_moves()
+{
+  moves_lock.lock();
+  for(size_t i=0; i<moves.size(); i++)
+  {
+    NodeArena::node_free(moves[i]);
+  }
+  moves.clear();
+  //NOTE: last_search_moves is left alone; UCI sends the whole game again before every move, and the killers still fit it
+  //(a history that comes back shorter clears them, see search_move, and a new game clears them with clear_search_state)
+  moves_lock.unlock();
+}
+
+//run a tree search with this AI's settings, but the limits given here
+//(this is what ai_move uses, and what protocol front-ends use since they get their limits from elsewhere)
+_Move *AI::search_move(Board *board, int player_id, int depth_limit, bool time_limited, double time_remaining, double increment, int moves_to_go, bool fixed_time, SearchClock *clock)
+{
+  //which of the remembered moves lead up to board, and whether a move that isn't remembered yet comes after them (see set_search_reply)
+  moves_lock.lock();
+  bool have_reply=root_set;
+  size_t history=root_set? root_moves : moves.size();
+  _Move reply=root_reply;
+  root_set=false;
+  moves_lock.unlock();
+  
+  //a book move doesn't need a search at all
+  if(book!=NULL)
+  {
+    _Move *book_move=book->probe(board,player_id);
+    if(book_move!=NULL)
+    {
+      TreeSearch::clear_stats(&stats);
+      return book_move;
+    }
+  }
+  
+  //and neither does an ending the Syzygy tables cover
+  //(as long as the WDL tables agree the move keeps the result; if they don't, something's wrong with a table, and a search is safer)
+  if(syzygy!=NULL && !entropy_heuristic)
+  {
+    _Move *tb_move=syzygy->root_move(board,player_id);
+    if(tb_move!=NULL)
+    {
+      int wdl;
+      int reply_wdl;
+      Board *after=new Board(board);
+      after->apply_move(after->copy_move(tb_move),true);
+      if(syzygy->probe_wdl(board,player_id,&wdl) && syzygy->probe_wdl(after,!player_id,&reply_wdl) && ((wdl>0)-(wdl<0))!=((reply_wdl<0)-(reply_wdl>0)))
+      {
+        fprintf(stderr,"Warn: Syzygy tables disagree with themselves about a move (WDL %i, then %i for the reply), searching instead\n",wdl,reply_wdl);
+        NodeArena::node_free(tb_move);
+        tb_move=NULL;
+      }
+      delete after;
+    }
+    if(tb_move!=NULL)
+    {
+      TreeSearch::clear_stats(&stats);
+      stats.tb_hits=1;
+      return tb_move;
+    }
+  }
+  
+  //make a move accumulator to start it out based on the moves their API gives us
+  //note this builds the array in reverse order to what's given
+  //because I need to push_back as I go in tree generation
+  vector<_Move*> move_accumulator;
+  moves_lock.lock();
+  if(history>moves.size())
+  {
+    history=moves.size();
+  }
+//  for(int i=moves.size()-1; i>=0; i--) //reverse-ordered moves
+  for(size_t i=0; i<history; i++) //correctly ordered moves
+  {
+    _Move *new_move=(_Move*)(NodeArena::node_malloc(sizeof(_Move)));
+    if(new_move==NULL)
+    {
+      fprintf(stderr,"Err: Out of RAM!? (malloc failed)");
+      exit(1);
+    }
+    
+    new_move->id=moves[i]->id;
+    new_move->fromFile=moves[i]->fromFile;
+    new_move->fromRank=moves[i]->fromRank;
+    new_move->toFile=moves[i]->toFile;
+    new_move->toRank=moves[i]->toRank;
+    new_move->promoteType=moves[i]->promoteType;
+    
+    move_accumulator.push_back(new_move);
+  }
+  if(have_reply)
+  {
+    move_accumulator.push_back(board->copy_move(&reply));
+    history++;
+  }
+  
+  //killer moves are by distance from the root, and the root has moved on by however many moves were made since the last search
+  //(a shorter history than last time, from taking moves back or setting up another position, clears them)
+  killers.shift((int)(history)-(int)(last_search_moves));
+  last_search_moves=history;
+  moves_lock.unlock();
+  
+  //what the history table learned in earlier searches counts for less and less
+  if(hist!=NULL)
+  {
+    hist->age();
+  }
+  //NOTE: the move_accumulator entries are free'd during recursive calls, and so don't need to be here
+  
+  TreeSearch ts;
+  
+  //default AI player (what was entered in the AI tournament)
+//  return ts.id_minimax(board,1,3,player_id,move_accumulator,false,false,true,true,1,0.75,false,true,true,hist,12,time_remaining,increment,moves_to_go,false);
+
+  //configured AI player
+  //NOTE: weight settings and heuristic options are used in place of a heur from an enum
+  //NOTE: when fixed_time is true, time_remaining is time allocated to this move; in this case the time manager doesn't budget it
+  return ts.id_minimax(board,depth_limit,qs_depth,player_id,move_accumulator,entropy_heuristic,distance_sum,heur_pawn_additions,heur_position_additions,enemy_weight,owned_weight,ab_prune,time_limited,hist,tt,&killers,tb,syzygy_search? syzygy : NULL,beam_width,multipv,extensions,singular_extensions,futility_margin,reverse_futility_margin,razor_margin,contempt,time_remaining,increment,moves_to_go,fixed_time,clock,&stats);
+}
+
+//a guess at what player_id will play on board
+//the line from our last search is the best guess, since it was searched the deepest; when we didn't get here along it
+//this is a quick shallow search with no history and plain material weights, so it doesn't take anything away from the real search
+_Move *AI::predict_reply(Board *board, int player_id)
+{
+  //if the move just made was the start of our last search's line, that line already says what reply to expect
+  _Move *last=board->get_last_move_made();
+  if(last!=NULL && stats.line_count>0 && stats.lines[0].pv_length>=2)
+  {
+    _Move *first=&(stats.lines[0].pv[0]);
+    if(first->fromFile==last->fromFile && first->fromRank==last->fromRank && first->toFile==last->toFile && first->toRank==last->toRank && first->promoteType==last->promoteType)
+    {
+      //it's checked to be legal here all the same
+      _Move *reply=NULL;
+      TreeSearch::generate_moves(board,player_id);
+      if(TreeSearch::bring_forward(board,0,&(stats.lines[0].pv[1])))
+      {
+        reply=board->copy_move(board->get_children()[0]->get_last_move_made());
+      }
+      board->clear_children();
+      if(reply!=NULL)
+      {
+        return reply;
+      }
+    }
+  }
+  
+  vector<_Move*> move_accumulator;
+  moves_lock.lock();
+  for(size_t i=0; i<moves.size(); i++)
+  {
+    move_accumulator.push_back(board->copy_move(moves[i]));
+  }
+  moves_lock.unlock();
+  
+  return TreeSearch::id_minimax(board,2,0,player_id,move_accumulator,false,false,true,true,1,1,true,false,NULL,NULL,NULL,NULL,NULL,0,1,0,false,0,0,0,contempt,0,0,0,true,NULL,NULL);
+}
+
+//the next search's root has reply played after the moves remembered so far
+void AI::set_search_reply(_Move *reply)
+{
+  moves_lock.lock();
+  root_set=true;
+  root_moves=moves.size();
+  root_reply=*reply;
+  moves_lock.unlock();
+}
+
+//guess the opponent's reply to the move just made on board, and start searching our answer to it in the background
+void AI::start_ponder(Board *board, int player_id)
+{
+  int opponent_id=(player_id==WHITE)? BLACK : WHITE;
+  _Move *reply=predict_reply(board,opponent_id);
+  if(reply==NULL)
+  {
+    return;
+  }
+  ponder_reply=*reply;
+  have_ponder_result=false;
+  
+  Board *ponder_board=new Board(board);
+  ponder_board->apply_move(reply,true);
+  
+  printf("Pondering on %c%i%c%i as the reply...\n",(char)(reply->fromFile+'a'-1),reply->fromRank,(char)(reply->toFile+'a'-1),reply->toRank);
+  
+  if(ponderer==NULL)
+  {
+    ponderer=new SearchThread();
+  }
+  
+  //there's no limit on this; it's stopped (or given a time limit) once the opponent moves
+  //the search's output would get in the way of the opponent's prompt, so there isn't any
+  stats.output=NULL;
+  set_search_reply(reply);
+  ponderer->start(this,ponder_board,player_id,MAX_PONDER_DEPTH,false,0,0,0,true,ponder_done,this);
+  delete ponder_board;
+}
+
+//called on the ponder search's thread when it's done; the main thread picks the move up once the search is joined
+void AI::ponder_done(_Move *move, Board *root, void *done_data)
+{
+  AI *ai=(AI*)(done_data);
+  if(move!=NULL)
+  {
+    ai->ponder_result=*move;
+    ai->have_ponder_result=true;
+  }
+}
+
+//at the start of our turn, see whether the opponent played what we pondered on
+_Move *AI::finish_ponder(Board *board, int player_id, double time_remaining, double increment, int moves_to_go)
+{
+  if(ponderer==NULL || !ponderer->is_running())
+  {
+    return NULL;
+  }
+  
+  _Move *last=board->get_last_move_made();
+  bool hit=(last!=NULL) && (last->fromFile==ponder_reply.fromFile) && (last->fromRank==ponder_reply.fromRank) && (last->toFile==ponder_reply.toFile) && (last->toRank==ponder_reply.toRank) && (last->promoteType==ponder_reply.promoteType);
+  
+  //with only a depth limit there's no way to bring the search in line, so that's treated like a miss
+  if(!hit || !time_limit)
+  {
+    printf("Ponder %s; starting over...\n",hit? "hit, but there's no time limit to give it" : "miss");
+    ponderer->stop();
+    have_ponder_result=false;
+    return NULL;
+  }
+  
+  //whatever we've pondered is free; this move gets the time it would have had from now
+  //(ponderer's clock has been timing since start(), and a limit set now holds even if the search hasn't started its clock yet;
+  //otherwise the wait below could last until MAX_PONDER_DEPTH)
+  TimeManager time_manager;
+  if(clock_time>0)
+  {
+    time_manager.init(time_remaining,increment,moves_to_go);
+  }
+  else
+  {
+    time_manager.init_fixed(time_remaining);
+  }
+  SearchClock *clock=ponderer->get_clock();
+  double pondered=clock->elapsed();
+  clock->set_limit(pondered+time_manager.get_soft_limit());
+  printf("Ponder hit after %lf seconds of pondering; %lf more seconds to think...\n",pondered,time_manager.get_soft_limit());
+  
+  ponderer->wait();
+  
+  //the search printed nothing while it ran (output can't be switched on under it), so this is where its last iteration shows
+  stats.output=search_stats? stdout : NULL;
+  if(stats.output!=NULL)
+  {
+    TreeSearch::output_stats(stats.output,&stats);
+  }
+  
+  if(!have_ponder_result)
+  {
+    return NULL;
+  }
+  have_ponder_result=false;
+  return board->copy_move(&ponder_result);
 }
 
 //make a move depending on the algorithm (within the AI class) in use and the time left
-_Move *AI::ai_move(Board *board, int player_id, double time_remaining, double enemy_time_remaining)
+_Move *AI::ai_move(Board *board, int player_id, double time_remaining, double increment, int moves_to_go)
 {
   _Move *move=NULL;
   
@@ -555,52 +1366,24 @@ _Move *AI::ai_move(Board *board, int player_id, double time_remaining, double en
   }
   else if(algo==TREE_SEARCH)
   {
-    //make a move accumulator to start it out based on the moves their API gives us
-    //note this builds the array in reverse order to what's given
-    //because I need to push_back as I go in tree generation
-    vector<_Move*> move_accumulator;
-//    for(int i=moves.size()-1; i>=0; i--) //reverse-ordered moves
-    for(size_t i=0; i<moves.size(); i++) //correctly ordered moves
-    {
-      _Move *new_move=(_Move*)(malloc(sizeof(_Move)));
-      if(new_move==NULL)
-      {
-        fprintf(stderr,"Err: Out of RAM!? (malloc failed)");
-        exit(1);
-      }
-      
-      new_move->id=moves[i]->id;
-      new_move->fromFile=moves[i]->fromFile;
-      new_move->fromRank=moves[i]->fromRank;
-      new_move->toFile=moves[i]->toFile;
-      new_move->toRank=moves[i]->toRank;
-      new_move->promoteType=moves[i]->promoteType;
-      
-      move_accumulator.push_back(new_move);
-    }
-    //NOTE: the move_accumulator entries are free'd during recursive calls, and so don't need to be here
-    
-    TreeSearch ts;
-    
     //NOTE: the way a non-quiescent search is done is to set the quiescent depth limit as 0
 //    printf("AI::ai_move() debug 0.5, making tree search (id minimax) move\n");
     printf("AI is thinking (will stop when time or depth limit is reached)...\n");
-    if(time_limit)
+    if(time_limit && clock_time>0)
+    {
+      printf("Using a game clock with %lf seconds left...\n",time_remaining);
+    }
+    else if(time_limit)
     {
-      printf("Using a time limit of %lf seconds...\n",timeout);
+      printf("Using a time limit of %lf seconds...\n",time_remaining);
     }
     else
     {
       printf("Using a depth limit of %i moves ahead...\n",max_depth);
     }
     
-    //default AI player (what was entered in the AI tournament)
-//    move=ts.id_minimax(board,1,3,player_id,move_accumulator,false,false,true,true,1,0.75,false,true,true,hist,12,time_remaining,enemy_time_remaining,false);
-    
-    //configured AI player
-    //NOTE: weight settings and heuristic options are used in place of a heur from an enum
-    //NOTE: when fixed_time (last boolean argument) is true, time_remaining is time allocated to this move; in this case time heuristic is not used
-    move=ts.id_minimax(board,max_depth,qs_depth,player_id,move_accumulator,entropy_heuristic,distance_sum,heur_pawn_additions,heur_position_additions,enemy_weight,owned_weight,ab_prune,time_limit,hist,beam_width,timeout,900,true);
+    stats.output=search_stats? stdout : NULL;
+    move=search_move(board,player_id,max_depth,time_limit,time_remaining,increment,moves_to_go,(clock_time<=0),NULL);
   }
   return move;
 }
@@ -612,31 +1395,75 @@ bool AI::run(Board *board, int player_id)
   // Print out the current board state
 //  board->output_board(stdout);
   
+  //with no game clock every move just gets the timeout
+  double time_remaining=timeout;
+  int moves_to_go=0;
+  if(clock_time>0)
+  {
+    time_remaining=clock_remaining;
+    if(clock_moves>0)
+    {
+      moves_to_go=clock_moves-(clock_moves_made%clock_moves);
+    }
+  }
+  
+  //time the move so it can come off the clock
+  SearchClock move_clock;
+  move_clock.start(0,false);
+  
+  //if we were thinking on the opponent's time and they played what we expected, that search gives us our move
+  _Move *move=finish_ponder(board, player_id, time_remaining, clock_increment, moves_to_go);
+  
   //this is a "sliding window" for history table algorithms
   //it doesn't really slide so much as step, but it's still better behavior than never adjusting for early to late game
   //NOTE: if history_reset<=0, no reset ever occurs
+  //(this comes after any ponder search is done, since that uses the table)
   if((history_reset>0) && (moves.size()%history_reset==0) && hist!=NULL)
   {
     delete hist;
     hist=new HistTable();
   }
   
-  double time_remaining=900;
-  double enemy_time_remaining=900;
-  
   //make a move depending on the algorithm in use and the time left
-  _Move* move=ai_move(board, player_id, time_remaining, enemy_time_remaining);
+  if(move==NULL)
+  {
+    move=ai_move(board, player_id, time_remaining, clock_increment, moves_to_go);
+  }
+  
+  if(clock_time>0)
+  {
+    clock_remaining-=move_clock.elapsed();
+    clock_remaining+=clock_increment;
+    clock_moves_made++;
+    
+    //made it to the time control; more time
+    if(clock_moves>0 && (clock_moves_made%clock_moves)==0)
+    {
+      clock_remaining+=clock_time;
+    }
+    
+    if(algo!=USER)
+    {
+      printf("Clock has %lf seconds left\n",clock_remaining);
+    }
+  }
   
   if(move!=NULL)
   {
     //apply the move we just made to the master board copy also; but use different memory for management ease
     board->apply_move(move, true);
-    moves.push_back(board->copy_move(move));
+    remember_move(board->copy_move(move));
     
     if(algo!=USER)
     {
       printf("Move made was %c%i%c%i\n",(char)(move->fromFile+'a'-1),move->fromRank,(char)(move->toFile+'a'-1),move->toRank);
     }
+    
+    //now it's the opponent's time; use it
+    if(ponder && algo==TREE_SEARCH)
+    {
+      start_ponder(board,player_id);
+    }
   }
   else
   {
@@ -649,16 +1476,44 @@ bool AI::run(Board *board, int player_id)
 //This function is run once, after your last turn.
 void AI::end()
 {
+  //nothing should be searching once we're done
+  if(ponderer!=NULL)
+  {
+    ponderer->stop();
+    delete ponderer;
+    ponderer=NULL;
+  }
+  
   if(hist!=NULL)
   {
     delete hist;
     hist=NULL;
   }
+  if(tt!=NULL)
+  {
+    delete tt;
+    tt=NULL;
+  }
+  if(book!=NULL)
+  {
+    delete book;
+    book=NULL;
+  }
+  if(tb!=NULL)
+  {
+    delete tb;
+    tb=NULL;
+  }
+  if(syzygy!=NULL)
+  {
+    delete syzygy;
+    syzygy=NULL;
+  }
   
   //clear out the moves vector
   for(size_t i=0; i<moves.size(); i++)
   {
-    free(moves[i]);
+    NodeArena::node_free(moves[i]);
   }
   moves.resize(0);
 }
@@ -6,12 +6,24 @@
 #include <string.h>
 #include <unistd.h>
 #include <poll.h>
+#include <mutex>
 #include "Board.h"
+#include "SearchStats.h"
+#include "TransTable.h"
+#include "KillerTable.h"
+#include "OpeningBook.h"
+#include "Tablebase.h"
+#include "Syzygy.h"
 
 #define BUFFER_SIZE 1024
+//how deep a ponder search (which has no limit until the opponent moves) is allowed to look
+#define MAX_PONDER_DEPTH 100
 
 using namespace std;
 
+class SearchClock;
+class SearchThread;
+
 ///The class implementing gameplay logic.
 class AI
 {
@@ -23,6 +35,8 @@ private:
   
   //a move history
   vector <_Move*> moves;
+  //a search in the background reads this when it starts, so changes to it are made under this lock
+  mutex moves_lock;
   
   //treesearch settings
   int max_depth;
@@ -32,8 +46,34 @@ private:
   //the history table this AI is using (NULL for none)
   HistTable *hist;
   //number of moves before history gets cleared out (0 for never clear)
+  //(values are aged every search either way, so this isn't needed to keep old moves from counting forever)
   int history_reset;
   
+  //the transposition table (NULL for none) and its size in megabytes; this is kept between moves
+  TransTable *tt;
+  int tt_size;
+  //killer moves, also kept between moves; and how many moves had been made at the last search, to know how far to shift them
+  KillerTable killers;
+  size_t last_search_moves;
+  //set by set_search_reply for the next search: how many of the remembered moves come before its root, and the move after them
+  //(root_set is false when there isn't one)
+  bool root_set;
+  size_t root_moves;
+  _Move root_reply;
+  
+  //the opening book (NULL for none) and the file it came from (empty for none)
+  OpeningBook *book;
+  char book_file[BUFFER_SIZE];
+  
+  //endgame tables (NULL for none) and the directory they're in (empty for none)
+  Tablebase *tb;
+  char tb_path[BUFFER_SIZE];
+  //Syzygy tables (NULL for none) and the directories they're in (empty for none)
+  Syzygy *syzygy;
+  char syzygy_path[BUFFER_SIZE];
+  //whether the Syzygy tables are probed during searches too, not just at the root (off until the tables have passed --verify-syzygy)
+  bool syzygy_search;
+  
   //whether or not to use the entropy (branching-factor) heuristic
   bool entropy_heuristic;
   //whether or not to use the alternate entropy heuristic (sum of manhatten distances of all moves)
@@ -53,11 +93,60 @@ private:
   //how long the time should be if it is limited (in seconds)
   double timeout;
   
+  //a game clock, in place of a fixed timeout per move (clock_time of 0 for no game clock)
+  //clock_time is in seconds, clock_increment is seconds added after every move, clock_moves is moves per time control (0 for the whole game)
+  double clock_time;
+  double clock_increment;
+  int clock_moves;
+  //how much time is left on our clock
+  double clock_remaining;
+  //how many moves we've made on this clock
+  int clock_moves_made;
+  
   //(history table is NULL for no history table, so doesn't need to be a seperate setting)
   
   //how many nodes to keep after forward-pruning (0 for no forward pruning)
   unsigned int beam_width;
   
+  //how many of the best moves to find exact values and lines for (1 for just the best)
+  unsigned int multipv;
+  
+  //how many times a line can be searched a ply deeper for a forcing move (0 for no extensions),
+  //and whether a move much better than the others counts as one (needs a transposition table)
+  int extensions;
+  bool singular_extensions;
+  
+  //margins for futility pruning, reverse futility pruning and razoring near the depth limit (points per ply left; 0 for none of that kind)
+  double futility_margin;
+  double reverse_futility_margin;
+  double razor_margin;
+  
+  //how much worse than even a draw counts for us (in points; negative to go looking for draws)
+  double contempt;
+  
+  //whether or not to print search stats after every iteration
+  bool search_stats;
+  //counts from the most recent search
+  _SearchStats stats;
+  
+  //whether to think on the opponent's time (see start_ponder)
+  bool ponder;
+  //the search that runs on the opponent's time (NULL until the first one)
+  SearchThread *ponderer;
+  //the reply we're pondering on, and the move the ponder search found (if it finished on its own)
+  _Move ponder_reply;
+  _Move ponder_result;
+  bool have_ponder_result;
+  
+  //guess the opponent's reply to the move just made on board, and start searching our answer to it in the background
+  void start_ponder(Board *board, int player_id);
+  //at the start of our turn, see whether the opponent played what we pondered on
+  //on a hit, the ponder search gets the time this move would have had and its move is returned (once it's done)
+  //on a miss (or with no ponder search) it's stopped and NULL is returned, so a normal search is needed
+  _Move *finish_ponder(Board *board, int player_id, double time_remaining, double increment, int moves_to_go);
+  //called on the ponder search's thread when it's done
+  static void ponder_done(_Move *move, Board *root, void *done_data);
+
 public:
   AI();
   ~AI();
@@ -69,13 +158,35 @@ public:
   
   //display current values of all treesearch settings
   void output_ts_settings();
+  //the same settings as UCI option declarations (the ones that make sense when a GUI is running the clock)
+  void output_uci_options(FILE *outfile);
+  
+  //the settings as variable=value lines (the format load_options reads)
+  void output_ts_config(FILE *outfile);
   
   //set an option based on user input
-  void set_ts_option(char *variable, char *value, int buffer_size);
+  //returns false for an unknown option or a value that doesn't make sense for it (the option is left alone and an error printed)
+  bool set_ts_option(char *variable, char *value, int buffer_size);
+  
+  //set an option from an option=value string (like a line at the interactive prompt); false if there's no = in it or it's not a valid setting
+  bool set_ts_assignment(const char *assignment);
+  
+  //set options from a file of option=value lines (blank lines and lines starting with # are skipped)
+  //returns false if the file couldn't be read or any line in it wasn't a valid setting
+  bool load_options(const char *fname);
+  
+  //forget everything learned from earlier searches (the history table, transposition table and killer moves)
+  //for when the next search has nothing to do with the last one, like a new game
+  void clear_search_state();
   
   //convert a string to a boolean
   bool string_to_bool(char *string, int buffer_size);
   
+  //checked conversions for settings; these return false (leaving result alone) when the string isn't a valid value
+  static bool read_int(const char *string, int minimum, int *result);
+  static bool read_double(const char *string, double minimum, double *result);
+  static bool read_bool(const char *string, bool *result);
+  
   //allow the user to change all the settings of this AI object
   void configure(int player_id);
   
@@ -83,17 +194,38 @@ public:
   //returns true when input is recieved, false otherwise
   bool tl_input(char *buffer, int buffer_size, int timeout);
   
+  //counts from the most recent tree search
+  _SearchStats *get_stats(){ return &stats; }
+  bool get_search_stats(){ return search_stats; }
+  //have a function called after every search iteration (NULL for none)
+  void set_iteration_hook(void (*hook)(_SearchStats *stats, void *hook_data), void *hook_data){ stats.iteration_hook=hook; stats.hook_data=hook_data; }
+  
   //store this move in the movement history
   void remember_move(_Move *m);
   //access remembered moves
   vector <_Move*> get_moves() { return moves; }
+  //forget all remembered moves
+  void clear_moves();
   
   bool handle_load_save(const char *input_buffer, Board *board, int player_id);
   void user_input(char *input_buffer);
   _Move *user_move(Board *board, int player_id);
   
+  //a guess at what player_id will play on board (the next move of our last search's line, if that's how we got here; otherwise from a quick shallow search)
+  //NULL if there are no legal moves
+  //(remember to free this later)
+  _Move *predict_reply(Board *board, int player_id);
+  
   //make a move depending on the algorithm in use and the time left
-  _Move *ai_move(Board *board, int player_id, double time_remaining, double enemy_time_remaining);
+  //run a tree search with this AI's settings but the given limits (see TreeSearch::id_minimax for what they mean)
+  //clock can be used to stop the search from another thread (NULL if that won't happen)
+  _Move *search_move(Board *board, int player_id, int depth_limit, bool time_limited, double time_remaining, double increment, int moves_to_go, bool fixed_time, SearchClock *clock);
+  //the next search's root has reply played after the moves remembered so far (e.g. a ponder search, on the guessed reply)
+  //call this before starting that search, since the history can change while it runs
+  void set_search_reply(_Move *reply);
+  
+  //when there's a game clock, time_remaining is what's left on it, otherwise it's the time for this move
+  _Move *ai_move(Board *board, int player_id, double time_remaining, double increment, int moves_to_go);
   
   bool run(Board *board, int player_id);
   
@@ -3,6 +3,10 @@
 #include "string.h"
 #include <stdlib.h>
 #include <ctype.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <algorithm>
 
 //constructor
 //makes internal structures based for a starting state
@@ -81,8 +85,8 @@ Board::Board()
   last_moved=NULL;
   last_move_made=NULL;
   last_capture_type='\0';
-  moves_since_capture=0;
-  moves_since_advancement=0;
+  halfmove_clock=0;
+  fullmove=1;
   
   //check whether or not anyone's in check
   check_in_check();
@@ -112,6 +116,35 @@ void Board::check_in_check()
   }
 }
 
+//read a whole file in one go (remember to free this later); there's room for 2 more chars past len, and a null terminator after it
+//NULL if it couldn't be read
+static char *board_read_file(const char *fname, size_t *len)
+{
+  FILE *fp=fopen(fname,"rb");
+  if(fp==NULL)
+  {
+    return NULL;
+  }
+  struct stat file_stat;
+  char *text=NULL;
+  if(fstat(fileno(fp),&file_stat)==0)
+  {
+    *len=file_stat.st_size;
+    text=(char*)(malloc((*len)+2));
+  }
+  if(text!=NULL && fread(text,1,*len,fp)!=*len)
+  {
+    free(text);
+    text=NULL;
+  }
+  fclose(fp);
+  if(text!=NULL)
+  {
+    text[*len]='\0';
+  }
+  return text;
+}
+
 //loads data from a textual description of the board in a humanly-readable format
 //and sets the internal state of the board to match that file's description
 //as a return/side-effect, sets the player_id to the at-play player
@@ -120,7 +153,46 @@ void Board::load_from_file(const char *fname, int *start_player_id)
   //NOTE: this is called after the constructor
   //and as such it does not initialize the basic state variables
   //but rather just overrides them as needed
+  
+  //a .fen file is just one line of FEN
+  size_t fname_len=strlen(fname);
+  if(fname_len>4 && !strcmp(fname+fname_len-4,".fen"))
+  {
+    FILE *fp=fopen(fname,"r");
+    if(fp==NULL)
+    {
+      fprintf(stderr,"Warn: Could not open file %s; will have default board state instead!\n",fname);
+      return;
+    }
+    
+    char fen[BUFFER_SIZE];
+    if(fgets(fen,BUFFER_SIZE,fp)==NULL || !from_fen(fen,start_player_id))
+    {
+      fprintf(stderr,"Warn: File %s doesn't start with a valid FEN line; will have default board state instead!\n",fname);
+    }
+    else
+    {
+      printf("Loaded Save File %s successfully\n",fname);
+    }
+    fclose(fp);
+    return;
+  }
 
+  size_t text_len;
+  char *text=board_read_file(fname,&text_len);
+  if(text==NULL)
+  {
+    fprintf(stderr,"Warn: Could not read file %s; will have default board state instead!\n",fname);
+    return;
+  }
+  load_save_text(text,text_len,start_player_id);
+  free(text);
+  printf("Loaded Save File %s successfully\n",fname);
+}
+
+//load a board state from the whole text of a .bst save file
+bool Board::load_save_text(char *text, size_t text_len, int *start_player_id)
+{
   //clear out any existing pieces on the board to start with a blank slate
   //since normally we would start with the initial starting position board state
   for(int f=1;f<=8;f++)
@@ -129,69 +201,129 @@ void Board::load_from_file(const char *fname, int *start_player_id)
     {
       if(get_element(f,r)!=NULL)
       {
-        free(get_element(f,r));
+        NodeArena::node_free(get_element(f,r));
         state[((r-1)*width)+(f-1)]=NULL;
       }
     }
   }
   
-  FILE *fp=fopen(fname,"r");
-  if(fp==NULL)
+  //a last line with no newline still counts
+  if(text_len==0 || text[text_len-1]!='\n')
   {
-    fprintf(stderr,"Warn: Could not open file %s; will have default board state instead!\n",fname);
-    return;
+    text[text_len++]='\n';
   }
+  text[text_len]='\0';
   
-  //this is a buffer that's only one character long
-  //because longer buffers are quicker and more efficient
-  //but there's nothing wrong with reading one character at a time if you're patient
-  int one_char_buf=fgetc(fp);
-  
-  //one line worth of input
-  char linebuf[BUFFER_SIZE];
-  unsigned int linebuf_idx=0;
-  
-  unsigned int lineno=1;
-
   //whether we are currently reading the board line-by-line or not
   bool in_board_lines=false;
   
-  while(one_char_buf!=EOF)
+  char *line=text;
+  int lines=0;
+  while(*line!='\0')
   {
-    linebuf[linebuf_idx]=one_char_buf;
-    linebuf_idx++;
-    
-//    printf("%c",one_char_buf); //debug
-    if(one_char_buf=='\n')
+    //the line parsers want the newline left on, so the start of the next line is kept aside while this one is cut off there
+    char *end=strchr(line,'\n')+1;
+    char next=*end;
+    *end='\0';
+    if((end-line)<BUFFER_SIZE)
     {
-      //end of line, so null-terminate the line buffer
-      linebuf[linebuf_idx]='\0';
-      
-      //and load that line
-      in_board_lines=load_one_save_line((const char *)(linebuf),in_board_lines,start_player_id);
-      
-      //reset the line buffer for the next line
-      linebuf_idx=0;
-      //and update the line number
-      lineno++;
+      in_board_lines=load_one_save_line((const char *)(line),in_board_lines,start_player_id);
     }
-    
-    //read the next character
-    one_char_buf=fgetc(fp);
+    else
+    {
+      fprintf(stderr,"Warn: Skipping save file line %i because it's longer than %i chars\n",lines+1,BUFFER_SIZE-1);
+    }
+    *end=next;
+    line=end;
+    lines++;
   }
+  return lines>0;
+}
 
-  if(ferror(fp))
+//load every save file in a directory
+int Board::load_directory(const char *dir, vector<_SavedPosition> *positions)
+{
+  DIR *dp=opendir(dir);
+  if(dp==NULL)
   {
-    fprintf(stderr,"Warn: I/O error when reading file %s; will have default board state instead!\n",fname);
-    return;
+    fprintf(stderr,"Err: Could not open directory %s\n",dir);
+    return -1;
   }
-  else if(feof(fp))
+  vector<string> names;
+  struct dirent *entry;
+  while((entry=readdir(dp))!=NULL)
   {
-    printf("Loaded Save File %s successfully\n",fname);
+    size_t len=strlen(entry->d_name);
+    if(len>4 && (!strcmp(entry->d_name+len-4,".bst") || !strcmp(entry->d_name+len-4,".fen")))
+    {
+      names.push_back(entry->d_name);
+    }
   }
+  closedir(dp);
+  sort(names.begin(),names.end());
   
-  fclose(fp);
-  
+  int added=0;
+  for(size_t i=0; i<names.size(); i++)
+  {
+    string fname=string(dir)+"/"+names[i];
+    size_t text_len;
+    char *text=board_read_file(fname.c_str(),&text_len);
+    if(text==NULL)
+    {
+      fprintf(stderr,"Warn: Could not read file %s; skipping it\n",fname.c_str());
+      continue;
+    }
+    
+    //every file gets a fresh board, since a save file only gives what differs from the defaults
+    _SavedPosition saved;
+    saved.player_id=WHITE;
+    Board *board=new Board();
+    bool loaded;
+    if(names[i].compare(names[i].size()-4,4,".fen")==0)
+    {
+      char *newline=strchr(text,'\n');
+      if(newline!=NULL)
+      {
+        *newline='\0';
+      }
+      loaded=board->from_fen(text,&(saved.player_id));
+    }
+    else
+    {
+      loaded=board->load_save_text(text,text_len,&(saved.player_id));
+    }
+    free(text);
+    
+    //a position that can't be searched is no use; both sides need exactly one king
+    int kings[2]={0,0};
+    for(int f=1; f<=width; f++)
+    {
+      for(int r=1; r<=height; r++)
+      {
+        _SuperPiece *piece=board->get_element(f,r);
+        if(piece!=NULL && piece->type=='K')
+        {
+          kings[piece->owner]++;
+        }
+      }
+    }
+    loaded=loaded && kings[WHITE]==1 && kings[BLACK]==1;
+    
+    if(loaded)
+    {
+      board->pack_position(&(saved.pos));
+      strncpy(saved.name,names[i].c_str(),SAVED_NAME_SIZE-1);
+      saved.name[SAVED_NAME_SIZE-1]='\0';
+      positions->push_back(saved);
+      added++;
+    }
+    else
+    {
+      fprintf(stderr,"Warn: %s isn't a save file with a position that can be played; skipping it\n",fname.c_str());
+    }
+    delete board;
+  }
+  return added;
 }
 
 //load a single line from a save file
@@ -455,10 +587,188 @@ void Board::save_to_file(FILE *outfile, int player_id)
   fprintf(outfile,"\nstart_player_id=%s\n",(player_id==WHITE?"WHITE":"BLACK"));
 }
 
+//pack this board into the compact position format (see Position.h)
+//only the movement information castling and en passant depend on is kept
+void Board::pack_position(_Position *pos)
+{
+  position_clear(pos);
+  
+  //whether each side's king is still unmoved on its home rank; once it has moved, neither rook can castle
+  bool home_kings[2]={false,false};
+  for(int f=1; f<=width; f++)
+  {
+    for(int owner=WHITE; owner<=BLACK; owner++)
+    {
+      _SuperPiece *king=get_element(f,(owner==WHITE)? 1 : height);
+      if(king!=NULL && king->type=='K' && king->owner==owner && king->movements==0)
+      {
+        home_kings[owner]=true;
+      }
+    }
+  }
+  
+  for(int f=1; f<=width; f++)
+  {
+    for(int r=1; r<=height; r++)
+    {
+      _SuperPiece *piece=get_element(f,r);
+      if(piece!=NULL)
+      {
+        //the rank an unmoved king or rook belongs on for this owner
+        int home_rank=(piece->owner==WHITE)? 1 : 8;
+        int code=position_type_code(piece->type);
+        
+        //castling is only ever possible with an unmoved rook in a corner of its home rank, and its king unmoved too
+        if(piece->type=='R' && piece->movements==0 && r==home_rank && (f==1 || f==width) && home_kings[piece->owner])
+        {
+          code=POS_CASTLE_ROOK;
+        }
+        else if(piece->type=='K' && piece->movements==0 && r==home_rank)
+        {
+          code=POS_HOME_KING;
+        }
+        //en passant is only possible against the pawn that just moved two squares
+        else if(piece->type=='P' && piece==last_moved && piece->movements==1 && r==((piece->owner==WHITE)? 4 : 5))
+        {
+          code=POS_EP_PAWN;
+        }
+        else if(piece->owner==BLACK)
+        {
+          code|=POS_BLACK;
+        }
+        
+        position_set(pos,f,r,code);
+      }
+    }
+  }
+}
+
+//a hash of this position with player_id to move
+unsigned long long Board::hash_key(int player_id)
+{
+  _Position pos;
+  pack_position(&pos);
+  return position_hash(&pos,player_id);
+}
+
+//set this board from a packed position
+//like load_from_file this is called after the constructor and replaces whatever pieces were there
+void Board::load_from_position(const _Position *pos)
+{
+  for(int f=1; f<=width; f++)
+  {
+    for(int r=1; r<=height; r++)
+    {
+      if(get_element(f,r)!=NULL)
+      {
+        NodeArena::node_free(get_element(f,r));
+        state[((r-1)*width)+(f-1)]=NULL;
+      }
+    }
+  }
+  
+  //a packed position carries no history
+  last_moved=NULL;
+  if(last_move_made!=NULL)
+  {
+    NodeArena::node_free(last_move_made);
+    last_move_made=NULL;
+  }
+  last_capture_type='\0';
+  halfmove_clock=0;
+  fullmove=1;
+  
+  for(int f=1; f<=width; f++)
+  {
+    for(int r=1; r<=height; r++)
+    {
+      int code=position_get(pos,f,r);
+      if(code!=POS_EMPTY)
+      {
+        int type=position_code_type(code);
+        int owner;
+        int movements;
+        
+        switch(code)
+        {
+          //the owner of the special codes is implied by the rank they're on
+          case POS_CASTLE_ROOK:
+          case POS_HOME_KING:
+            owner=(r==1)? WHITE : BLACK;
+            movements=0;
+            break;
+          case POS_EP_PAWN:
+            owner=(r==4)? WHITE : BLACK;
+            movements=1;
+            break;
+          default:
+            owner=(code & POS_BLACK)? BLACK : WHITE;
+            
+            //a pawn off its starting rank has moved and so can't advance two squares
+            if(type=='P')
+            {
+              movements=(r==((owner==WHITE)? 2 : 7))? 0 : 1;
+            }
+            //a king or rook that wasn't packed as unmoved must have moved (so it can't castle)
+            else if(type=='K' || type=='R')
+            {
+              movements=1;
+            }
+            else
+            {
+              movements=0;
+            }
+            break;
+        }
+        
+        place_piece(0,owner,f,r,false,type,false,movements);
+        
+        if(code==POS_EP_PAWN)
+        {
+          last_moved=get_element(f,r);
+        }
+      }
+    }
+  }
+  
+  check_in_check();
+}
+
+//set this board from a FEN string
+//the pieces go through the packed position format, which already knows how castling and en passant rights map to movement counts
+bool Board::from_fen(const char *fen, int *player_id)
+{
+  _Position pos;
+  int fen_player_id;
+  int halfmove;
+  int fen_fullmove;
+  if(!position_from_fen(&pos,fen,&fen_player_id,&halfmove,&fen_fullmove))
+  {
+    return false;
+  }
+  
+  load_from_position(&pos);
+  
+  halfmove_clock=halfmove;
+  fullmove=fen_fullmove;
+  
+  *player_id=fen_player_id;
+  return true;
+}
+
+//write this board as a FEN string
+void Board::to_fen(int player_id, char *buffer)
+{
+  _Position pos;
+  pack_position(&pos);
+  
+  position_to_fen(&pos,player_id,halfmove_clock,fullmove,buffer);
+}
+
 //place a piece on the board given some information about the piece
 void Board::place_piece(int id, int owner, int file, int rank, int hasMoved, int type, bool haveChecked, int movements)
 {
-  _SuperPiece *new_piece=(_SuperPiece*)(malloc(sizeof(_SuperPiece)));
+  _SuperPiece *new_piece=(_SuperPiece*)(NodeArena::node_malloc(sizeof(_SuperPiece)));
   if(new_piece==NULL)
   {
     fprintf(stderr,"Err: Out of RAM!? (malloc failed)\n");
@@ -498,7 +808,7 @@ Board::Board(Board *board)
       //the +1 is to convert to 1-indexing
       if(board->get_element(file+1, rank+1)!=NULL)
       {
-        _SuperPiece *new_piece=(_SuperPiece*)(malloc(sizeof(_SuperPiece)));
+        _SuperPiece *new_piece=(_SuperPiece*)(NodeArena::node_malloc(sizeof(_SuperPiece)));
         if(new_piece==NULL)
         {
           fprintf(stderr,"Err: Out of RAM!? (malloc failed)\n");
@@ -528,14 +838,18 @@ Board::Board(Board *board)
     }
   }
   
-  //nothing's been moved yet
+  //the last move itself isn't carried, but which piece it moved is (en passant depends on it)
   last_moved=NULL;
+  if(board->last_moved!=NULL)
+  {
+    last_moved=get_element(board->last_moved->file,board->last_moved->rank);
+  }
   last_move_made=NULL;
   last_capture_type='\0';
   
   //the move history is carried though
-  moves_since_capture=board->moves_since_capture;
-  moves_since_advancement=board->moves_since_advancement;
+  halfmove_clock=board->halfmove_clock;
+  fullmove=board->fullmove;
 }
 
 //equality check (just checks type, owner, position of pieces, not history or anything)
@@ -578,14 +892,14 @@ Board::~Board()
     {
       if(get_element(file,rank)!=NULL)
       {
-        free(get_element(file,rank));
+        NodeArena::node_free(get_element(file,rank));
       }
     }
   }
   
   if(last_move_made!=NULL)
   {
-    free(last_move_made);
+    NodeArena::node_free(last_move_made);
   }
   
   //and recurse to get all the children
@@ -598,6 +912,23 @@ Board::~Board()
   }
 }
 
+//boards come from the active NodeArena during a search, same as their pieces and moves
+void *Board::operator new(size_t size)
+{
+  void *board=NodeArena::node_malloc(size);
+  if(board==NULL)
+  {
+    fprintf(stderr,"Err: Out of RAM!? (malloc failed)\n");
+    exit(1);
+  }
+  return board;
+}
+
+void Board::operator delete(void *ptr)
+{
+  NodeArena::node_free(ptr);
+}
+
 //deal with other nodes in the structure
 void Board::add_child(Board *board)
 {
@@ -1103,7 +1434,7 @@ _SuperPiece *Board::get_element(int file, int rank)
 //(remember to free this later)
 _Move *Board::make_move(_SuperPiece *p, int to_file, int to_rank, int promote_type)
 {
-  _Move *new_move=(_Move*)(malloc(sizeof(_Move)));
+  _Move *new_move=(_Move*)(NodeArena::node_malloc(sizeof(_Move)));
   if(new_move==NULL)
   {
     fprintf(stderr,"Err: Out of RAM!? (malloc failed)");
@@ -1125,7 +1456,7 @@ _Move *Board::make_move(_SuperPiece *p, int to_file, int to_rank, int promote_ty
 //(remember to free this later)
 _Move *Board::copy_move(_Move *move)
 {
-  _Move *new_move=(_Move*)(malloc(sizeof(_Move)));
+  _Move *new_move=(_Move*)(NodeArena::node_malloc(sizeof(_Move)));
   if(new_move==NULL)
   {
     fprintf(stderr,"Err: Out of RAM!? (malloc failed)");
@@ -1167,13 +1498,20 @@ void Board::apply_move(_Move *move, bool update_check)
       rook=get_element(1,king->rank);
     }
     
-    //NOTE: since this cannot be a capture or pawn advancement, those variables can't get changed here
+    //(the clocks are left for the king's part of the move, so a castle only counts once)
     _Move* rook_move=make_move(rook, (move->toFile)+direction, move->toRank, move->promoteType);
+    int fullmove_before=fullmove;
+    int halfmove_before=halfmove_clock;
     apply_move(rook_move, true);
+    fullmove=fullmove_before;
+    halfmove_clock=halfmove_before;
     
     //then move the king by continuing after this if
   }
   
+  //whether this move captures anything (en passant or otherwise)
+  bool captured=false;
+  
   //en passant handling
   //if it's a pawn and they're moving diagonally but there's no piece at the destination, it must be an en passant
   if((get_element(move->fromFile, move->fromRank)->type=='P') && (get_element(move->toFile, move->toRank)==NULL) && (move->toFile!=move->fromFile))
@@ -1186,10 +1524,9 @@ void Board::apply_move(_Move *move, bool update_check)
     {
       last_capture_type=get_element(file_to_capture,rank_to_capture)->type;
       
-      free(get_element(file_to_capture,rank_to_capture));
+      NodeArena::node_free(get_element(file_to_capture,rank_to_capture));
       state[((rank_to_capture-1)*width)+(file_to_capture-1)]=NULL;
-      moves_since_capture=0;
-      //moves_since_advancement is updated later (on any pawn movement), and so doesn't need to be here
+      captured=true;
     }
   }
   
@@ -1200,12 +1537,12 @@ void Board::apply_move(_Move *move, bool update_check)
     
     last_capture_type=victim->type;
     
-    free(victim);
-    moves_since_capture=0;
+    NodeArena::node_free(victim);
+    captured=true;
   }
-  else
+  if(!captured)
   {
-    moves_since_capture++;
+    last_capture_type='\0';
   }
   
   //NOTE: the -1 everywhere is because the API I was given 1-indexes and I try to be consistent with it where it's not impossible to do so
@@ -1222,6 +1559,12 @@ void Board::apply_move(_Move *move, bool update_check)
   //and update its move count
   moved_piece->movements++;
   
+  //a move by black finishes a full move
+  if(moved_piece->owner==BLACK)
+  {
+    fullmove++;
+  }
+  
   //there is now nothing where the piece previously was
   state[((move->fromRank-1)*width)+(move->fromFile-1)]=NULL;
   
@@ -1233,19 +1576,23 @@ void Board::apply_move(_Move *move, bool update_check)
     {
       moved_piece->type=move->promoteType;
     }
-    //if it was any kind of pawn movement reset pawn advancement counter
-    moves_since_advancement=0;
+    //any kind of pawn movement resets the halfmove clock, as does a capture
+    halfmove_clock=0;
+  }
+  else if(captured)
+  {
+    halfmove_clock=0;
   }
   else
   {
-    moves_since_advancement++;
+    halfmove_clock++;
   }
   
   
   //if there was a previous move there's no longer a reference here so free it
   if(last_move_made!=NULL)
   {
-    free(last_move_made);
+    NodeArena::node_free(last_move_made);
   }
   
   //update the internal board structure to know what was the last thing moved
@@ -1887,7 +2234,7 @@ int Board::entropy_heuristic_value(int player_id, bool max, bool distance_sum)
           
           for(size_t i=0;i<piece_moves.size();i++)
           {
-            free(piece_moves[i]);
+            NodeArena::node_free(piece_moves[i]);
           }
         }
       }
@@ -1938,7 +2285,7 @@ bool Board::quiescent()
   }
   
   //if the last move was a capture this is not a quiescent state
-  if(moves_since_capture==0)
+  if(last_move_captured())
   {
     return false;
   }
@@ -4,6 +4,8 @@
 #include "structures.h"
 #include "SuperPiece.h"
 #include "HistTable.h"
+#include "Position.h"
+#include "NodeArena.h"
 #include <vector>
 
 #define BUFFER_SIZE 1024
@@ -30,9 +32,26 @@ class HistTable;
 #define HEURISTIC_MINIMUM (-(9*8*8*100))
 #define HEURISTIC_MAXIMUM (9*8*8*100)
 
+//scores this close to the bounds are checkmates, counted in plies from the root of the search
+//(being mated 3 plies down is HEURISTIC_MINIMUM+3, so a faster mate is better for the winner and a slower one for the loser)
+#define MATE_PLIES 1000
+#define IS_MATE(X) ((X)>=(HEURISTIC_MAXIMUM-MATE_PLIES) || (X)<=(HEURISTIC_MINIMUM+MATE_PLIES))
+
 #define WHITE 0
 #define BLACK 1
 
+//room for the name of a saved position's file, plus a null terminator (longer names are cut short)
+#define SAVED_NAME_SIZE 64
+
+//a position from a save file, packed, for working through lots of them at once
+struct _SavedPosition
+{
+  _Position pos;
+  int player_id;
+  //the file it came from, without the directory
+  char name[SAVED_NAME_SIZE];
+};
+
 class Board
 {
 private:
@@ -50,13 +69,14 @@ private:
   _Move *last_move_made;
   
   //store capture information because that's needed to identify things in the history table
-  //what type of piece was captured last (can also check moves_since_capture to tell if this was last move)
+  //what type of piece the last move captured ('\0' if it wasn't a capture)
   int last_capture_type;
   
-  //the number of moves since the last capture, pawn advancement (respectively)
+  //the halfmove clock; plies since the last capture or pawn move, for the fifty move rule (and repetitions can't go back past it)
   //initialized to 0 in the normal constructor; carried in the copy constructor
-  int moves_since_capture;
-  int moves_since_advancement;
+  int halfmove_clock;
+  //the move number as FEN counts it (starts at 1, goes up after every move black makes)
+  int fullmove;
   
   //parent
   Board *p;
@@ -72,14 +92,33 @@ public:
   //initialize in_check state based on current position of pieces
   void check_in_check();
   
-  //load a board state from a save file
+  //load a board state from a save file (a .fen file is read as a single FEN line)
   void load_from_file(const char *fname, int *start_player_id);
+  //load a board state from the whole text of a .bst save file, which is cut into lines in place (it's left as it was after)
+  //text must have room for 2 more chars past text_len; false if nothing was read
+  bool load_save_text(char *text, size_t text_len, int *start_player_id);
+  //load every save file (.bst or .fen) in a directory, in order of name, and add them to positions
+  //returns how many were added, or -1 (with an error) if the directory couldn't be read
+  static int load_directory(const char *dir, vector<_SavedPosition> *positions);
   bool load_one_save_line(const char *line,  bool in_board_lines, int *start_player_id);
   void load_board_save_line(const char *line);
   void load_rank_file_setting_line(const char *var, const char *val);
   
   void save_to_file(FILE *outfile, int player_id);
   
+  //convert to and from the packed 32-byte position format (see Position.h)
+  //movement counts that don't matter for castling or en passant are not preserved
+  void pack_position(_Position *pos);
+  void load_from_position(const _Position *pos);
+  //a hash of this position with player_id to move (see position_hash), for transposition tables and the like
+  unsigned long long hash_key(int player_id);
+  
+  //convert to and from Forsyth-Edwards Notation (FEN), with the side to move carried separately like everywhere else
+  //from_fen returns false (and leaves the board alone) if the string isn't a valid FEN
+  //to_fen's buffer must hold at least FEN_SIZE chars
+  bool from_fen(const char *fen, int *player_id);
+  void to_fen(int player_id, char *buffer);
+  
   //place a piece on the board given some information about the piece
   void place_piece(int id, int owner, int file, int rank, int hasMoved, int type, bool haveChecked, int movements);
   
@@ -92,13 +131,19 @@ public:
   //destructor, cleans up nicely
   ~Board();
   
+  //boards come from the active NodeArena during a search, same as their pieces and moves
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
+  
   //accessors
   vector<Board*> get_children(){ return children; }
   void resize_children(unsigned int new_size){ children.resize(new_size); }
   _Move *get_last_move_made(){ return last_move_made; }
+  _SuperPiece *get_last_moved(){ return last_moved; }
   bool get_check(int player_id){ return (player_id==WHITE) ? white_check : black_check; }
-  int get_moves_since_capture(){ return moves_since_capture; }
-  int get_moves_since_advancement(){ return moves_since_advancement; }
+  int get_halfmove_clock(){ return halfmove_clock; }
+  bool last_move_captured(){ return last_capture_type!='\0'; }
+  int get_fullmove(){ return fullmove; }
   int get_last_capture_type(){ return last_capture_type; }
   double get_sorting_value(){ return sorting_value; }
   void set_sorting_value(double s){ sorting_value=s; }
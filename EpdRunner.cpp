@@ -0,0 +1,440 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <thread>
+#include <sys/stat.h>
+#include "EpdRunner.h"
+#include "Notation.h"
+#include "TreeSearch.h"
+
+//what a worker's iteration hook needs to know about the position being searched
+struct _EpdProgress
+{
+  _EpdPosition *pos;
+  //when the search settled on a move that solves the position (negative while it hasn't)
+  double solve_time;
+};
+
+EpdRunner::EpdRunner(double time_limit, int depth_limit, unsigned int thread_count)
+{
+  this->time_limit=time_limit;
+  this->depth_limit=depth_limit;
+  
+  //one thread per core unless told otherwise
+  if(thread_count==0)
+  {
+    thread_count=thread::hardware_concurrency();
+    if(thread_count==0)
+    {
+      thread_count=1;
+    }
+  }
+  this->thread_count=thread_count;
+  
+  input=NULL;
+  next_index=1;
+  
+  positions=0;
+  scored=0;
+  solved=0;
+  solve_time_total=0;
+  nodes_total=0;
+  time_total=0;
+}
+
+EpdRunner::~EpdRunner()
+{
+  for(size_t i=0; i<options.size(); i++)
+  {
+    free(options[i]);
+  }
+}
+
+//an AI setting (option=value) for every worker
+void EpdRunner::add_option(const char *option)
+{
+  options.push_back(strdup(option));
+}
+
+//parse one line of EPD into pos
+//e.g. r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - bm Qxf7#; id "scholar's mate";
+bool EpdRunner::parse_epd(const char *line, _EpdPosition *pos)
+{
+  pos->board=NULL;
+  pos->id[0]='\0';
+  pos->expected[0]='\0';
+  pos->best_move_count=0;
+  pos->avoid_move_count=0;
+  
+  const char *c=line;
+  while(isspace(*c))
+  {
+    c++;
+  }
+  //blank lines and comments aren't positions
+  if(*c=='\0' || *c=='#')
+  {
+    return false;
+  }
+  
+  //the first four fields are a FEN without the move counters
+  char fen[FEN_SIZE];
+  int fen_len=0;
+  for(int field=0; field<4; field++)
+  {
+    while(isspace(*c))
+    {
+      c++;
+    }
+    //fields too long for a FEN aren't one (cutting them short would just make it a different position)
+    //(every character, separators included, has to leave room for the null terminator)
+    while(*c!='\0' && !isspace(*c) && fen_len<FEN_SIZE-1)
+    {
+      fen[fen_len++]=*c;
+      c++;
+    }
+    if((*c!='\0' && !isspace(*c)) || fen_len>=FEN_SIZE-1)
+    {
+      fprintf(stderr,"Warn: EPD position is too long to be a FEN, skipping it\n");
+      return false;
+    }
+    fen[fen_len++]=' ';
+  }
+  fen[fen_len]='\0';
+  
+  pos->board=new Board();
+  if(!pos->board->from_fen(fen,&(pos->player_id)))
+  {
+    delete pos->board;
+    pos->board=NULL;
+    return false;
+  }
+  
+  //then operations, each an opcode and operands ending with a semicolon (which may be inside a quoted string)
+  while(*c!='\0')
+  {
+    char op[EPD_LINE_SIZE];
+    int op_len=0;
+    bool quoted=false;
+    while(*c!='\0' && (quoted || *c!=';') && op_len<EPD_LINE_SIZE-1)
+    {
+      if(*c=='"')
+      {
+        quoted=!quoted;
+      }
+      op[op_len++]=*c;
+      c++;
+    }
+    op[op_len]='\0';
+    if(*c==';')
+    {
+      c++;
+    }
+    
+    char *token=strtok(op," \t\r\n");
+    if(token==NULL)
+    {
+      continue;
+    }
+    
+    if(!strcmp(token,"bm") || !strcmp(token,"am"))
+    {
+      bool best=!strcmp(token,"bm");
+      
+      size_t expected_len=strlen(pos->expected);
+      snprintf(pos->expected+expected_len,BUFFER_SIZE-expected_len,"%s%s",(expected_len>0)? "; " : "",token);
+      
+      for(token=strtok(NULL," \t\r\n"); token!=NULL; token=strtok(NULL," \t\r\n"))
+      {
+        expected_len=strlen(pos->expected);
+        snprintf(pos->expected+expected_len,BUFFER_SIZE-expected_len," %s",token);
+        
+        //these should be SAN, but some suites use coordinates
+        _Move *move=Notation::san_to_move(pos->board,pos->player_id,token);
+        if(move==NULL)
+        {
+          move=Notation::coord_to_move(pos->board,pos->player_id,token);
+        }
+        if(move==NULL)
+        {
+          fprintf(stderr,"Warn: %s move %s isn't legal in %s; ignoring it\n",best? "bm" : "am",token,fen);
+          continue;
+        }
+        
+        if(best && pos->best_move_count<EPD_MAX_MOVES)
+        {
+          pos->best_moves[pos->best_move_count++]=*move;
+        }
+        else if(!best && pos->avoid_move_count<EPD_MAX_MOVES)
+        {
+          pos->avoid_moves[pos->avoid_move_count++]=*move;
+        }
+        NodeArena::node_free(move);
+      }
+    }
+    else if(!strcmp(token,"id"))
+    {
+      //everything after the opcode, without the quotes
+      token=strtok(NULL,"\"\r\n");
+      if(token!=NULL)
+      {
+        strncpy(pos->id,token,BUFFER_SIZE-1);
+        pos->id[BUFFER_SIZE-1]='\0';
+      }
+    }
+    //other operations (c0, ce, hmvc, etc.) don't matter here
+  }
+  
+  return true;
+}
+
+//true if move solves the position
+bool EpdRunner::solves(_EpdPosition *pos, _Move *move)
+{
+  if(move==NULL || (pos->best_move_count==0 && pos->avoid_move_count==0))
+  {
+    return false;
+  }
+  
+  for(int i=0; i<pos->avoid_move_count; i++)
+  {
+    _Move *m=&(pos->avoid_moves[i]);
+    if(m->fromFile==move->fromFile && m->fromRank==move->fromRank && m->toFile==move->toFile && m->toRank==move->toRank && m->promoteType==move->promoteType)
+    {
+      return false;
+    }
+  }
+  
+  //with only moves to avoid, anything else solves it
+  if(pos->best_move_count==0)
+  {
+    return true;
+  }
+  
+  for(int i=0; i<pos->best_move_count; i++)
+  {
+    _Move *m=&(pos->best_moves[i]);
+    if(m->fromFile==move->fromFile && m->fromRank==move->fromRank && m->toFile==move->toFile && m->toRank==move->toRank && m->promoteType==move->promoteType)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//read the next position from the file, skipping blank or broken lines; false at the end of the file
+bool EpdRunner::next_position(_EpdPosition *pos)
+{
+  char line[EPD_LINE_SIZE];
+  
+  input_lock.lock();
+  bool found=false;
+  if(input==NULL && (size_t)(next_index-1)<saved.size())
+  {
+    _SavedPosition *next=&(saved[next_index-1]);
+    pos->board=new Board();
+    pos->board->load_from_position(&(next->pos));
+    pos->player_id=next->player_id;
+    strncpy(pos->id,next->name,BUFFER_SIZE);
+    pos->expected[0]='\0';
+    pos->best_move_count=0;
+    pos->avoid_move_count=0;
+    pos->index=next_index;
+    next_index++;
+    found=true;
+  }
+  while(input!=NULL && !found && fgets(line,EPD_LINE_SIZE,input)!=NULL)
+  {
+    found=parse_epd(line,pos);
+    if(found)
+    {
+      pos->index=next_index;
+      next_index++;
+    }
+  }
+  input_lock.unlock();
+  
+  return found;
+}
+
+//called after every iteration of a search, to keep track of when the right move was found
+//the time to solution is when the search first picked a solving move and then stuck with it
+void EpdRunner::iteration_hook(_SearchStats *stats, void *hook_data)
+{
+  _EpdProgress *progress=(_EpdProgress*)(hook_data);
+  
+  if(!stats->complete || !stats->have_best)
+  {
+    return;
+  }
+  
+  if(solves(progress->pos,&(stats->best_move)))
+  {
+    if(progress->solve_time<0)
+    {
+      progress->solve_time=stats->total_time;
+    }
+  }
+  else
+  {
+    progress->solve_time=-1;
+  }
+}
+
+//one worker thread; searches positions until there are none left
+void EpdRunner::worker()
+{
+  AI *ai=new AI();
+  ai->init();
+  for(size_t i=0; i<options.size(); i++)
+  {
+    ai->set_ts_assignment(options[i]);
+  }
+  
+  _EpdPosition pos;
+  _EpdProgress progress;
+  progress.pos=&pos;
+  ai->set_iteration_hook(iteration_hook,&progress);
+  
+  bool time_limited=(time_limit>0);
+  
+  while(next_position(&pos))
+  {
+    //every position is searched on its own; nothing learned from the last one carries over
+    ai->clear_moves();
+    ai->clear_search_state();
+    progress.solve_time=-1;
+    
+    _Move *move=ai->search_move(pos.board,pos.player_id,depth_limit,time_limited,time_limit,0,0,true,NULL);
+    _SearchStats *stats=ai->get_stats();
+    
+    //if even the first iteration didn't finish, any legal move is better than none
+    if(move==NULL)
+    {
+      vector<_Move*> legal_moves=TreeSearch::generate_moves(pos.board,pos.player_id);
+      if(!legal_moves.empty())
+      {
+        move=pos.board->copy_move(legal_moves[0]);
+      }
+      pos.board->clear_children();
+    }
+    
+    char san[SAN_MOVE_SIZE];
+    strcpy(san,"none");
+    if(move!=NULL)
+    {
+      Notation::move_to_san(pos.board,pos.player_id,move,san);
+    }
+    
+    bool is_scored=(pos.best_move_count>0 || pos.avoid_move_count>0);
+    bool is_solved=solves(&pos,move);
+    //a move that only came from the fallback above was never seen by the hook
+    if(is_solved && progress.solve_time<0)
+    {
+      progress.solve_time=stats->total_time;
+    }
+    
+    unsigned long long nps=(stats->total_time>0)? (unsigned long long)(stats->nodes/stats->total_time) : 0;
+    
+    output_lock.lock();
+    printf("epd n=%i id=\"%s\" solved=%s move=%s expected=\"%s\"",pos.index,pos.id,is_scored? (is_solved? "yes" : "no") : "-",san,pos.expected);
+    if(is_solved)
+    {
+      printf(" solve_time=%.3lf",progress.solve_time);
+    }
+    else
+    {
+      printf(" solve_time=-");
+    }
+    printf(" time=%.3lf depth=%i nodes=%llu nps=%llu\n",stats->total_time,stats->depth,stats->nodes,nps);
+    fflush(stdout);
+    
+    positions++;
+    if(is_scored)
+    {
+      scored++;
+    }
+    if(is_solved)
+    {
+      solved++;
+      solve_time_total+=progress.solve_time;
+    }
+    nodes_total+=stats->nodes;
+    time_total+=stats->total_time;
+    output_lock.unlock();
+    
+    if(move!=NULL)
+    {
+      NodeArena::node_free(move);
+    }
+    delete pos.board;
+  }
+  
+  ai->end();
+  delete ai;
+}
+
+//run every position in the file and print results to stdout
+bool EpdRunner::run(const char *fname)
+{
+  //make sure the settings are good before any threads start
+  AI *check=new AI();
+  check->init();
+  bool valid=true;
+  for(size_t i=0; i<options.size(); i++)
+  {
+    valid=check->set_ts_assignment(options[i]) && valid;
+  }
+  check->end();
+  delete check;
+  if(!valid)
+  {
+    return false;
+  }
+  
+  //a directory of save files is loaded all at once; they're small packed positions, so even a big archive fits
+  struct stat file_stat;
+  if(stat(fname,&file_stat)==0 && S_ISDIR(file_stat.st_mode))
+  {
+    if(Board::load_directory(fname,&saved)<0)
+    {
+      return false;
+    }
+  }
+  else
+  {
+    input=fopen(fname,"r");
+    if(input==NULL)
+    {
+      fprintf(stderr,"Err: Could not open EPD file %s\n",fname);
+      return false;
+    }
+  }
+  
+  vector<thread> workers;
+  for(unsigned int i=0; i<thread_count; i++)
+  {
+    workers.push_back(thread(&EpdRunner::worker,this));
+  }
+  for(unsigned int i=0; i<thread_count; i++)
+  {
+    workers[i].join();
+  }
+  
+  if(input!=NULL)
+  {
+    fclose(input);
+    input=NULL;
+  }
+  saved.clear();
+  
+  //nps is per thread, so it can be compared with a single search
+  double solve_rate=(scored>0)? ((double)(solved)/scored) : 0;
+  double avg_solve_time=(solved>0)? (solve_time_total/solved) : 0;
+  unsigned long long nps=(time_total>0)? (unsigned long long)(nodes_total/time_total) : 0;
+  printf("epd_summary positions=%i scored=%i solved=%i solve_rate=%.3lf avg_solve_time=%.3lf nodes=%llu nps=%llu threads=%u\n",positions,scored,solved,solve_rate,avg_solve_time,nodes_total,nps,thread_count);
+  fflush(stdout);
+  
+  return true;
+}
+
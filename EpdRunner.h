@@ -0,0 +1,108 @@
+
+#ifndef EPDRUNNER_H
+#define EPDRUNNER_H
+
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "Board.h"
+#include "AI.h"
+#include "SearchStats.h"
+
+using namespace std;
+
+//the longest EPD line we'll read
+#define EPD_LINE_SIZE 4096
+//the most best (or avoid) moves a position can list
+#define EPD_MAX_MOVES 16
+
+struct _EpdPosition;
+
+//one position from an EPD file, with the operations the runner cares about
+struct _EpdPosition
+{
+  //where in the file this was (1 for the first position)
+  int index;
+  
+  Board *board;
+  int player_id;
+  
+  //the id operation, if there was one
+  char id[BUFFER_SIZE];
+  
+  //bm (best move) and am (avoid move) operations; a move solves the position if it's one of the best moves
+  //(when there are any) and none of the moves to avoid
+  _Move best_moves[EPD_MAX_MOVES];
+  int best_move_count;
+  _Move avoid_moves[EPD_MAX_MOVES];
+  int avoid_move_count;
+  
+  //the bm/am operands as written, for the output
+  char expected[BUFFER_SIZE];
+};
+
+//runs a tactical test suite from an EPD file
+//
+//every position is searched with the same limit (a time per position or a depth) by a pool of worker threads,
+//each with its own AI (with the default settings, or whatever options are given)
+//results are printed a line per position as they finish, so a long suite can run unattended and be read as it goes,
+//then a summary line with the solve rate; each line is a list of key=value pairs like search_stats, so it's easy to script
+class EpdRunner
+{
+private:
+  //the file being read, and the next position number; workers take positions one line at a time under input_lock
+  FILE *input;
+  //or the positions loaded from a directory of save files, when there's no file
+  vector<_SavedPosition> saved;
+  int next_index;
+  mutex input_lock;
+  mutex output_lock;
+  
+  //search limits (depth_limit is only used when time_limit is not positive)
+  double time_limit;
+  int depth_limit;
+  unsigned int thread_count;
+  
+  //settings given for every worker's AI (as option=value strings)
+  vector<char*> options;
+  
+  //totals over every finished position
+  int positions;
+  int scored;
+  int solved;
+  double solve_time_total;
+  unsigned long long nodes_total;
+  double time_total;
+  
+  //read the next position from the file (skipping blank or broken lines) or the saved positions; false when there are no more
+  bool next_position(_EpdPosition *pos);
+  
+  //one worker thread; searches positions until there are none left
+  void worker();
+  
+  //called after every iteration of a search, to keep track of when the right move was found
+  static void iteration_hook(_SearchStats *stats, void *hook_data);
+
+public:
+  //time_limit is seconds per position; when it's 0 or less, depth_limit is used instead
+  //thread_count of 0 means one thread per core
+  EpdRunner(double time_limit, int depth_limit, unsigned int thread_count);
+  ~EpdRunner();
+  
+  //an AI setting (option=value, as at the interactive prompt) for every worker
+  void add_option(const char *option);
+  
+  //parse one line of EPD into pos (its board is made here; delete it when done)
+  //returns false if the line isn't a position (blank, a comment, or a bad FEN)
+  static bool parse_epd(const char *line, _EpdPosition *pos);
+  //true if move solves the position (see _EpdPosition); positions with no bm or am can't be solved
+  static bool solves(_EpdPosition *pos, _Move *move);
+  
+  //run every position in the file and print results to stdout; false if the file couldn't be opened or an option wasn't valid
+  //fname can also be a directory of save files (.bst or .fen), which are all loaded first, then run with the files' names as ids
+  bool run(const char *fname);
+};
+
+#endif
+
@@ -0,0 +1,515 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "GameStore.h"
+#include "Notation.h"
+
+//file headers, and the current version of each
+#define GAMES_MAGIC "FCGS"
+#define INDEX_MAGIC "FCGI"
+#define GAMES_VERSION 1
+#define GAMES_HEADER_SIZE 8
+//the fixed part of a record (after the size), and the size of a ply
+#define GAMES_RECORD_FIXED 4
+#define GAMES_PLY_SIZE 8
+//reads and writes go through a buffer this big, so a game is never more than one system call
+#define GAMES_BUFFER_SIZE (1<<20)
+//the most plies a record can hold (the ply count is 16 bits), and so the biggest a record can be
+#define GAMES_MAX_PLIES 65535
+#define GAMES_MAX_RECORD (GAMES_RECORD_FIXED+1+FEN_SIZE+(GAMES_MAX_PLIES*GAMES_PLY_SIZE))
+
+static void games_put16(unsigned char *buffer, unsigned int value)
+{
+  buffer[0]=value&0xff;
+  buffer[1]=(value>>8)&0xff;
+}
+
+static void games_put32(unsigned char *buffer, unsigned int value)
+{
+  games_put16(buffer,value&0xffff);
+  games_put16(buffer+2,value>>16);
+}
+
+static void games_put64(unsigned char *buffer, unsigned long long value)
+{
+  games_put32(buffer,value&0xffffffff);
+  games_put32(buffer+4,value>>32);
+}
+
+static unsigned int games_get16(const unsigned char *buffer)
+{
+  return buffer[0]|(buffer[1]<<8);
+}
+
+static unsigned int games_get32(const unsigned char *buffer)
+{
+  return games_get16(buffer)|(games_get16(buffer+2)<<16);
+}
+
+static unsigned long long games_get64(const unsigned char *buffer)
+{
+  return games_get32(buffer)|(((unsigned long long)(games_get32(buffer+4)))<<32);
+}
+
+//write a file header; false if it couldn't be written
+static bool games_write_header(FILE *fp, const char *magic)
+{
+  unsigned char header[GAMES_HEADER_SIZE];
+  memcpy(header,magic,4);
+  games_put16(header+4,GAMES_VERSION);
+  games_put16(header+6,0);
+  return fwrite(header,GAMES_HEADER_SIZE,1,fp)==1;
+}
+
+//read and check a file header
+static bool games_read_header(FILE *fp, const char *magic)
+{
+  unsigned char header[GAMES_HEADER_SIZE];
+  return fread(header,GAMES_HEADER_SIZE,1,fp)==1 && !memcmp(header,magic,4) && games_get16(header+4)==GAMES_VERSION;
+}
+
+GameStore::GameStore()
+{
+  games_fp=NULL;
+  index_fp=NULL;
+  appending=false;
+  end_offset=0;
+}
+
+GameStore::~GameStore()
+{
+  close();
+}
+
+//read one game from where the file is now
+bool GameStore::read_record(_GameRecord *game)
+{
+  unsigned char size_bytes[4];
+  if(fread(size_bytes,4,1,games_fp)!=1)
+  {
+    return false;
+  }
+  unsigned int size=games_get32(size_bytes);
+  
+  //the record is read all at once; games are small, so this buffer only grows a few times
+  static thread_local vector<unsigned char> record;
+  record.resize((size>GAMES_RECORD_FIXED)? size : GAMES_RECORD_FIXED);
+  if(size<GAMES_RECORD_FIXED || size>GAMES_MAX_RECORD || fread(&(record[0]),size,1,games_fp)!=1)
+  {
+    fprintf(stderr,"Err: Damaged game record in store; stopping there\n");
+    return false;
+  }
+  
+  game->result=record[0];
+  int flags=record[1];
+  unsigned int plies=games_get16(&(record[2]));
+  size_t pos=GAMES_RECORD_FIXED;
+  game->fen[0]='\0';
+  if(flags&1)
+  {
+    size_t length=(pos<size)? record[pos] : 0;
+    pos++;
+    if(length>=FEN_SIZE || pos+length>size)
+    {
+      fprintf(stderr,"Err: Damaged game record in store; stopping there\n");
+      return false;
+    }
+    memcpy(game->fen,&(record[pos]),length);
+    game->fen[length]='\0';
+    pos+=length;
+  }
+  if(pos+(plies*GAMES_PLY_SIZE)!=size)
+  {
+    fprintf(stderr,"Err: Damaged game record in store; stopping there\n");
+    return false;
+  }
+  
+  game->moves.resize(plies);
+  for(unsigned int i=0; i<plies; i++)
+  {
+    const unsigned char *ply=&(record[pos+(i*GAMES_PLY_SIZE)]);
+    game->moves[i].move=games_get16(ply);
+    game->moves[i].eval=(short)(games_get16(ply+2));
+    game->moves[i].time_ms=games_get32(ply+4);
+  }
+  return true;
+}
+
+//find where every game starts by reading through them
+bool GameStore::scan_offsets(const char *fname, bool write)
+{
+  offsets.clear();
+  fseek(games_fp,GAMES_HEADER_SIZE,SEEK_SET);
+  while(true)
+  {
+    long offset=ftell(games_fp);
+    unsigned char size_bytes[4];
+    if(fread(size_bytes,4,1,games_fp)!=1)
+    {
+      break;
+    }
+    //(a record cut short at the end of the file, from a writer that died part way, isn't counted)
+    unsigned int size=games_get32(size_bytes);
+    if(size>GAMES_MAX_RECORD || fseek(games_fp,size,SEEK_CUR)!=0 || (unsigned long long)(ftell(games_fp))>end_offset)
+    {
+      break;
+    }
+    offsets.push_back(offset);
+  }
+  if(!write)
+  {
+    return true;
+  }
+  
+  char index_fname[BUFFER_SIZE];
+  snprintf(index_fname,BUFFER_SIZE,"%s.idx",fname);
+  FILE *fp=fopen(index_fname,"wb");
+  if(fp==NULL)
+  {
+    fprintf(stderr,"Err: Could not write index %s\n",index_fname);
+    return false;
+  }
+  bool written=games_write_header(fp,INDEX_MAGIC);
+  for(size_t i=0; i<offsets.size() && written; i++)
+  {
+    unsigned char entry[8];
+    games_put64(entry,offsets[i]);
+    written=(fwrite(entry,8,1,fp)==1);
+  }
+  written=(fclose(fp)==0) && written;
+  if(!written)
+  {
+    fprintf(stderr,"Err: Could not write index %s\n",index_fname);
+  }
+  return written;
+}
+
+//open a store to append games to or to read them
+bool GameStore::open(const char *fname, bool append)
+{
+  close();
+  appending=append;
+  
+  struct stat file_stat;
+  bool exists=(stat(fname,&file_stat)==0 && file_stat.st_size>0);
+  if(!exists && !append)
+  {
+    fprintf(stderr,"Err: Could not open game store %s\n",fname);
+    return false;
+  }
+  
+  //a new store just needs its header
+  if(!exists)
+  {
+    FILE *fp=fopen(fname,"wb");
+    if(fp==NULL || !games_write_header(fp,GAMES_MAGIC) || fclose(fp)!=0)
+    {
+      fprintf(stderr,"Err: Could not make game store %s\n",fname);
+      return false;
+    }
+  }
+  
+  games_fp=fopen(fname,"rb");
+  if(games_fp!=NULL)
+  {
+    setvbuf(games_fp,NULL,_IOFBF,GAMES_BUFFER_SIZE);
+  }
+  if(games_fp==NULL || !games_read_header(games_fp,GAMES_MAGIC))
+  {
+    fprintf(stderr,"Err: %s isn't a game store\n",fname);
+    close();
+    return false;
+  }
+  fseek(games_fp,0,SEEK_END);
+  end_offset=ftell(games_fp);
+  
+  //the index is good if it covers every game (the last one it has ends right at the end of the file)
+  char index_fname[BUFFER_SIZE];
+  snprintf(index_fname,BUFFER_SIZE,"%s.idx",fname);
+  bool index_good=false;
+  FILE *fp=fopen(index_fname,"rb");
+  if(fp!=NULL)
+  {
+    setvbuf(fp,NULL,_IOFBF,GAMES_BUFFER_SIZE);
+  }
+  if(fp!=NULL && games_read_header(fp,INDEX_MAGIC))
+  {
+    unsigned char entry[8];
+    while(fread(entry,8,1,fp)==1)
+    {
+      offsets.push_back(games_get64(entry));
+    }
+    unsigned long long last_end=GAMES_HEADER_SIZE;
+    unsigned char size_bytes[4];
+    if(!offsets.empty() && fseek(games_fp,offsets.back(),SEEK_SET)==0 && fread(size_bytes,4,1,games_fp)==1)
+    {
+      last_end=offsets.back()+4+games_get32(size_bytes);
+    }
+    index_good=(last_end==end_offset);
+  }
+  if(fp!=NULL)
+  {
+    fclose(fp);
+  }
+  if(!index_good && !append && !offsets.empty())
+  {
+    fprintf(stderr,"Warn: The index for %s doesn't match its games; reading through them instead\n",fname);
+  }
+  if(!index_good && !scan_offsets(fname,append))
+  {
+    close();
+    return false;
+  }
+  
+  if(append)
+  {
+    //anything past the last whole game is a record cut short; new games go where it started
+    if(!offsets.empty())
+    {
+      unsigned char size_bytes[4];
+      fseek(games_fp,offsets.back(),SEEK_SET);
+      if(fread(size_bytes,4,1,games_fp)==1)
+      {
+        end_offset=offsets.back()+4+games_get32(size_bytes);
+      }
+    }
+    else
+    {
+      end_offset=GAMES_HEADER_SIZE;
+    }
+    fclose(games_fp);
+    games_fp=fopen(fname,"r+b");
+    index_fp=fopen(index_fname,"r+b");
+    if(games_fp==NULL || index_fp==NULL)
+    {
+      fprintf(stderr,"Err: Could not open game store %s for writing\n",fname);
+      close();
+      return false;
+    }
+    if(ftruncate(fileno(games_fp),end_offset)!=0)
+    {
+      fprintf(stderr,"Err: Could not open game store %s for writing\n",fname);
+      close();
+      return false;
+    }
+    setvbuf(games_fp,NULL,_IOFBF,GAMES_BUFFER_SIZE);
+    fseek(games_fp,end_offset,SEEK_SET);
+    fseek(index_fp,GAMES_HEADER_SIZE+(offsets.size()*8),SEEK_SET);
+    //nothing to look up while appending
+    offsets.clear();
+  }
+  else
+  {
+    rewind();
+  }
+  return true;
+}
+
+void GameStore::close()
+{
+  if(games_fp!=NULL)
+  {
+    fclose(games_fp);
+    games_fp=NULL;
+  }
+  if(index_fp!=NULL)
+  {
+    fclose(index_fp);
+    index_fp=NULL;
+  }
+  offsets.clear();
+}
+
+//add a game to the end of the store
+//the record goes first and the index entry after, so a crash part way leaves a store the index check will notice
+bool GameStore::append(const _GameRecord *game)
+{
+  if(games_fp==NULL || !appending)
+  {
+    return false;
+  }
+  
+  size_t fen_length=strlen(game->fen);
+  size_t plies=(game->moves.size()>GAMES_MAX_PLIES)? GAMES_MAX_PLIES : game->moves.size();
+  size_t size=GAMES_RECORD_FIXED+((fen_length>0)? (fen_length+1) : 0)+(plies*GAMES_PLY_SIZE);
+  vector<unsigned char> record(4+size);
+  games_put32(&(record[0]),size);
+  record[4]=game->result;
+  record[5]=(fen_length>0)? 1 : 0;
+  games_put16(&(record[6]),plies);
+  size_t pos=4+GAMES_RECORD_FIXED;
+  if(fen_length>0)
+  {
+    record[pos]=fen_length;
+    memcpy(&(record[pos+1]),game->fen,fen_length);
+    pos+=fen_length+1;
+  }
+  for(size_t i=0; i<plies; i++)
+  {
+    games_put16(&(record[pos]),game->moves[i].move);
+    games_put16(&(record[pos+2]),(unsigned short)(game->moves[i].eval));
+    games_put32(&(record[pos+4]),game->moves[i].time_ms);
+    pos+=GAMES_PLY_SIZE;
+  }
+  
+  unsigned char entry[8];
+  games_put64(entry,end_offset);
+  if(fwrite(&(record[0]),record.size(),1,games_fp)!=1 || fflush(games_fp)!=0 || fwrite(entry,8,1,index_fp)!=1 || fflush(index_fp)!=0)
+  {
+    fprintf(stderr,"Err: Could not write to game store\n");
+    return false;
+  }
+  end_offset+=record.size();
+  return true;
+}
+
+//go back to the first game
+void GameStore::rewind()
+{
+  if(games_fp!=NULL && !appending)
+  {
+    fseek(games_fp,GAMES_HEADER_SIZE,SEEK_SET);
+  }
+}
+
+//read the next game in the file
+bool GameStore::next_game(_GameRecord *game)
+{
+  if(games_fp==NULL || appending)
+  {
+    return false;
+  }
+  return read_record(game);
+}
+
+//read a game by number
+bool GameStore::read_game(size_t n, _GameRecord *game)
+{
+  if(games_fp==NULL || appending || n>=offsets.size() || fseek(games_fp,offsets[n],SEEK_SET)!=0)
+  {
+    return false;
+  }
+  return read_record(game);
+}
+
+//write a packed move in coordinate notation
+void GameStore::packed_to_coord(unsigned short packed, char *buffer)
+{
+  const char promote_types[]=" nbrq";
+  int promotion=(packed>>12)&7;
+  buffer[0]='a'+((packed>>6)&7);
+  buffer[1]='1'+((packed>>9)&7);
+  buffer[2]='a'+(packed&7);
+  buffer[3]='1'+((packed>>3)&7);
+  buffer[4]=(promotion>=1 && promotion<=4)? promote_types[promotion] : '\0';
+  buffer[5]='\0';
+}
+
+//the eval for a search score
+short GameStore::value_to_eval(double value)
+{
+  if(value>=HEURISTIC_MAXIMUM-MATE_PLIES)
+  {
+    return GAME_MATE-(int)(HEURISTIC_MAXIMUM-value);
+  }
+  if(value<=HEURISTIC_MINIMUM+MATE_PLIES)
+  {
+    return -GAME_MATE+(int)(value-HEURISTIC_MINIMUM);
+  }
+  
+  //anything else that big is cut short, so it can't be taken for a mate
+  double eval=value*100;
+  double limit=GAME_MATE-MATE_PLIES-1;
+  return (eval>limit)? (short)(limit) : (eval<-limit)? (short)(-limit) : (short)(eval+((eval<0)? -0.5 : 0.5));
+}
+
+//the moves to mate an eval means, or 0 if it isn't a mate
+int GameStore::eval_mate_moves(short eval)
+{
+  if(!GAME_IS_MATE(eval))
+  {
+    return 0;
+  }
+  //mating is an odd number of plies away, and being mated an even number
+  return (eval>0)? ((GAME_MATE-eval)+1)/2 : -(((GAME_MATE+eval)+1)/2);
+}
+
+//the eval for a mate in moves moves
+short GameStore::mate_eval(int moves)
+{
+  if(moves>MATE_PLIES/2)
+  {
+    moves=MATE_PLIES/2;
+  }
+  else if(moves<-(MATE_PLIES/2))
+  {
+    moves=-(MATE_PLIES/2);
+  }
+  return (moves>0)? GAME_MATE-((2*moves)-1) : -GAME_MATE-(2*moves);
+}
+
+//print games from a store, one line each
+//  game n=... result=... plies=... start="..." moves="e2e4 e7e5 ..." evals="31 -12 M3 ..." times="1.203 0.950 ..."
+//evals are in hundredths from the mover's side ("-" for none, M and the moves to mate for a mate, -M for being mated) and times are in seconds
+bool GameStore::dump(const char *fname, int n)
+{
+  GameStore store;
+  if(!store.open(fname,false))
+  {
+    return false;
+  }
+  if(n>0 && (size_t)(n)>store.game_count())
+  {
+    fprintf(stderr,"Err: There's no game %i in %s (it has %lu)\n",n,fname,(unsigned long)(store.game_count()));
+    return false;
+  }
+  
+  const char *results[]={"*","1-0","0-1","1/2-1/2"};
+  _GameRecord game;
+  unsigned long long plies=0;
+  int count=0;
+  int number=(n>0)? n : 1;
+  bool found=(n>0)? store.read_game(n-1,&game) : store.next_game(&game);
+  while(found)
+  {
+    printf("game n=%i result=%s plies=%lu start=\"%s\" moves=\"",number,results[game.result&3],(unsigned long)(game.moves.size()),(strlen(game.fen)>0)? game.fen : "startpos");
+    for(size_t i=0; i<game.moves.size(); i++)
+    {
+      char coord[COORD_MOVE_SIZE];
+      packed_to_coord(game.moves[i].move,coord);
+      printf("%s%s",(i>0)? " " : "",coord);
+    }
+    printf("\" evals=\"");
+    for(size_t i=0; i<game.moves.size(); i++)
+    {
+      if(game.moves[i].eval==GAME_NO_EVAL)
+      {
+        printf("%s-",(i>0)? " " : "");
+      }
+      else if(GAME_IS_MATE(game.moves[i].eval))
+      {
+        int moves=eval_mate_moves(game.moves[i].eval);
+        printf("%s%sM%i",(i>0)? " " : "",(moves<0)? "-" : "",abs(moves));
+      }
+      else
+      {
+        printf("%s%i",(i>0)? " " : "",game.moves[i].eval);
+      }
+    }
+    printf("\" times=\"");
+    for(size_t i=0; i<game.moves.size(); i++)
+    {
+      printf("%s%.3lf",(i>0)? " " : "",game.moves[i].time_ms/1000.0);
+    }
+    printf("\"\n");
+    
+    plies+=game.moves.size();
+    count++;
+    number++;
+    found=(n>0)? false : store.next_game(&game);
+  }
+  printf("game_store games=%i plies=%llu\n",count,plies);
+  return true;
+}
+
@@ -0,0 +1,116 @@
+
+#ifndef GAMESTORE_H
+#define GAMESTORE_H
+
+#include <stdio.h>
+#include <vector>
+#include "Board.h"
+#include "Position.h"
+#include "Notation.h"
+
+using namespace std;
+
+//game results, from white's side
+#define GAME_UNKNOWN 0
+#define GAME_WHITE_WINS 1
+#define GAME_BLACK_WINS 2
+#define GAME_DRAW 3
+
+//the eval of a move nobody searched (a book move, a human's move, or a search that didn't finish an iteration)
+#define GAME_NO_EVAL (-32768)
+//evals this close to the ends of the range are checkmates, GAME_MATE less the plies to mate (or the negative, for being mated);
+//every other eval is cut short of them
+#define GAME_MATE 32767
+#define GAME_IS_MATE(X) ((X)!=GAME_NO_EVAL && ((X)>=(GAME_MATE-MATE_PLIES) || (X)<=-(GAME_MATE-MATE_PLIES)))
+
+struct _GameMove;
+struct _GameRecord;
+
+//one move of a stored game
+struct _GameMove
+{
+  //the move, packed (see Notation::pack_move; castling is the king's own two-square move)
+  unsigned short move;
+  //what the search thought of the position after it, from the mover's side, in hundredths (GAME_NO_EVAL for none, and see GAME_MATE)
+  short eval;
+  //how long the move took, in milliseconds
+  unsigned int time_ms;
+};
+
+//a whole stored game
+struct _GameRecord
+{
+  //where the game started, as FEN (empty for the standard position)
+  char fen[FEN_SIZE];
+  int result;
+  vector<_GameMove> moves;
+};
+
+//an append-only file of games, for self-play and match output
+//
+//the file is an 8 byte header ("FCGS", version, 2 reserved bytes) and then games one after another, all numbers little-endian:
+//  record size (4 bytes; what's left of the record after this), result (1), flags (1; bit 0 is a start FEN), plies (2)
+//  the start FEN (a length byte then the text), when flag bit 0 is set
+//  then per ply: the packed move (2), eval (2, signed) and time in milliseconds (4)
+//so a game of 80 plies is about 650 bytes, and reading one is a single read with nothing to parse but fixed fields
+//
+//next to it is an index (the file name plus .idx) with the offset of every game (8 bytes each, after its own "FCGI" header), for random access
+//the index is only a convenience; if it's missing or doesn't match the games it's rebuilt by reading through them
+//
+//a store is opened either to append games or to read them; reading goes straight through the file in order (next_game)
+//or jumps to any game by number (read_game); either way only one game is in memory at a time
+class GameStore
+{
+private:
+  FILE *games_fp;
+  FILE *index_fp;
+  bool appending;
+  //where every game starts (when reading)
+  vector<unsigned long long> offsets;
+  //where the next game ends up (when appending)
+  unsigned long long end_offset;
+  
+  //read one game from where the file is now; false at the end of the file (or on a damaged record, with an error)
+  bool read_record(_GameRecord *game);
+  //find where every game starts by reading through them, and write that out as the index (when write is true)
+  bool scan_offsets(const char *fname, bool write);
+
+public:
+  GameStore();
+  ~GameStore();
+  
+  //open a store; with append it's made if it isn't there yet, otherwise it has to exist
+  //false (with an error) if it can't be opened or isn't a game store
+  bool open(const char *fname, bool append);
+  void close();
+  bool is_open(){ return games_fp!=NULL; }
+  
+  //add a game to the end of the store (and the index)
+  bool append(const _GameRecord *game);
+  
+  //how many games there are (when reading)
+  size_t game_count(){ return offsets.size(); }
+  //go back to the first game, for next_game
+  void rewind();
+  //read the next game in the file; false when there are no more
+  bool next_game(_GameRecord *game);
+  //read a game by number (0 is the first); false if there's no such game
+  //NOTE: next_game carries on from after this game
+  bool read_game(size_t n, _GameRecord *game);
+  
+  //write a packed move in coordinate notation; buffer must hold at least COORD_MOVE_SIZE chars
+  static void packed_to_coord(unsigned short packed, char *buffer);
+  
+  //the eval for a search score (in pawns, from the mover's side; mate scores as the search has them, see IS_MATE)
+  static short value_to_eval(double value);
+  //the moves to mate an eval means (negative for being mated, the way UCI has it), or 0 if it isn't a mate
+  static int eval_mate_moves(short eval);
+  //the eval for a mate in moves moves (negative for being mated)
+  static short mate_eval(int moves);
+  
+  //print games from a store, one line each (or just game n, counting from 1, when n is more than 0); false if it can't be read
+  static bool dump(const char *fname, int n);
+};
+
+#endif
+
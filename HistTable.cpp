@@ -67,7 +67,7 @@ _HistMove *HistTable::make_hist_move(Board *b)
   hist_move->result_in_check=false;
   
   //if the last move was a capture, store that correctly
-  if(b->get_moves_since_capture()==0)
+  if(b->last_move_captured())
   {
     hist_move->capture=true;
     hist_move->capture_type=(b->get_last_capture_type());
@@ -175,5 +175,22 @@ int HistTable::get_value(Board *b)
   return 0;
 }
 
-
+//halve every value (dropping the ones that get to 0)
+void HistTable::age()
+{
+  multimap<int, _HistMove *>::iterator i=history.begin();
+  while(i!=history.end())
+  {
+    ((*i).second)->history_value/=2;
+    if(((*i).second)->history_value==0)
+    {
+      free((*i).second);
+      history.erase(i++);
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
 
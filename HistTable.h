@@ -61,6 +61,9 @@ public:
   //if this move isn't in the history table, return 0
   //NOTE: b is the board AFTER the relevant move has been applied
   int get_value(Board *b);
+  
+  //halve every value (dropping the ones that get to 0), so what was learned a few searches ago counts for less than what was just learned
+  void age();
 };
 
 #endif
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "KillerTable.h"
+
+KillerTable::KillerTable()
+{
+  clear();
+}
+
+//forget every killer
+void KillerTable::clear()
+{
+  memset(killers,0,sizeof(killers));
+}
+
+//the root has moved on by plies moves
+void KillerTable::shift(int plies)
+{
+  if(plies<0 || plies>=KILLER_MAX_PLY)
+  {
+    clear();
+    return;
+  }
+  if(plies==0)
+  {
+    return;
+  }
+  
+  memmove(killers[0],killers[plies],(KILLER_MAX_PLY-plies)*sizeof(killers[0]));
+  memset(killers[KILLER_MAX_PLY-plies],0,plies*sizeof(killers[0]));
+}
+
+//remember a move that caused a cutoff at this ply
+void KillerTable::add(int ply, _Move *move)
+{
+  if(ply<0 || ply>=KILLER_MAX_PLY)
+  {
+    return;
+  }
+  
+  //a move that's already the newest killer stays where it is; otherwise the older one makes room
+  _Move *newest=&(killers[ply][0]);
+  if(newest->fromFile==move->fromFile && newest->fromRank==move->fromRank && newest->toFile==move->toFile && newest->toRank==move->toRank && newest->promoteType==move->promoteType)
+  {
+    return;
+  }
+  for(int slot=KILLER_SLOTS-1; slot>0; slot--)
+  {
+    killers[ply][slot]=killers[ply][slot-1];
+  }
+  killers[ply][0]=*move;
+}
+
+//the killer move in a slot at this ply
+_Move *KillerTable::get(int ply, int slot)
+{
+  if(ply<0 || ply>=KILLER_MAX_PLY || killers[ply][slot].fromFile==0)
+  {
+    return NULL;
+  }
+  return &(killers[ply][slot]);
+}
@@ -0,0 +1,38 @@
+
+#ifndef KILLERTABLE_H
+#define KILLERTABLE_H
+
+#include "structures.h"
+
+//how many plies from the root killer moves are kept for (deeper than this doesn't get any)
+#define KILLER_MAX_PLY 128
+//how many killer moves are kept per ply
+#define KILLER_SLOTS 2
+
+//killer moves; quiet moves (not captures) that caused a cutoff somewhere else at the same distance from the root
+//a move that refuted one line often refutes its siblings too, so these get searched right after the transposition table's move
+//
+//killers are by ply from the root, so when the game moves on they have to move with it (see shift)
+class KillerTable
+{
+private:
+  //fromFile is 0 in an empty slot; slot 0 is the most recent
+  _Move killers[KILLER_MAX_PLY][KILLER_SLOTS];
+
+public:
+  KillerTable();
+  
+  //forget every killer
+  void clear();
+  //the root has moved on by plies moves, so what was at ply n is now at ply n-plies
+  //(a negative count means the game went back or started over, so everything is cleared)
+  void shift(int plies);
+  
+  //remember a move that caused a cutoff at this ply
+  void add(int ply, _Move *move);
+  //the killer move in a slot at this ply (NULL if there isn't one)
+  _Move *get(int ply, int slot);
+};
+
+#endif
+
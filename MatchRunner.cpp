@@ -0,0 +1,374 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include "MatchRunner.h"
+#include "EpdRunner.h"
+#include "TreeSearch.h"
+
+MatchRunner::MatchRunner(int games, double time_limit, int depth_limit, unsigned int thread_count)
+{
+  this->games=games;
+  this->time_limit=time_limit;
+  this->depth_limit=depth_limit;
+  
+  //one thread per core unless told otherwise
+  if(thread_count==0)
+  {
+    thread_count=thread::hardware_concurrency();
+    if(thread_count==0)
+    {
+      thread_count=1;
+    }
+  }
+  this->thread_count=thread_count;
+  
+  next_game=0;
+  store=NULL;
+  strncpy(config_a,"",BUFFER_SIZE);
+  strncpy(config_b,"",BUFFER_SIZE);
+  
+  a_wins=0;
+  draws=0;
+  b_wins=0;
+  for(int side=0; side<2; side++)
+  {
+    nodes[side]=0;
+    search_time[side]=0;
+  }
+}
+
+MatchRunner::~MatchRunner()
+{
+  for(size_t i=0; i<openings.size(); i++)
+  {
+    free(openings[i]);
+  }
+  for(size_t i=0; i<options.size(); i++)
+  {
+    free(options[i]);
+  }
+  if(store!=NULL)
+  {
+    delete store;
+  }
+}
+
+void MatchRunner::set_config_a(const char *fname)
+{
+  strncpy(config_a,fname,BUFFER_SIZE-1);
+  config_a[BUFFER_SIZE-1]='\0';
+}
+
+void MatchRunner::set_config_b(const char *fname)
+{
+  strncpy(config_b,fname,BUFFER_SIZE-1);
+  config_b[BUFFER_SIZE-1]='\0';
+}
+
+//an AI setting (option=value) for both sides
+void MatchRunner::add_option(const char *option)
+{
+  options.push_back(strdup(option));
+}
+
+//read starting positions from a file of FEN or EPD lines
+//(EPD operations are ignored; the positions are stored as FEN so every game can make its own board)
+bool MatchRunner::load_openings(const char *fname)
+{
+  FILE *fp=fopen(fname,"r");
+  if(fp==NULL)
+  {
+    fprintf(stderr,"Err: Could not open openings file %s\n",fname);
+    return false;
+  }
+  
+  char line[EPD_LINE_SIZE];
+  while(fgets(line,EPD_LINE_SIZE,fp)!=NULL)
+  {
+    _EpdPosition pos;
+    if(!EpdRunner::parse_epd(line,&pos))
+    {
+      continue;
+    }
+    
+    char fen[FEN_SIZE];
+    pos.board->to_fen(pos.player_id,fen);
+    openings.push_back(strdup(fen));
+    delete pos.board;
+  }
+  fclose(fp);
+  
+  if(openings.empty())
+  {
+    fprintf(stderr,"Err: No positions in openings file %s\n",fname);
+    return false;
+  }
+  return true;
+}
+
+//add every game played to a game store
+bool MatchRunner::set_game_store(const char *fname)
+{
+  GameStore *new_store=new GameStore();
+  if(!new_store->open(fname,true))
+  {
+    delete new_store;
+    return false;
+  }
+  if(store!=NULL)
+  {
+    delete store;
+  }
+  store=new_store;
+  return true;
+}
+
+//make an AI with the given settings file and the options
+AI *MatchRunner::make_ai(const char *config)
+{
+  AI *ai=new AI();
+  ai->init();
+  bool valid=(strlen(config)==0 || ai->load_options(config));
+  for(size_t i=0; i<options.size(); i++)
+  {
+    valid=ai->set_ts_assignment(options[i]) && valid;
+  }
+  
+  if(!valid)
+  {
+    ai->end();
+    delete ai;
+    return NULL;
+  }
+  return ai;
+}
+
+//the Elo difference for a result, and half the width of its 95% confidence interval
+//the interval comes from the standard error of the per-game score, so draws narrow it like they should
+void MatchRunner::elo_estimate(int wins, int draws, int losses, double *elo, double *elo_error)
+{
+  int total=wins+draws+losses;
+  if(total==0)
+  {
+    *elo=0;
+    *elo_error=0;
+    return;
+  }
+  
+  double score=(wins+(draws*0.5))/total;
+  double variance=((wins*(1-score)*(1-score))+(draws*(0.5-score)*(0.5-score))+(losses*score*score))/total;
+  double score_error=1.96*sqrt(variance/total);
+  
+  //the Elo formula goes to infinity at a score of 0 or 1, so keep everything just inside that
+  double low=score-score_error;
+  double high=score+score_error;
+  double bounds[3]={score,low,high};
+  double elos[3];
+  for(int i=0; i<3; i++)
+  {
+    if(bounds[i]<0.001)
+    {
+      bounds[i]=0.001;
+    }
+    else if(bounds[i]>0.999)
+    {
+      bounds[i]=0.999;
+    }
+    elos[i]=-400*log10((1/bounds[i])-1);
+  }
+  
+  *elo=elos[0];
+  *elo_error=(elos[2]-elos[1])/2;
+}
+
+//take the next game to play; -1 when there are none left
+int MatchRunner::take_game()
+{
+  game_lock.lock();
+  int game=-1;
+  if(next_game<games)
+  {
+    game=next_game;
+    next_game++;
+  }
+  game_lock.unlock();
+  return game;
+}
+
+//one worker thread; plays games until there are none left
+void MatchRunner::worker()
+{
+  //index 0 is a, 1 is b
+  AI *players[2];
+  players[0]=make_ai(config_a);
+  players[1]=make_ai(config_b);
+  
+  bool time_limited=(time_limit>0);
+  
+  for(int game=take_game(); game>=0; game=take_game())
+  {
+    //games come in pairs from the same opening, a playing white first
+    int opening=(game/2);
+    bool a_white=((game%2)==0);
+    
+    Board *board=new Board();
+    int player_id=WHITE;
+    _GameRecord record;
+    strncpy(record.fen,"",FEN_SIZE);
+    if(!openings.empty())
+    {
+      board->from_fen(openings[opening%openings.size()],&player_id);
+      strncpy(record.fen,openings[opening%openings.size()],FEN_SIZE-1);
+      record.fen[FEN_SIZE-1]='\0';
+    }
+    
+    //nothing carries over from the last game
+    for(int side=0; side<2; side++)
+    {
+      players[side]->clear_moves();
+      players[side]->clear_search_state();
+    }
+    
+    unsigned long long game_nodes[2]={0,0};
+    double game_time[2]={0,0};
+    
+    //the result is from white's side; 1 for a win, 0 for a loss, 0.5 for a draw
+    double white_score=0.5;
+    const char *reason="max_plies";
+    int ply;
+    for(ply=0; ply<MATCH_MAX_PLIES; ply++)
+    {
+      //the same end-of-game checks as an interactive game
+      vector<_Move*> legal_moves=TreeSearch::generate_moves(board,player_id);
+      size_t legal_move_count=legal_moves.size();
+      board->clear_children();
+      
+      if(legal_move_count==0 && board->get_check(player_id))
+      {
+        white_score=(player_id==WHITE)? 0 : 1;
+        reason="checkmate";
+        break;
+      }
+      else if(legal_move_count==0 || TreeSearch::stalemate(board,players[0]->get_moves()))
+      {
+        white_score=0.5;
+        reason="stalemate";
+        break;
+      }
+      
+      int side=((player_id==WHITE)==a_white)? 0 : 1;
+      _Move *move=players[side]->search_move(board,player_id,depth_limit,time_limited,time_limit,0,0,true,NULL);
+      _SearchStats *stats=players[side]->get_stats();
+      game_nodes[side]+=stats->nodes;
+      game_time[side]+=stats->total_time;
+      
+      //the eval is in hundredths, like UCI's centipawns, with mates kept apart (see GAME_MATE)
+      _GameMove game_move;
+      game_move.eval=GAME_NO_EVAL;
+      if(move!=NULL && stats->have_best)
+      {
+        game_move.eval=GameStore::value_to_eval(stats->value);
+      }
+      game_move.time_ms=(unsigned int)(stats->total_time*1000);
+      
+      //if even the first iteration didn't finish, any legal move is better than none
+      if(move==NULL)
+      {
+        legal_moves=TreeSearch::generate_moves(board,player_id);
+        move=board->copy_move(legal_moves[0]);
+        board->clear_children();
+      }
+      
+      game_move.move=Notation::pack_move(board,move,false);
+      record.moves.push_back(game_move);
+      
+      board->apply_move(move,true);
+      
+      //both sides need the whole game for repetition checks
+      players[0]->remember_move(board->copy_move(move));
+      players[1]->remember_move(board->copy_move(move));
+      
+      player_id=(player_id==WHITE)? BLACK : WHITE;
+    }
+    delete board;
+    
+    double a_score=a_white? white_score : (1-white_score);
+    const char *result=(white_score==1)? "1-0" : (white_score==0)? "0-1" : "1/2-1/2";
+    record.result=(white_score==1)? GAME_WHITE_WINS : (white_score==0)? GAME_BLACK_WINS : GAME_DRAW;
+    
+    output_lock.lock();
+    if(store!=NULL)
+    {
+      store->append(&record);
+    }
+    printf("match game=%i opening=%i white=%s result=%s a_score=%.1lf reason=%s plies=%i a_nodes=%llu b_nodes=%llu\n",game+1,openings.empty()? 0 : (int)((opening%openings.size())+1),a_white? "a" : "b",result,a_score,reason,ply,game_nodes[0],game_nodes[1]);
+    fflush(stdout);
+    
+    if(a_score==1)
+    {
+      a_wins++;
+    }
+    else if(a_score==0)
+    {
+      b_wins++;
+    }
+    else
+    {
+      draws++;
+    }
+    for(int side=0; side<2; side++)
+    {
+      nodes[side]+=game_nodes[side];
+      search_time[side]+=game_time[side];
+    }
+    output_lock.unlock();
+  }
+  
+  for(int side=0; side<2; side++)
+  {
+    players[side]->end();
+    delete players[side];
+  }
+}
+
+//play every game and print results to stdout
+bool MatchRunner::run()
+{
+  //make sure both settings files are good before any threads start
+  const char *configs[2]={config_a,config_b};
+  for(int side=0; side<2; side++)
+  {
+    AI *ai=make_ai(configs[side]);
+    if(ai==NULL)
+    {
+      return false;
+    }
+    ai->end();
+    delete ai;
+  }
+  
+  vector<thread> workers;
+  for(unsigned int i=0; i<thread_count; i++)
+  {
+    workers.push_back(thread(&MatchRunner::worker,this));
+  }
+  for(unsigned int i=0; i<thread_count; i++)
+  {
+    workers[i].join();
+  }
+  
+  double elo;
+  double elo_error;
+  elo_estimate(a_wins,draws,b_wins,&elo,&elo_error);
+  
+  //nps is per thread, so it can be compared with a single search
+  unsigned long long a_nps=(search_time[0]>0)? (unsigned long long)(nodes[0]/search_time[0]) : 0;
+  unsigned long long b_nps=(search_time[1]>0)? (unsigned long long)(nodes[1]/search_time[1]) : 0;
+  int total=a_wins+draws+b_wins;
+  double score=(total>0)? ((a_wins+(draws*0.5))/total) : 0;
+  printf("match_summary games=%i a_wins=%i draws=%i b_wins=%i a_score=%.3lf elo=%.1lf elo_error=%.1lf a_nps=%llu b_nps=%llu threads=%u\n",total,a_wins,draws,b_wins,score,elo,elo_error,a_nps,b_nps,thread_count);
+  fflush(stdout);
+  
+  return true;
+}
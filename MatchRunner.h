@@ -0,0 +1,93 @@
+
+#ifndef MATCHRUNNER_H
+#define MATCHRUNNER_H
+
+#include <stdio.h>
+#include <mutex>
+#include <vector>
+#include "Board.h"
+#include "AI.h"
+#include "GameStore.h"
+
+using namespace std;
+
+//games that go on this long (in plies) are called a draw
+#define MATCH_MAX_PLIES 400
+
+//plays games between two AI configurations (a and b) to tell which is stronger
+//
+//games come in pairs from the same opening with colors swapped, so neither side gets the better half of an opening
+//every game is played by a pool of worker threads, each with its own pair of AIs; each search gets the same limit (a time per move or a depth)
+//a line is printed for every game as it finishes, then a summary with wins/draws/losses from a's side, the Elo difference and its error,
+//and the nodes per second of each side; lines are key=value pairs like search_stats, so it's easy to script
+//games can also be kept in a game store, with every move's eval and time, for going over later
+class MatchRunner
+{
+private:
+  int games;
+  int next_game;
+  mutex game_lock;
+  mutex output_lock;
+  
+  //search limits (depth_limit is only used when time_limit is not positive)
+  double time_limit;
+  int depth_limit;
+  unsigned int thread_count;
+  
+  //settings files for a and b (empty for the defaults)
+  char config_a[BUFFER_SIZE];
+  char config_b[BUFFER_SIZE];
+  
+  //settings for both sides (as option=value strings), applied after the settings files
+  vector<char*> options;
+  
+  //starting positions, as FEN (empty to start every game from the standard position)
+  vector<char*> openings;
+  
+  //where to keep every game played (NULL for nowhere)
+  GameStore *store;
+  
+  //totals from a's side
+  int a_wins;
+  int draws;
+  int b_wins;
+  //search counts for each side, for their nodes per second
+  unsigned long long nodes[2];
+  double search_time[2];
+  
+  //take the next game to play; -1 when there are none left
+  int take_game();
+  
+  //one worker thread; plays games until there are none left
+  void worker();
+  
+  //make an AI with the given settings file and the options (NULL if the file can't be read or a setting isn't valid)
+  AI *make_ai(const char *config);
+
+public:
+  //time_limit is seconds per move; when it's 0 or less, depth_limit is used instead
+  //thread_count of 0 means one thread per core
+  MatchRunner(int games, double time_limit, int depth_limit, unsigned int thread_count);
+  ~MatchRunner();
+  
+  //settings files for the two sides (see AI::load_options); not calling these means the default settings
+  void set_config_a(const char *fname);
+  void set_config_b(const char *fname);
+  //an AI setting (option=value) for both sides, on top of their settings files
+  void add_option(const char *option);
+  
+  //read starting positions from a file of FEN or EPD lines; false if it couldn't be read or had no positions
+  bool load_openings(const char *fname);
+  
+  //add every game played to a game store (made if it isn't there yet); false if it can't be opened
+  bool set_game_store(const char *fname);
+  
+  //the Elo difference for a result (from the side with the wins), and half the width of its 95% confidence interval
+  static void elo_estimate(int wins, int draws, int losses, double *elo, double *elo_error);
+  
+  //play every game and print results to stdout; false if a side's settings couldn't be loaded
+  bool run();
+};
+
+#endif
+
@@ -0,0 +1,188 @@
+#include "NodeArena.h"
+
+//every allocation from node_malloc is preceded by one of these, so node_free knows where it came from
+//(the union pads it out so the memory after it stays aligned)
+union _NodeHeader
+{
+  struct
+  {
+    //the arena this came from, or NULL if it came from malloc
+    NodeArena *owner;
+    //how big the allocation was (not counting this header)
+    size_t size;
+  } info;
+  long double align;
+};
+
+thread_local NodeArena *NodeArena::active=NULL;
+
+NodeArena::NodeArena()
+{
+  chunk_idx=0;
+  chunk_used=0;
+  size_class_count=0;
+}
+
+NodeArena::~NodeArena()
+{
+  for(size_t i=0; i<chunks.size(); i++)
+  {
+    free(chunks[i]);
+  }
+  
+  //DEFENSIVE: don't leave a dangling pointer as the active arena
+  if(active==this)
+  {
+    active=NULL;
+  }
+}
+
+//get memory from the current chunk, moving on to (or making) the next chunk as needed
+void *NodeArena::carve(size_t size)
+{
+  //DEFENSIVE: nothing we allocate should ever be this big
+  if(size>chunk_size)
+  {
+    return NULL;
+  }
+  
+  //if this doesn't fit in what's left of the current chunk, go to the next one
+  if(chunks.empty() || (chunk_used+size)>chunk_size)
+  {
+    if(!chunks.empty())
+    {
+      chunk_idx++;
+    }
+    
+    //we only make new chunks when all of the ones from previous searches are in use
+    if(chunk_idx>=chunks.size())
+    {
+      char *chunk=(char*)(malloc(chunk_size));
+      if(chunk==NULL)
+      {
+        return NULL;
+      }
+      chunks.push_back(chunk);
+      chunk_idx=chunks.size()-1;
+    }
+    chunk_used=0;
+  }
+  
+  void *ptr=chunks[chunk_idx]+chunk_used;
+  chunk_used+=size;
+  return ptr;
+}
+
+//allocate memory in this arena
+//anything freed earlier with the same size is re-used first
+void *NodeArena::alloc(size_t size)
+{
+  //round up so everything carved out of a chunk stays aligned
+  size=(size+sizeof(_NodeHeader)-1)/sizeof(_NodeHeader)*sizeof(_NodeHeader);
+  
+  for(int i=0; i<size_class_count; i++)
+  {
+    if(free_sizes[i]==size && free_heads[i]!=NULL)
+    {
+      void *ptr=free_heads[i];
+      //the first bytes of a free block hold the next free block
+      free_heads[i]=*((void**)(ptr));
+      return ptr;
+    }
+  }
+  
+  return carve(size);
+}
+
+//put memory back in the free list for its size
+void NodeArena::release(void *ptr, size_t size)
+{
+  size=(size+sizeof(_NodeHeader)-1)/sizeof(_NodeHeader)*sizeof(_NodeHeader);
+  
+  int size_class=-1;
+  for(int i=0; i<size_class_count; i++)
+  {
+    if(free_sizes[i]==size)
+    {
+      size_class=i;
+      break;
+    }
+  }
+  
+  //a size we haven't seen before gets its own list, if there's room for one
+  //(if not, this memory is just lost until the next reset)
+  if(size_class<0)
+  {
+    if(size_class_count>=max_size_classes)
+    {
+      return;
+    }
+    size_class=size_class_count;
+    free_sizes[size_class]=size;
+    free_heads[size_class]=NULL;
+    size_class_count++;
+  }
+  
+  *((void**)(ptr))=free_heads[size_class];
+  free_heads[size_class]=ptr;
+}
+
+//forget every allocation at once; chunks are kept, so this is constant time
+void NodeArena::reset()
+{
+  chunk_idx=0;
+  chunk_used=0;
+  
+  //the free lists point into the chunks, so they're forgotten too
+  size_class_count=0;
+}
+
+//set which arena node_malloc uses on this thread (NULL for plain malloc)
+void NodeArena::set_active(NodeArena *arena)
+{
+  active=arena;
+}
+
+//malloc replacement for search structures
+//returns NULL when out of memory, just like malloc
+void *NodeArena::node_malloc(size_t size)
+{
+  _NodeHeader *header;
+  if(active!=NULL)
+  {
+    header=(_NodeHeader*)(active->alloc(sizeof(_NodeHeader)+size));
+  }
+  else
+  {
+    header=(_NodeHeader*)(malloc(sizeof(_NodeHeader)+size));
+  }
+  
+  if(header==NULL)
+  {
+    return NULL;
+  }
+  
+  header->info.owner=active;
+  header->info.size=size;
+  return header+1;
+}
+
+//free replacement for search structures
+void NodeArena::node_free(void *ptr)
+{
+  if(ptr==NULL)
+  {
+    return;
+  }
+  
+  _NodeHeader *header=((_NodeHeader*)(ptr))-1;
+  if(header->info.owner!=NULL)
+  {
+    header->info.owner->release(header,sizeof(_NodeHeader)+header->info.size);
+  }
+  else
+  {
+    free(header);
+  }
+}
+
@@ -0,0 +1,66 @@
+
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+//a pool allocator for the memory a tree search churns through (Board nodes, _SuperPiece, _Move)
+//
+//memory is carved out of large chunks, and anything freed goes on a free list for its size to be handed out again
+//so during a search nothing goes through malloc/free at all once the pool has warmed up
+//reset() throws everything away at once (in constant time) and keeps the chunks for the next search
+//
+//an arena is only used from one thread; whichever arena is active on a thread is where node_malloc gets memory from
+//when no arena is active node_malloc falls back to plain malloc, so code outside a search doesn't need to care
+class NodeArena
+{
+private:
+  //how big each chunk of memory is (allocations are all much smaller than this)
+  static const size_t chunk_size=1<<20;
+  //how many different allocation sizes get their own free list
+  static const int max_size_classes=8;
+  
+  //every chunk this arena has allocated; these are kept between resets
+  vector<char*> chunks;
+  //which chunk we're currently carving from, and how far into it we are
+  size_t chunk_idx;
+  size_t chunk_used;
+  
+  //freed memory, by size, waiting to be used again
+  size_t free_sizes[max_size_classes];
+  void *free_heads[max_size_classes];
+  int size_class_count;
+  
+  //the arena node_malloc uses on this thread (NULL for none)
+  static thread_local NodeArena *active;
+  
+  //get memory from the current chunk, moving on to (or making) the next chunk as needed
+  void *carve(size_t size);
+
+public:
+  NodeArena();
+  //frees all the chunks (anything still using arena memory must be gone by now)
+  ~NodeArena();
+  
+  //allocate and free memory in this arena
+  void *alloc(size_t size);
+  void release(void *ptr, size_t size);
+  
+  //forget every allocation at once; chunks are kept, so this is constant time
+  void reset();
+  
+  //set which arena node_malloc uses on this thread (NULL for plain malloc)
+  static void set_active(NodeArena *arena);
+  static NodeArena *get_active(){ return active; }
+  
+  //malloc/free replacements for search structures
+  //node_free works on memory from any arena or from plain malloc, regardless of which arena is active
+  static void *node_malloc(size_t size);
+  static void node_free(void *ptr);
+};
+
+#endif
+
@@ -0,0 +1,376 @@
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Notation.h"
+#include "TreeSearch.h"
+
+//write a move in coordinate notation (from square, to square, and a lower-case promotion letter if it promotes)
+void Notation::move_to_coord(Board *board, _Move *move, char *buffer)
+{
+  int n=0;
+  buffer[n++]=(char)(move->fromFile+'a'-1);
+  buffer[n++]=(char)(move->fromRank+'0');
+  buffer[n++]=(char)(move->toFile+'a'-1);
+  buffer[n++]=(char)(move->toRank+'0');
+  
+  //only a pawn getting to the last rank has a promotion type that means anything
+  //(every other move carries a queen there, but that's not part of the notation)
+  _SuperPiece *piece=board->get_element(move->fromFile,move->fromRank);
+  if(piece!=NULL && piece->type=='P' && (move->toRank==1 || move->toRank==8))
+  {
+    buffer[n++]=(char)(tolower(move->promoteType));
+  }
+  buffer[n]='\0';
+}
+
+//write a line of moves in coordinate notation
+void Notation::line_to_coord(Board *board, const _Move *moves, int count, char *buffer, size_t buffer_size)
+{
+  buffer[0]='\0';
+  size_t len=0;
+  
+  //each move is written on the board it's about to be made on, since promotions can only be told apart by the piece moving
+  Board *line_board=new Board(board);
+  for(int i=0; i<count; i++)
+  {
+    char coord[COORD_MOVE_SIZE];
+    _Move move=moves[i];
+    move_to_coord(line_board,&move,coord);
+    if(len+strlen(coord)+2>buffer_size)
+    {
+      break;
+    }
+    len+=snprintf(buffer+len,buffer_size-len,(i==0)? "%s" : " %s",coord);
+    line_board->apply_move(line_board->copy_move(&move),true);
+  }
+  delete line_board;
+}
+
+//read a move in coordinate notation; returns a legal move for player_id on board or NULL
+_Move *Notation::coord_to_move(Board *board, int player_id, const char *text)
+{
+  if(strlen(text)<4)
+  {
+    return NULL;
+  }
+  
+  //convert locations from characters to internal coordinate representation
+  int from_file=tolower(text[0])-'a'+1;
+  int from_rank=text[1]-'0';
+  int to_file=tolower(text[2])-'a'+1;
+  int to_rank=text[3]-'0';
+  
+  //a promotion defaults to a queen, same as when nothing is being promoted
+  int promote_type='Q';
+  if(text[4]!='\0' && !isspace(text[4]))
+  {
+    promote_type=toupper(text[4]);
+  }
+  
+  //the move is only good if it's one of the ones that can be generated for that board for the player
+  _Move *found_move=NULL;
+  vector<_Move*> possible_moves=TreeSearch::generate_moves(board,player_id);
+  for(size_t n=0; n<possible_moves.size(); n++)
+  {
+    _Move *m=possible_moves[n];
+    if((from_file==m->fromFile) && (from_rank==m->fromRank) && (to_file==m->toFile) && (to_rank==m->toRank) && (promote_type==m->promoteType))
+    {
+      found_move=board->copy_move(m);
+      break;
+    }
+  }
+  board->clear_children();
+  
+  return found_move;
+}
+
+//write a move in standard algebraic notation
+void Notation::move_to_san(Board *board, int player_id, _Move *move, char *buffer)
+{
+  int n=0;
+  _SuperPiece *piece=board->get_element(move->fromFile,move->fromRank);
+  
+  //castling is the king moving two files
+  if(piece->type=='K' && abs(move->toFile-move->fromFile)==2)
+  {
+    strcpy(buffer,(move->toFile>move->fromFile)? "O-O" : "O-O-O");
+    n=strlen(buffer);
+  }
+  else
+  {
+    //a pawn moving diagonally is always a capture (en passant has nothing on the destination square)
+    bool capture=(board->get_element(move->toFile,move->toRank)!=NULL) || (piece->type=='P' && move->toFile!=move->fromFile);
+    
+    if(piece->type=='P')
+    {
+      if(capture)
+      {
+        buffer[n++]=(char)(move->fromFile+'a'-1);
+      }
+    }
+    else
+    {
+      buffer[n++]=(char)(piece->type);
+      
+      //if another piece of the same type can get to the same square, say which one this is
+      //by file if that's enough, else by rank if that's enough, else both
+      bool ambiguous=false;
+      bool same_file=false;
+      bool same_rank=false;
+      vector<_Move*> legal_moves=TreeSearch::generate_moves(board,player_id);
+      for(size_t i=0; i<legal_moves.size(); i++)
+      {
+        _Move *m=legal_moves[i];
+        if(m->toFile==move->toFile && m->toRank==move->toRank && !(m->fromFile==move->fromFile && m->fromRank==move->fromRank) && board->get_element(m->fromFile,m->fromRank)->type==piece->type)
+        {
+          ambiguous=true;
+          if(m->fromFile==move->fromFile)
+          {
+            same_file=true;
+          }
+          if(m->fromRank==move->fromRank)
+          {
+            same_rank=true;
+          }
+        }
+      }
+      board->clear_children();
+      
+      if(ambiguous)
+      {
+        if(!same_file)
+        {
+          buffer[n++]=(char)(move->fromFile+'a'-1);
+        }
+        else if(!same_rank)
+        {
+          buffer[n++]=(char)(move->fromRank+'0');
+        }
+        else
+        {
+          buffer[n++]=(char)(move->fromFile+'a'-1);
+          buffer[n++]=(char)(move->fromRank+'0');
+        }
+      }
+    }
+    
+    if(capture)
+    {
+      buffer[n++]='x';
+    }
+    buffer[n++]=(char)(move->toFile+'a'-1);
+    buffer[n++]=(char)(move->toRank+'0');
+    
+    if(piece->type=='P' && (move->toRank==1 || move->toRank==8))
+    {
+      buffer[n++]='=';
+      buffer[n++]=(char)(move->promoteType);
+    }
+  }
+  
+  //check or checkmate after the move
+  Board *after=new Board(board);
+  after->apply_move(after->copy_move(move),true);
+  if(after->get_check(!player_id))
+  {
+    TreeSearch::generate_moves(after,!player_id);
+    buffer[n++]=(after->get_children().empty())? '#' : '+';
+    after->clear_children();
+  }
+  delete after;
+  
+  buffer[n]='\0';
+}
+
+//read a move in standard algebraic notation; returns a legal move for player_id on board or NULL
+_Move *Notation::san_to_move(Board *board, int player_id, const char *text)
+{
+  //copy out just the move, without check marks or annotations
+  char san[SAN_MOVE_SIZE+1];
+  int len=0;
+  for(int i=0; text[i]!='\0' && !isspace(text[i]) && len<SAN_MOVE_SIZE; i++)
+  {
+    if(text[i]!='+' && text[i]!='#' && text[i]!='!' && text[i]!='?')
+    {
+      san[len++]=text[i];
+    }
+  }
+  san[len]='\0';
+  if(len<2)
+  {
+    return NULL;
+  }
+  
+  //what we're looking for; 0 for anything
+  int type='P';
+  int from_file=0;
+  int from_rank=0;
+  int to_file=0;
+  int to_rank=0;
+  int promote_type='Q';
+  bool castle=false;
+  
+  if(!strcmp(san,"O-O") || !strcmp(san,"0-0"))
+  {
+    castle=true;
+    type='K';
+    to_file=7;
+  }
+  else if(!strcmp(san,"O-O-O") || !strcmp(san,"0-0-0"))
+  {
+    castle=true;
+    type='K';
+    to_file=3;
+  }
+  else
+  {
+    int i=0;
+    if(strchr("KQRBN",san[0])!=NULL)
+    {
+      type=san[0];
+      i++;
+    }
+    
+    //a promotion is at the end, with or without an =
+    if(len>=2 && strchr("QRBN",san[len-1])!=NULL && type=='P')
+    {
+      promote_type=san[len-1];
+      len--;
+      if(len>0 && san[len-1]=='=')
+      {
+        len--;
+      }
+      san[len]='\0';
+    }
+    
+    //the destination is the last two characters, and anything between the piece and it is disambiguation (or an x)
+    if(len-i<2)
+    {
+      return NULL;
+    }
+    to_file=san[len-2]-'a'+1;
+    to_rank=san[len-1]-'0';
+    for(int j=i; j<len-2; j++)
+    {
+      if(san[j]>='a' && san[j]<='h')
+      {
+        from_file=san[j]-'a'+1;
+      }
+      else if(san[j]>='1' && san[j]<='8')
+      {
+        from_rank=san[j]-'0';
+      }
+      else if(san[j]!='x' && san[j]!=':')
+      {
+        return NULL;
+      }
+    }
+    if(to_file<1 || to_file>8 || to_rank<1 || to_rank>8)
+    {
+      return NULL;
+    }
+  }
+  
+  //find the one legal move matching all that
+  _Move *found_move=NULL;
+  int matches=0;
+  vector<_Move*> legal_moves=TreeSearch::generate_moves(board,player_id);
+  for(size_t n=0; n<legal_moves.size(); n++)
+  {
+    _Move *m=legal_moves[n];
+    _SuperPiece *piece=board->get_element(m->fromFile,m->fromRank);
+    if(piece->type!=type)
+    {
+      continue;
+    }
+    
+    if(castle)
+    {
+      //the king's destination file, and it has to be a castle (two files over)
+      if(abs(m->toFile-m->fromFile)!=2 || m->toFile!=to_file)
+      {
+        continue;
+      }
+    }
+    else
+    {
+      if(m->toFile!=to_file || m->toRank!=to_rank || (from_file!=0 && m->fromFile!=from_file) || (from_rank!=0 && m->fromRank!=from_rank))
+      {
+        continue;
+      }
+      if(type=='P' && m->promoteType!=promote_type)
+      {
+        continue;
+      }
+    }
+    
+    matches++;
+    if(found_move==NULL)
+    {
+      found_move=board->copy_move(m);
+    }
+  }
+  board->clear_children();
+  
+  //an ambiguous move isn't a move
+  if(matches>1)
+  {
+    NodeArena::node_free(found_move);
+    return NULL;
+  }
+  return found_move;
+}
+
+//pack a move into 16 bits
+unsigned short Notation::pack_move(Board *board, _Move *move, bool rook_castling)
+{
+  int to_file=move->toFile;
+  int promotion=0;
+  
+  _SuperPiece *piece=board->get_element(move->fromFile,move->fromRank);
+  if(rook_castling && piece!=NULL && piece->type=='K' && abs(move->toFile-move->fromFile)==2)
+  {
+    //castling is the king taking its own rook
+    to_file=(move->toFile>move->fromFile)? 8 : 1;
+  }
+  else if(piece!=NULL && piece->type=='P' && (move->toRank==8 || move->toRank==1))
+  {
+    const char *promote_types="NBRQ";
+    const char *found=strchr(promote_types,move->promoteType);
+    promotion=(found!=NULL)? (found-promote_types)+1 : 4;
+  }
+  
+  //files and ranks are 0-indexed
+  return (to_file-1) | ((move->toRank-1)<<3) | ((move->fromFile-1)<<6) | ((move->fromRank-1)<<9) | (promotion<<12);
+}
+
+//the legal move a packed move means
+_Move *Notation::unpack_move(Board *board, int player_id, unsigned short packed, bool rook_castling)
+{
+  int to_file=(packed & 7)+1;
+  int to_rank=((packed>>3) & 7)+1;
+  int from_file=((packed>>6) & 7)+1;
+  int from_rank=((packed>>9) & 7)+1;
+  int promotion=(packed>>12) & 7;
+  
+  //the king taking its own rook is castling; our king moves two squares instead
+  if(rook_castling)
+  {
+    _SuperPiece *piece=board->get_element(from_file,from_rank);
+    _SuperPiece *target=board->get_element(to_file,to_rank);
+    if(piece!=NULL && piece->type=='K' && target!=NULL && target->owner==piece->owner && target->type=='R')
+    {
+      to_file=(to_file>from_file)? from_file+2 : from_file-2;
+    }
+  }
+  
+  const char promote_types[]=" nbrq";
+  char coord[COORD_MOVE_SIZE];
+  coord[0]=(char)(from_file+'a'-1);
+  coord[1]=(char)(from_rank+'0');
+  coord[2]=(char)(to_file+'a'-1);
+  coord[3]=(char)(to_rank+'0');
+  coord[4]=(promotion>=1 && promotion<=4)? promote_types[promotion] : '\0';
+  coord[5]='\0';
+  return coord_to_move(board,player_id,coord);
+}
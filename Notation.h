@@ -0,0 +1,48 @@
+
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include "Board.h"
+
+//the longest a move in coordinate notation can be (e.g. e7e8q), plus a null terminator
+#define COORD_MOVE_SIZE 6
+//the longest a move in standard algebraic notation can be (e.g. Qa1xb2+ or exd8=Q#), plus a null terminator
+#define SAN_MOVE_SIZE 10
+
+//conversions between moves and the text forms protocols and files use for them
+class Notation
+{
+public:
+  //write a move in coordinate notation (from square, to square, and a lower-case promotion letter if it promotes)
+  //board is the board the move is about to be made on; buffer must hold at least COORD_MOVE_SIZE chars
+  static void move_to_coord(Board *board, _Move *move, char *buffer);
+  
+  //write a line of moves (each one made after the last, starting on board) in coordinate notation, separated by spaces
+  //moves that won't fit in buffer_size chars are left off
+  static void line_to_coord(Board *board, const _Move *moves, int count, char *buffer, size_t buffer_size);
+  
+  //read a move in coordinate notation; returns a legal move for player_id on board (remember to free this later)
+  //or NULL if the text isn't a legal move there
+  //a promotion with no letter given promotes to a queen
+  static _Move *coord_to_move(Board *board, int player_id, const char *text);
+  
+  //write a move in standard algebraic notation (Nf3, exd5, O-O, e8=Q+, etc.) for player_id on board
+  //buffer must hold at least SAN_MOVE_SIZE chars
+  static void move_to_san(Board *board, int player_id, _Move *move, char *buffer);
+  
+  //read a move in standard algebraic notation; returns a legal move for player_id on board (remember to free this later)
+  //or NULL if the text isn't a legal move there (or is ambiguous)
+  //check marks and annotations (+ # ! ?) are ignored, and castling can be written with O or 0
+  static _Move *san_to_move(Board *board, int player_id, const char *text);
+  
+  //pack a move into 16 bits, as to file (bits 0-2), to rank (3-5), from file (6-8), from rank (9-11) and promotion (12-14; 0 none, 1 knight, 2 bishop, 3 rook, 4 queen)
+  //board is the board the move is about to be made on; castling is the king's own two-square move,
+  //or the king taking its own rook (the way Polyglot books have it) when rook_castling is true
+  static unsigned short pack_move(Board *board, _Move *move, bool rook_castling);
+  //the legal move a packed move means for player_id on board (remember to free this later); NULL if it isn't one
+  //rook_castling is the same as it was for pack_move
+  static _Move *unpack_move(Board *board, int player_id, unsigned short packed, bool rook_castling);
+};
+
+#endif
+
@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+#include <algorithm>
+#include "OpeningBook.h"
+#include "Notation.h"
+#include "Pgn.h"
+#include "TreeSearch.h"
+
+//the size of an entry in the file
+#define BOOK_ENTRY_SIZE 16
+//Polyglot's key for the starting position, which any book made by another tool will have
+#define BOOK_POLYGLOT_START_KEY 0x463b96181691fc9cULL
+
+//an entry while a book is being built
+struct _BookEntry
+{
+  unsigned long long key;
+  unsigned int move;
+  unsigned int weight;
+};
+
+OpeningBook::OpeningBook()
+{
+  data=NULL;
+  data_size=0;
+  entry_count=0;
+}
+
+OpeningBook::~OpeningBook()
+{
+  close();
+}
+
+//map a book file
+bool OpeningBook::open(const char *fname)
+{
+  close();
+  
+  int fd=::open(fname,O_RDONLY);
+  if(fd<0)
+  {
+    fprintf(stderr,"Err: Could not open book file %s\n",fname);
+    return false;
+  }
+  
+  struct stat file_stat;
+  if(fstat(fd,&file_stat)<0 || file_stat.st_size==0 || (file_stat.st_size%BOOK_ENTRY_SIZE)!=0)
+  {
+    fprintf(stderr,"Err: %s isn't a book file (its size isn't a whole number of entries)\n",fname);
+    ::close(fd);
+    return false;
+  }
+  
+  void *mapped=mmap(NULL,file_stat.st_size,PROT_READ,MAP_SHARED,fd,0);
+  //the mapping stays good after the file is closed
+  ::close(fd);
+  if(mapped==MAP_FAILED)
+  {
+    fprintf(stderr,"Err: Could not map book file %s\n",fname);
+    return false;
+  }
+  
+  data=(const unsigned char*)(mapped);
+  data_size=file_stat.st_size;
+  entry_count=data_size/BOOK_ENTRY_SIZE;
+  
+  //a book that doesn't have the starting position under our key probably won't match anything
+  //(books are still used in that case, since one made from games that start elsewhere is fine)
+  Board start;
+  unsigned long long start_key=start.hash_key(WHITE);
+  size_t start_index=first_entry(start_key);
+  if(start_index>=entry_count || entry_key(start_index)!=start_key)
+  {
+    size_t polyglot_index=first_entry(BOOK_POLYGLOT_START_KEY);
+    if(polyglot_index<entry_count && entry_key(polyglot_index)==BOOK_POLYGLOT_START_KEY)
+    {
+      fprintf(stderr,"Warn: %s has Polyglot position keys, not foochess's, so nothing in it will be found; make a book with --make-book instead\n",fname);
+    }
+    else
+    {
+      fprintf(stderr,"Warn: %s doesn't have the starting position in it; if it wasn't made with --make-book, nothing in it will be found\n",fname);
+    }
+  }
+  return true;
+}
+
+void OpeningBook::close()
+{
+  if(data!=NULL)
+  {
+    munmap((void*)(data),data_size);
+    data=NULL;
+    data_size=0;
+    entry_count=0;
+  }
+}
+
+//read fields of an entry (everything is big-endian)
+unsigned long long OpeningBook::entry_key(size_t index)
+{
+  const unsigned char *entry=data+(index*BOOK_ENTRY_SIZE);
+  unsigned long long key=0;
+  for(int i=0; i<8; i++)
+  {
+    key=(key<<8) | entry[i];
+  }
+  return key;
+}
+
+unsigned int OpeningBook::entry_move(size_t index)
+{
+  const unsigned char *entry=data+(index*BOOK_ENTRY_SIZE);
+  return (entry[8]<<8) | entry[9];
+}
+
+unsigned int OpeningBook::entry_weight(size_t index)
+{
+  const unsigned char *entry=data+(index*BOOK_ENTRY_SIZE);
+  return (entry[10]<<8) | entry[11];
+}
+
+//the index of the first entry with key (binary search; entries are sorted by key)
+size_t OpeningBook::first_entry(unsigned long long key)
+{
+  size_t low=0;
+  size_t high=entry_count;
+  while(low<high)
+  {
+    size_t mid=low+((high-low)/2);
+    if(entry_key(mid)<key)
+    {
+      low=mid+1;
+    }
+    else
+    {
+      high=mid;
+    }
+  }
+  return low;
+}
+
+//a book move for player_id on board, picked at random with the book's weights
+_Move *OpeningBook::probe(Board *board, int player_id)
+{
+  if(data==NULL)
+  {
+    return NULL;
+  }
+  
+  unsigned long long key=board->hash_key(player_id);
+  size_t low=first_entry(key);
+  
+  unsigned long long total_weight=0;
+  size_t end;
+  for(end=low; end<entry_count && entry_key(end)==key; end++)
+  {
+    total_weight+=entry_weight(end);
+  }
+  if(total_weight==0)
+  {
+    return NULL;
+  }
+  
+  //pick one with probability in proportion to its weight
+  unsigned long long pick=((unsigned long long)(rand()))%total_weight;
+  for(size_t i=low; i<end; i++)
+  {
+    unsigned int weight=entry_weight(i);
+    if(pick<weight)
+    {
+      return Notation::unpack_move(board,player_id,entry_move(i),true);
+    }
+    pick-=weight;
+  }
+  return NULL;
+}
+
+//sort entries by key, then the best moves first (like Polyglot books are)
+static bool book_entry_less(const _BookEntry &a, const _BookEntry &b)
+{
+  if(a.key!=b.key)
+  {
+    return a.key<b.key;
+  }
+  return a.weight>b.weight;
+}
+
+//make a book from PGN files, from the first plies plies of every game
+bool OpeningBook::build(const char *book_fname, vector<const char*> pgn_fnames, int plies)
+{
+  //the weight so far for every (position, move) pair
+  map<pair<unsigned long long, unsigned int>, unsigned long long> weights;
+  int games=0;
+  int bad_games=0;
+  
+  for(size_t f=0; f<pgn_fnames.size(); f++)
+  {
+    PgnReader reader;
+    if(!reader.open(pgn_fnames[f]))
+    {
+      return false;
+    }
+    
+    _PgnGame game;
+    while(reader.next_game(&game))
+    {
+      games++;
+      //1, 0.5, 0, or negative when unknown
+      double white_score=(game.result==GAME_WHITE_WINS)? 1 : (game.result==GAME_BLACK_WINS)? 0 : (game.result==GAME_DRAW)? 0.5 : -1;
+      
+      Board *board=new Board();
+      int player_id=WHITE;
+      if(strlen(game.fen)>0 && !board->from_fen(game.fen,&player_id))
+      {
+        bad_games++;
+        delete board;
+        continue;
+      }
+      
+      for(int ply=0; ply<plies && ply<(int)(game.moves.size()); ply++)
+      {
+        _Move *move=Notation::san_to_move(board,player_id,game.moves[ply].san);
+        if(move==NULL)
+        {
+          fprintf(stderr,"Warn: %s isn't a legal move in game %i of %s; using the game up to there\n",game.moves[ply].san,games,pgn_fnames[f]);
+          bad_games++;
+          break;
+        }
+        
+        //2 for a win, 1 for a draw, from the side of whoever played the move
+        double score=(player_id==WHITE)? white_score : (1-white_score);
+        unsigned int weight=(white_score<0)? 0 : (unsigned int)(score*2);
+        weights[make_pair(board->hash_key(player_id),Notation::pack_move(board,move,true))]+=weight;
+        
+        board->apply_move(move,true);
+        player_id=(player_id==WHITE)? BLACK : WHITE;
+      }
+      delete board;
+    }
+  }
+  
+  //moves that never did better than a loss aren't worth playing; and weights have to fit in 16 bits
+  vector<_BookEntry> entries;
+  unsigned long long max_weight=0;
+  for(map<pair<unsigned long long, unsigned int>, unsigned long long>::iterator i=weights.begin(); i!=weights.end(); i++)
+  {
+    if((*i).second>max_weight)
+    {
+      max_weight=(*i).second;
+    }
+  }
+  unsigned long long scale=(max_weight/65535)+1;
+  for(map<pair<unsigned long long, unsigned int>, unsigned long long>::iterator i=weights.begin(); i!=weights.end(); i++)
+  {
+    if((*i).second/scale>0)
+    {
+      _BookEntry entry;
+      entry.key=(*i).first.first;
+      entry.move=(*i).first.second;
+      entry.weight=(*i).second/scale;
+      entries.push_back(entry);
+    }
+  }
+  sort(entries.begin(),entries.end(),book_entry_less);
+  
+  if(entries.empty())
+  {
+    fprintf(stderr,"Err: No book moves found in %i games\n",games);
+    return false;
+  }
+  
+  FILE *out=fopen(book_fname,"wb");
+  if(out==NULL)
+  {
+    fprintf(stderr,"Err: Could not open book file %s for writing\n",book_fname);
+    return false;
+  }
+  bool written=true;
+  for(size_t i=0; i<entries.size() && written; i++)
+  {
+    unsigned char bytes[BOOK_ENTRY_SIZE];
+    for(int b=0; b<8; b++)
+    {
+      bytes[b]=(entries[i].key>>(56-(b*8))) & 0xff;
+    }
+    bytes[8]=(entries[i].move>>8) & 0xff;
+    bytes[9]=entries[i].move & 0xff;
+    bytes[10]=(entries[i].weight>>8) & 0xff;
+    bytes[11]=entries[i].weight & 0xff;
+    memset(bytes+12,0,4);
+    written=(fwrite(bytes,BOOK_ENTRY_SIZE,1,out)==1);
+  }
+  written=(fclose(out)==0) && written;
+  if(!written)
+  {
+    fprintf(stderr,"Err: Could not write book file %s\n",book_fname);
+    return false;
+  }
+  
+  printf("book games=%i bad_games=%i entries=%lu plies=%i\n",games,bad_games,(unsigned long)(entries.size()),plies);
+  return true;
+}
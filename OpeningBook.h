@@ -0,0 +1,59 @@
+
+#ifndef OPENINGBOOK_H
+#define OPENINGBOOK_H
+
+#include <stdio.h>
+#include <vector>
+#include "Board.h"
+
+using namespace std;
+
+//how many plies of every game go into a book by default
+#define BOOK_DEFAULT_PLIES 20
+
+//an opening book; moves to play in known positions without searching
+//
+//the file is the Polyglot layout: a list of 16-byte entries sorted by position key, each big-endian
+//  key (8 bytes), move (2 bytes), weight (2 bytes), learn (4 bytes, unused here)
+//a move is packed with Notation::pack_move, with castling written as the king taking its own rook, the way Polyglot does it
+//NOTE: the keys are our own (Board::hash_key), not Polyglot's, so books made by other tools won't find anything; make one with build()
+//(open() warns about a book whose keys can't be ours, e.g. one with Polyglot's key for the starting position but not ours)
+//
+//the file is memory-mapped, and a probe is a binary search, so this costs next to nothing per move
+//(and books can be bigger than we'd want to read into memory)
+class OpeningBook
+{
+private:
+  //the mapped file (NULL when there isn't one), and how many entries are in it
+  const unsigned char *data;
+  size_t data_size;
+  size_t entry_count;
+
+  //read fields of an entry
+  unsigned long long entry_key(size_t index);
+  unsigned int entry_move(size_t index);
+  unsigned int entry_weight(size_t index);
+  //the index of the first entry with key (or where it would be, if there isn't one)
+  size_t first_entry(unsigned long long key);
+
+public:
+  OpeningBook();
+  ~OpeningBook();
+
+  //map a book file; false (with an error) if it can't be read or isn't a book
+  bool open(const char *fname);
+  void close();
+  bool is_open(){ return data!=NULL; }
+
+  //a book move for player_id on board, picked at random with the book's weights (remember to free this later)
+  //NULL if the position isn't in the book
+  _Move *probe(Board *board, int player_id);
+
+  //make a book from PGN files, from the first plies plies of every game
+  //a move's weight is 2 for every game the side that played it went on to win, and 1 for every draw
+  //returns false if nothing could be read or the book couldn't be written
+  static bool build(const char *book_fname, vector<const char*> pgn_fnames, int plies);
+};
+
+#endif
+
@@ -0,0 +1,706 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "Pgn.h"
+
+PgnReader::PgnReader()
+{
+  fp=NULL;
+  buffer=NULL;
+  buffer_len=0;
+  buffer_pos=0;
+  line=1;
+  game_line=0;
+  line_start=true;
+}
+
+PgnReader::~PgnReader()
+{
+  close();
+}
+
+//open a file to read
+bool PgnReader::open(const char *fname)
+{
+  close();
+  fp=fopen(fname,"rb");
+  if(fp==NULL)
+  {
+    fprintf(stderr,"Err: Could not open PGN file %s\n",fname);
+    return false;
+  }
+  buffer=(unsigned char*)(malloc(PGN_BUFFER_SIZE));
+  buffer_len=0;
+  buffer_pos=0;
+  line=1;
+  game_line=0;
+  line_start=true;
+  return true;
+}
+
+void PgnReader::close()
+{
+  if(fp!=NULL)
+  {
+    fclose(fp);
+    fp=NULL;
+  }
+  if(buffer!=NULL)
+  {
+    free(buffer);
+    buffer=NULL;
+  }
+}
+
+//the next character in the file, without moving past it
+int PgnReader::peek_char()
+{
+  if(buffer_pos>=buffer_len)
+  {
+    buffer_len=fread(buffer,1,PGN_BUFFER_SIZE,fp);
+    buffer_pos=0;
+    if(buffer_len==0)
+    {
+      return EOF;
+    }
+  }
+  return buffer[buffer_pos];
+}
+
+//the next character in the file, moving past it
+int PgnReader::get_char()
+{
+  int c=peek_char();
+  if(c!=EOF)
+  {
+    buffer_pos++;
+    line_start=(c=='\n');
+    if(c=='\n')
+    {
+      line++;
+    }
+  }
+  return c;
+}
+
+//read a tag pair, after its [; [Name "value"], where the value can have \" and \\ in it
+bool PgnReader::read_tag(_PgnTag *tag)
+{
+  int c=get_char();
+  while(c==' ' || c=='\t')
+  {
+    c=get_char();
+  }
+  int len=0;
+  while(c!=EOF && (isalnum(c) || c=='_'))
+  {
+    if(len<PGN_TAG_SIZE-1)
+    {
+      tag->name[len++]=c;
+    }
+    c=get_char();
+  }
+  tag->name[len]='\0';
+  while(c==' ' || c=='\t')
+  {
+    c=get_char();
+  }
+  
+  bool valid=(len>0 && c=='"');
+  len=0;
+  if(valid)
+  {
+    c=get_char();
+    while(c!=EOF && c!='"' && c!='\n')
+    {
+      if(c=='\\' && (peek_char()=='"' || peek_char()=='\\'))
+      {
+        c=get_char();
+      }
+      if(len<PGN_TAG_SIZE-1)
+      {
+        tag->value[len++]=c;
+      }
+      c=get_char();
+    }
+    valid=(c=='"');
+  }
+  tag->value[len]='\0';
+  
+  //whatever's left, up to the ]
+  while(c!=EOF && c!=']' && c!='\n')
+  {
+    c=get_char();
+  }
+  return valid;
+}
+
+//read the next game
+bool PgnReader::next_game(_PgnGame *game)
+{
+  game->tags.clear();
+  game->moves.clear();
+  game->fen[0]='\0';
+  game->result=GAME_UNKNOWN;
+  
+  int tag_result=GAME_UNKNOWN;
+  bool have_result=false;
+  bool started=false;
+  bool in_movetext=false;
+  int variation_depth=0;
+  
+  while(fp!=NULL)
+  {
+    int c=peek_char();
+    if(c==EOF)
+    {
+      break;
+    }
+    
+    //a % at the start of a line is an escape; the whole line is skipped
+    if(c=='%' && line_start)
+    {
+      while(c!=EOF && c!='\n')
+      {
+        c=get_char();
+      }
+      continue;
+    }
+    if(isspace(c))
+    {
+      get_char();
+      continue;
+    }
+    if(!started)
+    {
+      started=true;
+      game_line=line;
+    }
+    
+    //tag pairs; once movetext has started, a tag means we've gone past the end of a game with no result
+    //(the [ is left for the next game)
+    if(c=='[')
+    {
+      if(in_movetext)
+      {
+        break;
+      }
+      get_char();
+      _PgnTag tag;
+      if(!read_tag(&tag))
+      {
+        continue;
+      }
+      if(!strcmp(tag.name,"FEN"))
+      {
+        strncpy(game->fen,tag.value,FEN_SIZE-1);
+        game->fen[FEN_SIZE-1]='\0';
+      }
+      else if(!strcmp(tag.name,"Result"))
+      {
+        tag_result=Pgn::text_result(tag.value);
+      }
+      game->tags.push_back(tag);
+      continue;
+    }
+    
+    get_char();
+    in_movetext=true;
+    
+    //a comment goes with the move before it (comments don't nest, and the first one after a move is the one kept)
+    if(c=='{')
+    {
+      bool keep=(variation_depth==0 && !game->moves.empty() && game->moves.back().comment[0]=='\0');
+      int len=0;
+      c=get_char();
+      while(c==' ' || c=='\n' || c=='\r' || c=='\t')
+      {
+        c=get_char();
+      }
+      while(c!=EOF && c!='}')
+      {
+        if(keep && len<PGN_COMMENT_SIZE-1)
+        {
+          game->moves.back().comment[len++]=(isspace(c))? ' ' : c;
+        }
+        c=get_char();
+      }
+      if(keep)
+      {
+        while(len>0 && game->moves.back().comment[len-1]==' ')
+        {
+          len--;
+        }
+        game->moves.back().comment[len]='\0';
+      }
+      continue;
+    }
+    //a ; comment goes to the end of the line
+    if(c==';')
+    {
+      while(c!=EOF && c!='\n')
+      {
+        c=get_char();
+      }
+      continue;
+    }
+    if(c=='(')
+    {
+      variation_depth++;
+      continue;
+    }
+    if(c==')')
+    {
+      if(variation_depth>0)
+      {
+        variation_depth--;
+      }
+      continue;
+    }
+    
+    //a token; up to the next space or bracket
+    char token[PGN_TAG_SIZE];
+    int token_len=0;
+    token[token_len++]=c;
+    c=peek_char();
+    while(c!=EOF && !isspace(c) && c!='{' && c!='}' && c!='(' && c!=')' && c!=';' && c!='[')
+    {
+      get_char();
+      if(token_len<PGN_TAG_SIZE-1)
+      {
+        token[token_len++]=c;
+      }
+      c=peek_char();
+    }
+    token[token_len]='\0';
+    
+    if(variation_depth>0 || token[0]=='$')
+    {
+      continue;
+    }
+    
+    //a result ends the game
+    if(!strcmp(token,"*") || Pgn::text_result(token)!=GAME_UNKNOWN)
+    {
+      game->result=Pgn::text_result(token);
+      have_result=true;
+      break;
+    }
+    
+    //move numbers (12. or 12...) can be stuck to the move
+    char *san=token;
+    while(isdigit(*san))
+    {
+      san++;
+    }
+    while(*san=='.')
+    {
+      san++;
+    }
+    if(*san!='\0')
+    {
+      _PgnMove move;
+      int len=0;
+      for(int i=0; san[i]!='\0' && len<SAN_MOVE_SIZE; i++)
+      {
+        if(san[i]!='!' && san[i]!='?')
+        {
+          move.san[len++]=san[i];
+        }
+      }
+      move.san[len]='\0';
+      move.comment[0]='\0';
+      if(len>0)
+      {
+        game->moves.push_back(move);
+      }
+    }
+  }
+  
+  if(!have_result)
+  {
+    game->result=tag_result;
+  }
+  return started;
+}
+
+PgnWriter::PgnWriter()
+{
+  fp=NULL;
+}
+
+PgnWriter::~PgnWriter()
+{
+  close();
+}
+
+//open a file to write
+bool PgnWriter::open(const char *fname, bool append)
+{
+  close();
+  fp=fopen(fname,append? "ab" : "wb");
+  if(fp==NULL)
+  {
+    fprintf(stderr,"Err: Could not open PGN file %s for writing\n",fname);
+    return false;
+  }
+  setvbuf(fp,NULL,_IOFBF,PGN_BUFFER_SIZE);
+  return true;
+}
+
+void PgnWriter::close()
+{
+  if(fp!=NULL)
+  {
+    fclose(fp);
+    fp=NULL;
+  }
+}
+
+//write a word of movetext, starting a new line if it won't fit on this one
+static void pgn_put_word(FILE *fp, const char *word, int *column)
+{
+  int len=strlen(word);
+  if(*column>0 && (*column)+1+len>PGN_LINE_WIDTH)
+  {
+    fputc('\n',fp);
+    *column=0;
+  }
+  else if(*column>0)
+  {
+    fputc(' ',fp);
+    (*column)++;
+  }
+  fputs(word,fp);
+  (*column)+=len;
+}
+
+//write a game
+bool PgnWriter::write_game(const _PgnGame *game)
+{
+  if(fp==NULL)
+  {
+    return false;
+  }
+  
+  for(size_t i=0; i<game->tags.size(); i++)
+  {
+    fprintf(fp,"[%s \"",game->tags[i].name);
+    for(const char *c=game->tags[i].value; *c!='\0'; c++)
+    {
+      if(*c=='"' || *c=='\\')
+      {
+        fputc('\\',fp);
+      }
+      fputc(*c,fp);
+    }
+    fprintf(fp,"\"]\n");
+  }
+  fprintf(fp,"\n");
+  
+  //the side to move and the move number come from the FEN when there is one
+  int player_id=WHITE;
+  int move_number=1;
+  if(strlen(game->fen)>0)
+  {
+    char side='w';
+    sscanf(game->fen,"%*s %c %*s %*s %*s %i",&side,&move_number);
+    player_id=(side=='b')? BLACK : WHITE;
+  }
+  
+  int column=0;
+  char word[PGN_COMMENT_SIZE+3];
+  bool after_comment=false;
+  for(size_t i=0; i<game->moves.size(); i++)
+  {
+    //black's moves get a number of their own at the start and after a comment (12...)
+    if(player_id==WHITE)
+    {
+      snprintf(word,sizeof(word),"%i.",move_number);
+      pgn_put_word(fp,word,&column);
+    }
+    else if(i==0 || after_comment)
+    {
+      snprintf(word,sizeof(word),"%i...",move_number);
+      pgn_put_word(fp,word,&column);
+    }
+    pgn_put_word(fp,game->moves[i].san,&column);
+    after_comment=(game->moves[i].comment[0]!='\0');
+    if(after_comment)
+    {
+      snprintf(word,sizeof(word),"{%s}",game->moves[i].comment);
+      pgn_put_word(fp,word,&column);
+    }
+    
+    if(player_id==BLACK)
+    {
+      move_number++;
+    }
+    player_id=(player_id==WHITE)? BLACK : WHITE;
+  }
+  pgn_put_word(fp,Pgn::result_text(game->result),&column);
+  fprintf(fp,"\n\n");
+  return !ferror(fp);
+}
+
+//the value of a tag in a game
+const char *Pgn::get_tag(const _PgnGame *game, const char *name)
+{
+  for(size_t i=0; i<game->tags.size(); i++)
+  {
+    if(!strcmp(game->tags[i].name,name))
+    {
+      return game->tags[i].value;
+    }
+  }
+  return NULL;
+}
+
+//add or change a tag
+void Pgn::set_tag(_PgnGame *game, const char *name, const char *value)
+{
+  _PgnTag tag;
+  strncpy(tag.name,name,PGN_TAG_SIZE-1);
+  tag.name[PGN_TAG_SIZE-1]='\0';
+  strncpy(tag.value,value,PGN_TAG_SIZE-1);
+  tag.value[PGN_TAG_SIZE-1]='\0';
+  for(size_t i=0; i<game->tags.size(); i++)
+  {
+    if(!strcmp(game->tags[i].name,name))
+    {
+      game->tags[i]=tag;
+      return;
+    }
+  }
+  game->tags.push_back(tag);
+}
+
+//the result text for a result
+const char *Pgn::result_text(int result)
+{
+  return (result==GAME_WHITE_WINS)? "1-0" : (result==GAME_BLACK_WINS)? "0-1" : (result==GAME_DRAW)? "1/2-1/2" : "*";
+}
+
+//the result for a result text
+int Pgn::text_result(const char *text)
+{
+  return (!strcmp(text,"1-0"))? GAME_WHITE_WINS : (!strcmp(text,"0-1"))? GAME_BLACK_WINS : (!strcmp(text,"1/2-1/2"))? GAME_DRAW : GAME_UNKNOWN;
+}
+
+//make a game store record from a game
+bool Pgn::to_record(const _PgnGame *game, _GameRecord *record)
+{
+  record->moves.clear();
+  record->result=game->result;
+  strncpy(record->fen,game->fen,FEN_SIZE);
+  
+  Board *board=new Board();
+  int player_id=WHITE;
+  if(strlen(game->fen)>0 && !board->from_fen(game->fen,&player_id))
+  {
+    fprintf(stderr,"Warn: Bad FEN \"%s\"\n",game->fen);
+    delete board;
+    return false;
+  }
+  
+  bool legal=true;
+  for(size_t i=0; i<game->moves.size(); i++)
+  {
+    _Move *move=Notation::san_to_move(board,player_id,game->moves[i].san);
+    if(move==NULL)
+    {
+      fprintf(stderr,"Warn: %s isn't a legal move at ply %lu\n",game->moves[i].san,(unsigned long)(i+1));
+      legal=false;
+      break;
+    }
+    
+    //a comment like the ones from_record writes (rounded back, since they're written to two or three decimal places) ({+0.31 1.203s}, {+M3 1.203s}
+    //for a mate, or just {1.203s} with no eval) has the eval and time
+    _GameMove game_move;
+    game_move.move=Notation::pack_move(board,move,false);
+    game_move.eval=GAME_NO_EVAL;
+    game_move.time_ms=0;
+    double eval;
+    double seconds;
+    char unit;
+    char sign;
+    int mate_moves;
+    if(sscanf(game->moves[i].comment,"%cM%i %lf%c",&sign,&mate_moves,&seconds,&unit)==4 && (sign=='+' || sign=='-') && unit=='s')
+    {
+      game_move.eval=GameStore::mate_eval((sign=='-')? -mate_moves : mate_moves);
+      game_move.time_ms=(unsigned int)((seconds*1000)+0.5);
+    }
+    else if(sscanf(game->moves[i].comment,"%lf %lf%c",&eval,&seconds,&unit)==3 && unit=='s')
+    {
+      game_move.eval=GameStore::value_to_eval(eval);
+      game_move.time_ms=(unsigned int)((seconds*1000)+0.5);
+    }
+    else if(sscanf(game->moves[i].comment,"%lf%c",&seconds,&unit)==2 && unit=='s')
+    {
+      game_move.time_ms=(unsigned int)((seconds*1000)+0.5);
+    }
+    record->moves.push_back(game_move);
+    
+    board->apply_move(move,true);
+    player_id=(player_id==WHITE)? BLACK : WHITE;
+  }
+  delete board;
+  return legal;
+}
+
+//make a game from a game store record
+bool Pgn::from_record(const _GameRecord *record, _PgnGame *game)
+{
+  game->moves.clear();
+  game->result=record->result;
+  strncpy(game->fen,record->fen,FEN_SIZE);
+  
+  Board *board=new Board();
+  int player_id=WHITE;
+  if(strlen(record->fen)>0 && !board->from_fen(record->fen,&player_id))
+  {
+    fprintf(stderr,"Warn: Bad FEN \"%s\"\n",record->fen);
+    delete board;
+    return false;
+  }
+  
+  bool legal=true;
+  for(size_t i=0; i<record->moves.size(); i++)
+  {
+    _Move *move=Notation::unpack_move(board,player_id,record->moves[i].move,false);
+    if(move==NULL)
+    {
+      char coord[COORD_MOVE_SIZE];
+      GameStore::packed_to_coord(record->moves[i].move,coord);
+      fprintf(stderr,"Warn: %s isn't a legal move at ply %lu\n",coord,(unsigned long)(i+1));
+      legal=false;
+      break;
+    }
+    
+    _PgnMove pgn_move;
+    Notation::move_to_san(board,player_id,move,pgn_move.san);
+    if(GAME_IS_MATE(record->moves[i].eval))
+    {
+      int moves=GameStore::eval_mate_moves(record->moves[i].eval);
+      snprintf(pgn_move.comment,PGN_COMMENT_SIZE,"%cM%i %.3lfs",(moves<0)? '-' : '+',abs(moves),record->moves[i].time_ms/1000.0);
+    }
+    else if(record->moves[i].eval!=GAME_NO_EVAL)
+    {
+      snprintf(pgn_move.comment,PGN_COMMENT_SIZE,"%+.2lf %.3lfs",record->moves[i].eval/100.0,record->moves[i].time_ms/1000.0);
+    }
+    else if(record->moves[i].time_ms>0)
+    {
+      snprintf(pgn_move.comment,PGN_COMMENT_SIZE,"%.3lfs",record->moves[i].time_ms/1000.0);
+    }
+    else
+    {
+      pgn_move.comment[0]='\0';
+    }
+    game->moves.push_back(pgn_move);
+    
+    board->apply_move(move,true);
+    player_id=(player_id==WHITE)? BLACK : WHITE;
+  }
+  delete board;
+  return legal;
+}
+
+//add every game in PGN files to a game store
+bool Pgn::import_games(vector<const char*> pgn_fnames, const char *store_fname)
+{
+  GameStore store;
+  if(!store.open(store_fname,true))
+  {
+    return false;
+  }
+  
+  unsigned long games=0;
+  unsigned long bad_games=0;
+  unsigned long long plies=0;
+  for(size_t f=0; f<pgn_fnames.size(); f++)
+  {
+    PgnReader reader;
+    if(!reader.open(pgn_fnames[f]))
+    {
+      return false;
+    }
+    
+    _PgnGame game;
+    _GameRecord record;
+    while(reader.next_game(&game))
+    {
+      games++;
+      //a game with a bad move is kept up to there
+      if(!to_record(&game,&record))
+      {
+        fprintf(stderr,"Warn: Game at line %lu of %s has a bad move or position; keeping it up to there\n",reader.get_game_line(),pgn_fnames[f]);
+        bad_games++;
+      }
+      if(!store.append(&record))
+      {
+        return false;
+      }
+      plies+=record.moves.size();
+    }
+  }
+  printf("pgn_import games=%lu bad_games=%lu plies=%llu\n",games,bad_games,plies);
+  return true;
+}
+
+//write games from a store to a PGN file
+bool Pgn::export_games(const char *store_fname, int n, const char *pgn_fname)
+{
+  GameStore store;
+  if(!store.open(store_fname,false))
+  {
+    return false;
+  }
+  if(n>0 && (size_t)(n)>store.game_count())
+  {
+    fprintf(stderr,"Err: There's no game %i in %s (it has %lu)\n",n,store_fname,(unsigned long)(store.game_count()));
+    return false;
+  }
+  PgnWriter writer;
+  if(!writer.open(pgn_fname,false))
+  {
+    return false;
+  }
+  
+  _GameRecord record;
+  int number=(n>0)? n : 1;
+  bool found=(n>0)? store.read_game(n-1,&record) : store.next_game(&record);
+  while(found)
+  {
+    _PgnGame game;
+    if(!from_record(&record,&game))
+    {
+      fprintf(stderr,"Warn: Game %i of %s has a bad move or position; writing it up to there\n",number,store_fname);
+    }
+    
+    //the seven tag roster first, then where the game started
+    char round[PGN_TAG_SIZE];
+    snprintf(round,PGN_TAG_SIZE,"%i",number);
+    set_tag(&game,"Event","foochess games");
+    set_tag(&game,"Site","?");
+    set_tag(&game,"Date","????.??.??");
+    set_tag(&game,"Round",round);
+    set_tag(&game,"White","?");
+    set_tag(&game,"Black","?");
+    set_tag(&game,"Result",result_text(game.result));
+    if(strlen(game.fen)>0)
+    {
+      set_tag(&game,"SetUp","1");
+      set_tag(&game,"FEN",game.fen);
+    }
+    if(!writer.write_game(&game))
+    {
+      fprintf(stderr,"Err: Could not write to PGN file %s\n",pgn_fname);
+      return false;
+    }
+    
+    number++;
+    found=(n>0)? false : store.next_game(&record);
+  }
+  return true;
+}
+
@@ -0,0 +1,141 @@
+
+#ifndef PGN_H
+#define PGN_H
+
+#include <stdio.h>
+#include <vector>
+#include "Board.h"
+#include "Position.h"
+#include "Notation.h"
+#include "GameStore.h"
+
+using namespace std;
+
+//the longest tag name or value we keep (longer ones are cut short), plus a null terminator
+#define PGN_TAG_SIZE 256
+//the longest comment we keep for a move (longer ones are cut short), plus a null terminator
+#define PGN_COMMENT_SIZE 128
+//how much of a file is read at a time
+#define PGN_BUFFER_SIZE (1<<20)
+//where movetext lines get wrapped when writing
+#define PGN_LINE_WIDTH 79
+
+struct _PgnTag;
+struct _PgnMove;
+struct _PgnGame;
+
+//a tag pair, like [White "Somebody"]
+struct _PgnTag
+{
+  char name[PGN_TAG_SIZE];
+  char value[PGN_TAG_SIZE];
+};
+
+//a move in a game's movetext
+struct _PgnMove
+{
+  //in SAN, with any ! and ? annotations taken off
+  char san[SAN_MOVE_SIZE+1];
+  //the comment right after the move, without its braces (empty for none)
+  char comment[PGN_COMMENT_SIZE];
+};
+
+//a whole game; variations and numeric annotations aren't kept
+struct _PgnGame
+{
+  //every tag, in the order they came
+  vector<_PgnTag> tags;
+  //where the game started (from the FEN tag; empty for the standard position)
+  char fen[FEN_SIZE];
+  //GAME_WHITE_WINS and so on (from the result at the end of the movetext, or the Result tag when that's missing)
+  int result;
+  vector<_PgnMove> moves;
+};
+
+//reads games one at a time from a PGN file
+//
+//the file is read through a fixed buffer a character at a time, so only the game being read is ever in memory
+//and files of any size take the same memory; there's no limit on line length
+//comments, variations, numeric annotations and % escape lines are skipped; a game with no result at the end
+//(the next game's tags come first, or the file ends) still counts
+class PgnReader
+{
+private:
+  FILE *fp;
+  unsigned char *buffer;
+  size_t buffer_len;
+  size_t buffer_pos;
+  //the line we're on, and the line the last game started on (for messages)
+  unsigned long line;
+  unsigned long game_line;
+  //whether the last character read was a newline (for % escapes, which only count at the start of a line)
+  bool line_start;
+  
+  //the next character in the file, without or with moving past it; EOF at the end
+  int peek_char();
+  int get_char();
+  //read a tag pair, after its [; false if it isn't one
+  bool read_tag(_PgnTag *tag);
+
+public:
+  PgnReader();
+  ~PgnReader();
+  
+  //open a file to read; false (with an error) if it can't be
+  bool open(const char *fname);
+  void close();
+  bool is_open(){ return fp!=NULL; }
+  
+  //read the next game; false when there are no more
+  bool next_game(_PgnGame *game);
+  //the line the last game read started on
+  unsigned long get_game_line(){ return game_line; }
+};
+
+//writes games to a PGN file
+class PgnWriter
+{
+private:
+  FILE *fp;
+
+public:
+  PgnWriter();
+  ~PgnWriter();
+  
+  //open a file to write, adding to the end of it if append is true; false (with an error) if it can't be
+  bool open(const char *fname, bool append);
+  void close();
+  bool is_open(){ return fp!=NULL; }
+  
+  //write a game; its tags are written as they are (so the seven tag roster should come first), then the movetext,
+  //with move numbers (counting from the FEN's, if it has one), comments and the result
+  bool write_game(const _PgnGame *game);
+};
+
+//going between PGN and the other ways games are kept
+class Pgn
+{
+public:
+  //the value of a tag in a game (NULL if it doesn't have it)
+  static const char *get_tag(const _PgnGame *game, const char *name);
+  //add a tag to a game (or change it, if it's already there)
+  static void set_tag(_PgnGame *game, const char *name, const char *value);
+  //the result text for a result (GAME_WHITE_WINS gives 1-0 and so on), and the other way
+  static const char *result_text(int result);
+  static int text_result(const char *text);
+  
+  //play through a game's moves and make a game store record of it; evals and times are read back from comments written by from_record
+  //false (with a warning) if a move isn't legal, in which case the record has the game up to there
+  static bool to_record(const _PgnGame *game, _GameRecord *record);
+  //the other way; moves are written in SAN, and a move's eval (in pawns, from the mover's side) and time go in its comment, like {+0.31 1.203s}
+  //false (with a warning) if a move isn't legal, in which case the game has moves up to there
+  static bool from_record(const _GameRecord *record, _PgnGame *game);
+  
+  //add every game in the PGN files to a game store; prints a line starting with "pgn_import" with the counts when done
+  static bool import_games(vector<const char*> pgn_fnames, const char *store_fname);
+  //write games from a store (all of them, or just game n, counting from 1, when n is more than 0) to a PGN file
+  static bool export_games(const char *store_fname, int n, const char *pgn_fname);
+};
+
+#endif
+
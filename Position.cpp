@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "Position.h"
+#include "Board.h"
+
+//the piece code at a given location (1-indexed, like everywhere else)
+int position_get(const _Position *pos, int file, int rank)
+{
+  //the -1 is to switch 1-indexing to 0-indexing
+  int index=((rank-1)*8)+(file-1);
+  
+  //even squares are in the low nibble, odd squares in the high one
+  if(index%2==0)
+  {
+    return pos->squares[index/2] & 0x0f;
+  }
+  return (pos->squares[index/2] >> 4) & 0x0f;
+}
+
+//set the piece code at a given location (1-indexed)
+void position_set(_Position *pos, int file, int rank, int code)
+{
+  int index=((rank-1)*8)+(file-1);
+  
+  if(index%2==0)
+  {
+    pos->squares[index/2]=(pos->squares[index/2] & 0xf0) | (code & 0x0f);
+  }
+  else
+  {
+    pos->squares[index/2]=(pos->squares[index/2] & 0x0f) | ((code & 0x0f) << 4);
+  }
+}
+
+//an empty position (no pieces at all)
+void position_clear(_Position *pos)
+{
+  memset(pos->squares,0,sizeof(pos->squares));
+}
+
+//copy one position into another
+void position_copy(_Position *dest, const _Position *src)
+{
+  memcpy(dest,src,sizeof(_Position));
+}
+
+//true if the two positions are identical, including castling and en passant state
+bool position_equals(const _Position *a, const _Position *b)
+{
+  return (memcmp(a->squares,b->squares,sizeof(a->squares))==0);
+}
+
+//Zobrist keys for position_hash; one for every piece code on every square, and one for black to move
+static unsigned long long position_keys[64][16];
+static unsigned long long position_black_key;
+
+//fill in the keys from a fixed seed (splitmix64, which is plenty random for this)
+static bool position_make_keys()
+{
+  unsigned long long seed=0x666f6f6368657373ULL;
+  for(int n=0; n<(64*16)+1; n++)
+  {
+    seed+=0x9e3779b97f4a7c15ULL;
+    unsigned long long z=seed;
+    z=(z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+    z=(z^(z>>27))*0x94d049bb133111ebULL;
+    z=z^(z>>31);
+    
+    if(n<64*16)
+    {
+      position_keys[n/16][n%16]=z;
+    }
+    else
+    {
+      position_black_key=z;
+    }
+  }
+  return true;
+}
+static bool position_keys_made=position_make_keys();
+
+//a 64-bit hash of a position and the side to move
+unsigned long long position_hash(const _Position *pos, int player_id)
+{
+  unsigned long long hash=(player_id==BLACK)? position_black_key : 0;
+  for(int index=0; index<64; index++)
+  {
+    int code=(index%2==0)? (pos->squares[index/2] & 0x0f) : ((pos->squares[index/2] >> 4) & 0x0f);
+    if(code!=POS_EMPTY)
+    {
+      hash^=position_keys[index][code];
+    }
+  }
+  return hash;
+}
+
+//convert the type character a _SuperPiece uses to a 3-bit type
+//returns POS_EMPTY for anything unrecognized
+int position_type_code(int type)
+{
+  switch(type)
+  {
+    case 'P':
+      return POS_PAWN;
+    case 'R':
+      return POS_ROOK;
+    case 'N':
+      return POS_KNIGHT;
+    case 'B':
+      return POS_BISHOP;
+    case 'Q':
+      return POS_QUEEN;
+    case 'K':
+      return POS_KING;
+    default:
+      return POS_EMPTY;
+  }
+}
+
+//convert a 3-bit type (or a full piece code) back to a type character
+//returns '\0' for empty squares
+int position_code_type(int code)
+{
+  switch(code)
+  {
+    case POS_CASTLE_ROOK:
+      return 'R';
+    case POS_EP_PAWN:
+      return 'P';
+    case POS_HOME_KING:
+      return 'K';
+    default:
+      break;
+  }
+  
+  switch(code & 0x07)
+  {
+    case POS_PAWN:
+      return 'P';
+    case POS_ROOK:
+      return 'R';
+    case POS_KNIGHT:
+      return 'N';
+    case POS_BISHOP:
+      return 'B';
+    case POS_QUEEN:
+      return 'Q';
+    case POS_KING:
+      return 'K';
+    default:
+      return '\0';
+  }
+}
+
+//the owner of a piece code (the special codes get theirs from the rank they're on)
+static int position_code_owner(int code, int rank)
+{
+  switch(code)
+  {
+    case POS_CASTLE_ROOK:
+    case POS_HOME_KING:
+      return (rank==1)? WHITE : BLACK;
+    case POS_EP_PAWN:
+      return (rank==4)? WHITE : BLACK;
+    default:
+      return (code & POS_BLACK)? BLACK : WHITE;
+  }
+}
+
+//read a position in Forsyth-Edwards Notation
+//e.g. rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1
+bool position_from_fen(_Position *pos, const char *fen, int *player_id, int *halfmove, int *fullmove)
+{
+  position_clear(pos);
+  
+  //piece placement, from rank 8 down to rank 1, files a to h
+  const char *c=fen;
+  while(isspace(*c))
+  {
+    c++;
+  }
+  int file=1;
+  int rank=8;
+  int kings[2]={0,0};
+  for(; *c!='\0' && !isspace(*c); c++)
+  {
+    if(*c=='/')
+    {
+      //every rank has to account for all 8 files before the next one starts
+      if(file!=9 || rank==1)
+      {
+        return false;
+      }
+      file=1;
+      rank--;
+    }
+    else if(*c>='1' && *c<='8')
+    {
+      file+=(*c-'0');
+      if(file>9)
+      {
+        return false;
+      }
+    }
+    else
+    {
+      int code=position_type_code(toupper(*c));
+      if(code==POS_EMPTY || file>8)
+      {
+        return false;
+      }
+      
+      int owner=islower(*c)? BLACK : WHITE;
+      if(owner==BLACK)
+      {
+        code|=POS_BLACK;
+      }
+      if(toupper(*c)=='K')
+      {
+        kings[owner]++;
+      }
+      
+      position_set(pos,file,rank,code);
+      file++;
+    }
+  }
+  if(file!=9 || rank!=1 || kings[WHITE]!=1 || kings[BLACK]!=1)
+  {
+    return false;
+  }
+  
+  //side to move
+  while(isspace(*c))
+  {
+    c++;
+  }
+  if(*c=='w')
+  {
+    *player_id=WHITE;
+  }
+  else if(*c=='b')
+  {
+    *player_id=BLACK;
+  }
+  else
+  {
+    return false;
+  }
+  c++;
+  
+  //castling; the king and rook(s) it applies to get marked as never having moved
+  while(isspace(*c))
+  {
+    c++;
+  }
+  for(; *c!='\0' && !isspace(*c); c++)
+  {
+    if(*c=='-')
+    {
+      continue;
+    }
+    
+    int owner=isupper(*c)? WHITE : BLACK;
+    int home_rank=(owner==WHITE)? 1 : 8;
+    int rook_file;
+    if(toupper(*c)=='K')
+    {
+      rook_file=8;
+    }
+    else if(toupper(*c)=='Q')
+    {
+      rook_file=1;
+    }
+    else
+    {
+      return false;
+    }
+    
+    int owner_bit=(owner==BLACK)? POS_BLACK : 0;
+    for(int f=1; f<=8; f++)
+    {
+      if(position_get(pos,f,home_rank)==(POS_KING|owner_bit))
+      {
+        position_set(pos,f,home_rank,POS_HOME_KING);
+      }
+    }
+    //a right without its rook where it should be can't be used anyway, so it's dropped
+    if(position_get(pos,rook_file,home_rank)==(POS_ROOK|owner_bit))
+    {
+      position_set(pos,rook_file,home_rank,POS_CASTLE_ROOK);
+    }
+  }
+  
+  //en passant target square; the pawn that just moved two squares is the one past it
+  while(isspace(*c))
+  {
+    c++;
+  }
+  if(*c>='a' && *c<='h' && (c[1]=='3' || c[1]=='6'))
+  {
+    int ep_file=(*c-'a')+1;
+    int pawn_rank=(c[1]=='3')? 4 : 5;
+    int pawn_code=(pawn_rank==4)? POS_PAWN : (POS_PAWN|POS_BLACK);
+    if(position_get(pos,ep_file,pawn_rank)==pawn_code)
+    {
+      position_set(pos,ep_file,pawn_rank,POS_EP_PAWN);
+    }
+    c+=2;
+  }
+  else if(*c=='-')
+  {
+    c++;
+  }
+  else
+  {
+    return false;
+  }
+  
+  //the move counters are optional (EPD leaves them off)
+  *halfmove=0;
+  *fullmove=1;
+  char *end;
+  long value=strtol(c,&end,10);
+  if(end!=c)
+  {
+    *halfmove=(int)(value);
+    c=end;
+    value=strtol(c,&end,10);
+    if(end!=c)
+    {
+      *fullmove=(int)(value);
+    }
+  }
+  
+  return true;
+}
+
+//write a position in Forsyth-Edwards Notation
+void position_to_fen(const _Position *pos, int player_id, int halfmove, int fullmove, char *buffer)
+{
+  int n=0;
+  
+  //piece placement
+  int ep_file=0;
+  int ep_rank=0;
+  for(int rank=8; rank>=1; rank--)
+  {
+    int empty=0;
+    for(int file=1; file<=8; file++)
+    {
+      int code=position_get(pos,file,rank);
+      if(code==POS_EMPTY)
+      {
+        empty++;
+        continue;
+      }
+      
+      if(empty>0)
+      {
+        buffer[n++]=(char)('0'+empty);
+        empty=0;
+      }
+      
+      int type=position_code_type(code);
+      buffer[n++]=(char)((position_code_owner(code,rank)==BLACK)? tolower(type) : type);
+      
+      if(code==POS_EP_PAWN)
+      {
+        ep_file=file;
+        ep_rank=(rank==4)? 3 : 6;
+      }
+    }
+    if(empty>0)
+    {
+      buffer[n++]=(char)('0'+empty);
+    }
+    if(rank>1)
+    {
+      buffer[n++]='/';
+    }
+  }
+  
+  //side to move
+  buffer[n++]=' ';
+  buffer[n++]=(player_id==WHITE)? 'w' : 'b';
+  buffer[n++]=' ';
+  
+  //castling; a right is a king that's never moved on the home rank and a never-moved rook in that corner
+  int castle_start=n;
+  const int home_ranks[2]={1,8};
+  for(int owner=WHITE; owner<=BLACK; owner++)
+  {
+    int home_rank=home_ranks[owner];
+    bool home_king=false;
+    for(int f=1; f<=8; f++)
+    {
+      if(position_get(pos,f,home_rank)==POS_HOME_KING)
+      {
+        home_king=true;
+      }
+    }
+    
+    if(home_king && position_get(pos,8,home_rank)==POS_CASTLE_ROOK)
+    {
+      buffer[n++]=(owner==WHITE)? 'K' : 'k';
+    }
+    if(home_king && position_get(pos,1,home_rank)==POS_CASTLE_ROOK)
+    {
+      buffer[n++]=(owner==WHITE)? 'Q' : 'q';
+    }
+  }
+  if(n==castle_start)
+  {
+    buffer[n++]='-';
+  }
+  buffer[n++]=' ';
+  
+  //en passant target square
+  if(ep_file>0)
+  {
+    buffer[n++]=(char)('a'+ep_file-1);
+    buffer[n++]=(char)('0'+ep_rank);
+  }
+  else
+  {
+    buffer[n++]='-';
+  }
+  
+  snprintf(buffer+n,FEN_SIZE-n," %i %i",halfmove,fullmove);
+}
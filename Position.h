@@ -0,0 +1,73 @@
+
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <string.h>
+
+struct _Position;
+
+//a packed board position, for storing lots of positions compactly
+//64 squares at 4 bits each is exactly 32 bytes, so copying one is a single memcpy
+//(a Board by comparison is 64 pointers plus a malloc per piece plus tree bookkeeping)
+//
+//like a Board this doesn't know whose turn it is; that's carried separately as a player_id everywhere
+//the move counters aren't part of it either, the things that need those still need a Board
+struct _Position
+{
+  //two squares per byte, low nibble first, in the same (rank*8)+file order as Board::state
+  unsigned char squares[32];
+};
+
+//piece codes stored in each nibble
+//bits 0-2 are the type, bit 3 is set for pieces BLACK owns
+#define POS_EMPTY 0
+#define POS_PAWN 1
+#define POS_ROOK 2
+#define POS_KNIGHT 3
+#define POS_BISHOP 4
+#define POS_QUEEN 5
+#define POS_KING 6
+#define POS_BLACK 8
+
+//the three codes that aren't a real piece carry castling and en passant state
+//the owner of these is implied by the rank they're on, so they don't need bit 3
+//a rook in its corner which has never moved (castling with it is still possible)
+#define POS_CASTLE_ROOK 7
+//a pawn that just moved two squares (so it can be captured en passant)
+#define POS_EP_PAWN 8
+//a king on its home rank which has never moved
+#define POS_HOME_KING 15
+
+//the piece code at a given location (1-indexed, like everywhere else)
+int position_get(const _Position *pos, int file, int rank);
+//set the piece code at a given location (1-indexed)
+void position_set(_Position *pos, int file, int rank, int code);
+
+//an empty position (no pieces at all)
+void position_clear(_Position *pos);
+//copy one position into another
+void position_copy(_Position *dest, const _Position *src);
+//true if the two positions are identical, including castling and en passant state
+bool position_equals(const _Position *a, const _Position *b);
+
+//convert between the 'P','R',... type characters a _SuperPiece uses and the 3-bit types above
+int position_type_code(int type);
+int position_code_type(int code);
+
+//a 64-bit hash of a position and the side to move (Zobrist hashing; a random key for every piece code on every square)
+//the keys come from a fixed seed, so a position hashes the same way every run
+unsigned long long position_hash(const _Position *pos, int player_id);
+
+//the longest a FEN string can be (plus a null terminator)
+#define FEN_SIZE 100
+
+//read a position in Forsyth-Edwards Notation
+//the side to move and the two move counters come back separately since a position doesn't have them
+//(the counters are optional in the string; they default to 0 and 1)
+//returns false, leaving pos in an unknown state, if the string isn't a valid FEN
+bool position_from_fen(_Position *pos, const char *fen, int *player_id, int *halfmove, int *fullmove);
+//write a position in Forsyth-Edwards Notation; buffer must hold at least FEN_SIZE chars
+void position_to_fen(const _Position *pos, int player_id, int halfmove, int fullmove, char *buffer);
+
+#endif
+
@@ -0,0 +1,93 @@
+#include "SearchClock.h"
+
+SearchClock::SearchClock()
+{
+  start_time=chrono::steady_clock::now();
+  timing=false;
+  limit_usec.store(limit_unset);
+  stop_flag.store(false);
+  check_interval=default_check_interval;
+  nodes_until_check=check_interval;
+}
+
+//start timing now; if limited is false there's no time limit (but stop() still works)
+void SearchClock::start(double limit_seconds, bool limited)
+{
+  nodes_until_check=check_interval;
+  long long limit=limited? (long long)(((limit_seconds<0)? 0 : limit_seconds)*1000000.0) : -1;
+  
+  //a reset clock has been timing since then (and whoever reset it may be reading start_time),
+  //and a limit set (or cleared) from elsewhere since then wins over this one, even if it comes in right now
+  if(timing)
+  {
+    timing=false;
+    long long unset=limit_unset;
+    limit_usec.compare_exchange_strong(unset,limit);
+    return;
+  }
+  
+  start_time=chrono::steady_clock::now();
+  limit_usec.store(limit);
+}
+
+//clear the stop flag and the limit, and start timing now
+void SearchClock::reset()
+{
+  start_time=chrono::steady_clock::now();
+  timing=true;
+  limit_usec.store(limit_unset);
+  stop_flag.store(false);
+}
+
+//call this once per node; true once the search should stop
+bool SearchClock::out_of_time()
+{
+  nodes_until_check--;
+  if(nodes_until_check==0)
+  {
+    nodes_until_check=check_interval;
+    
+    long long limit=limit_usec.load(memory_order_relaxed);
+    if(limit>=0)
+    {
+      long long used=chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now()-start_time).count();
+      if(used>=limit)
+      {
+        stop_flag.store(true);
+      }
+    }
+  }
+  
+  return stop_flag.load(memory_order_relaxed);
+}
+
+//seconds since start()
+double SearchClock::elapsed()
+{
+  return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now()-start_time).count()/1000000.0;
+}
+
+//change the time limit (in seconds from start())
+void SearchClock::set_limit(double limit_seconds)
+{
+  //DEFENSIVE: a negative limit would mean no limit at all, which is not what was asked for
+  if(limit_seconds<0)
+  {
+    limit_seconds=0;
+  }
+  limit_usec.store((long long)(limit_seconds*1000000.0));
+}
+
+//remove the time limit
+void SearchClock::clear_limit()
+{
+  limit_usec.store(-1);
+}
+
+//how many nodes to go between clock checks (at least 1)
+void SearchClock::set_check_interval(unsigned int interval)
+{
+  check_interval=(interval>0)? interval : 1;
+  nodes_until_check=check_interval;
+}
+
@@ -0,0 +1,73 @@
+
+#ifndef SEARCHCLOCK_H
+#define SEARCHCLOCK_H
+
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+//keeps time for a tree search
+//
+//rather than reading the clock on every node, out_of_time() only looks at it every check_interval nodes
+//the time is from a monotonic clock, so it doesn't jump when the system time is changed
+//out_of_time() is called by the thread doing the search; stop() and the limit setters can be called from any other thread
+//(e.g. to stop a search running in the background) and the search sees it on its next node
+class SearchClock
+{
+private:
+  //how many nodes to go between looking at the clock
+  //nodes in this search are expensive (every one generates all its children), so this doesn't need to be big
+  static const unsigned int default_check_interval=16;
+  
+  //the value limit_usec has until a limit is set or cleared
+  static const long long limit_unset=-2;
+  
+  chrono::steady_clock::time_point start_time;
+  //true from reset() until start(); the clock is already timing from reset() then
+  bool timing;
+  
+  //the time limit in microseconds from start_time, or a negative value for no limit
+  //(this is atomic so it can be changed while a search is running, e.g. by a ponder hit)
+  atomic<long long> limit_usec;
+  
+  //set once the search should stop, whatever the reason
+  atomic<bool> stop_flag;
+  
+  unsigned int check_interval;
+  unsigned int nodes_until_check;
+
+public:
+  SearchClock();
+  
+  //start timing now; if limited is false there's no time limit (but stop() still works)
+  //this doesn't clear an earlier stop(), so a stop that comes in before the search starts isn't lost
+  //and after a reset() the clock keeps timing from then, and keeps any limit set since then (e.g. by a ponder hit)
+  void start(double limit_seconds, bool limited);
+  
+  //clear the stop flag and the limit, and start timing now, so this clock can be used for another search
+  //call this on the thread that starts the search, before the search runs; elapsed() and the limit setters are good from then on
+  void reset();
+  
+  //call this once per node; true once the search should stop
+  bool out_of_time();
+  
+  //seconds since start()
+  double elapsed();
+  
+  //change the time limit (in seconds from start()) or remove it; safe to call from another thread
+  void set_limit(double limit_seconds);
+  void clear_limit();
+  bool limited(){ return limit_usec.load()>=0; }
+  double get_limit(){ return limit_usec.load()/1000000.0; }
+  
+  //stop the search as soon as possible; safe to call from another thread
+  void stop(){ stop_flag.store(true); }
+  bool stopped(){ return stop_flag.load(memory_order_relaxed); }
+  
+  //how many nodes to go between clock checks (at least 1)
+  void set_check_interval(unsigned int interval);
+};
+
+#endif
+
@@ -0,0 +1,76 @@
+
+#ifndef SEARCHSTATS_H
+#define SEARCHSTATS_H
+
+#include <stdio.h>
+#include "structures.h"
+
+struct _SearchLine;
+struct _SearchStats;
+
+//how many move indices beta cutoffs are counted separately for
+//(cutoffs on moves at or after the last index all get counted there)
+#define STATS_CUTOFF_SLOTS 8
+//the most lines a multi-PV search can give, and how many moves of each are kept
+#define STATS_MAX_LINES 16
+#define STATS_MAX_PV 32
+
+//one line of play from the root; the moves expected from both sides, and what it's worth (from the searching player's point of view)
+struct _SearchLine
+{
+  _Move pv[STATS_MAX_PV];
+  int pv_length;
+  double value;
+};
+
+//counts of what a search did, for tuning
+//totals are for the whole id_minimax call; the iteration fields are for the most recently finished iteration
+struct _SearchStats
+{
+  //nodes visited (min_or_max calls), and how many of those were past the depth limit in quiescent search
+  unsigned long long nodes;
+  unsigned long long qnodes;
+  //transposition table entries found for a node (stays 0 when there's no table in use)
+  unsigned long long tt_hits;
+  //positions scored from endgame tables instead of being searched (stays 0 when there are none)
+  unsigned long long tb_hits;
+  //moves searched a ply deeper than their depth limit (checks, only replies, recaptures and singular moves)
+  unsigned long long extensions;
+  //nodes cut off by reverse futility or razoring, and moves skipped by futility pruning
+  unsigned long long pruned;
+  
+  //pruning cutoffs, in total and by the index of the move that caused the cutoff
+  unsigned long long cutoffs;
+  unsigned long long cutoffs_at[STATS_CUTOFF_SLOTS];
+  
+  //the depth limit of the last iteration, and whether it finished before time ran out
+  int depth;
+  bool complete;
+  //nodes visited in the last iteration, and in the iteration before it
+  unsigned long long iteration_nodes;
+  unsigned long long prev_iteration_nodes;
+  //seconds taken by the last iteration, and by the whole search so far
+  double iteration_time;
+  double total_time;
+  
+  //the best move from the last complete iteration and its value (from the searching player's point of view)
+  //these are only meaningful once have_best is true
+  _Move best_move;
+  double value;
+  bool have_best;
+  //the best lines from the last complete iteration, best first; one unless more were asked for (multipv)
+  //the first line starts with best_move, and every line's value is exact
+  _SearchLine lines[STATS_MAX_LINES];
+  int line_count;
+  
+  //where to print a line of stats after every iteration (NULL for nowhere)
+  FILE *output;
+  
+  //called after every iteration with these stats and hook_data (NULL for nothing to call)
+  //this is how a front-end shows progress while a search is still running (e.g. UCI info lines)
+  void (*iteration_hook)(_SearchStats *stats, void *hook_data);
+  void *hook_data;
+};
+
+#endif
+
@@ -0,0 +1,69 @@
+#include "SearchThread.h"
+#include "TreeSearch.h"
+
+SearchThread::SearchThread()
+{
+  running=false;
+}
+
+SearchThread::~SearchThread()
+{
+  stop();
+}
+
+//start searching a copy of board on the search thread
+void SearchThread::start(AI *ai, Board *board, int player_id, int depth_limit, bool time_limited, double time_remaining, double increment, int moves_to_go, bool fixed_time, void (*done)(_Move *move, Board *root, void *done_data), void *done_data)
+{
+  stop();
+  
+  clock.reset();
+  running=true;
+  worker=thread(&SearchThread::search,this,ai,new Board(board),player_id,depth_limit,time_limited,time_remaining,increment,moves_to_go,fixed_time,done,done_data);
+}
+
+//stop the search as soon as possible and wait for it to finish
+void SearchThread::stop()
+{
+  if(running)
+  {
+    clock.stop();
+    worker.join();
+    running=false;
+  }
+}
+
+//wait for the search to finish on its own
+void SearchThread::wait()
+{
+  if(running)
+  {
+    worker.join();
+    running=false;
+  }
+}
+
+//the thread itself; searches root (which it owns) and hands the result to done
+void SearchThread::search(AI *ai, Board *root, int player_id, int depth_limit, bool time_limited, double time_remaining, double increment, int moves_to_go, bool fixed_time, void (*done)(_Move *move, Board *root, void *done_data), void *done_data)
+{
+  _Move *move=ai->search_move(root,player_id,depth_limit,time_limited,time_remaining,increment,moves_to_go,fixed_time,&clock);
+  
+  //if even the first iteration didn't finish, any legal move is better than none
+  if(move==NULL)
+  {
+    vector<_Move*> legal_moves=TreeSearch::generate_moves(root,player_id);
+    if(!legal_moves.empty())
+    {
+      move=root->copy_move(legal_moves[0]);
+    }
+    root->clear_children();
+  }
+  
+  done(move,root,done_data);
+  
+  if(move!=NULL)
+  {
+    NodeArena::node_free(move);
+  }
+  delete root;
+}
+
@@ -0,0 +1,49 @@
+
+#ifndef SEARCHTHREAD_H
+#define SEARCHTHREAD_H
+
+#include <thread>
+#include "Board.h"
+#include "AI.h"
+#include "SearchClock.h"
+
+using namespace std;
+
+//runs one AI search at a time on a thread of its own, so whoever started it can carry on (reading commands, etc.)
+//
+//the search is of a copy of the board it was given, so the original can change while it runs
+//when it's done, a function given to start() is called on the search thread with the move that was found
+//the clock can be used to stop the search early, or to change its time limit while it runs (e.g. on a ponder hit);
+//it's reset on the thread calling start(), so that's safe as soon as start() returns, even before the search has got going
+class SearchThread
+{
+private:
+  thread worker;
+  bool running;
+  SearchClock clock;
+  
+  //the thread itself; searches root (which it owns) and hands the result to done
+  void search(AI *ai, Board *root, int player_id, int depth_limit, bool time_limited, double time_remaining, double increment, int moves_to_go, bool fixed_time, void (*done)(_Move *move, Board *root, void *done_data), void *done_data);
+
+public:
+  SearchThread();
+  //stops any search that's still running
+  ~SearchThread();
+  
+  //start searching a copy of board for player_id with ai's settings and the given limits (see AI::search_move)
+  //done is called on the search thread with the move found (NULL only when there are no legal moves; it's freed after done returns)
+  //and the board that was searched; any search already running is stopped first
+  void start(AI *ai, Board *board, int player_id, int depth_limit, bool time_limited, double time_remaining, double increment, int moves_to_go, bool fixed_time, void (*done)(_Move *move, Board *root, void *done_data), void *done_data);
+  
+  //stop the search as soon as possible and wait for it to finish (done still gets called)
+  void stop();
+  //wait for the search to finish on its own
+  void wait();
+  
+  //true from start() until stop() or wait() (the search may have finished already by then)
+  bool is_running(){ return running; }
+  SearchClock *get_clock(){ return &clock; }
+};
+
+#endif
+
@@ -0,0 +1,1406 @@
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <algorithm>
+#include "TreeSearch.h"
+#include "Tablebase.h"
+#include "Syzygy.h"
+
+//what the files are called, and what they start with
+#define SZ_WDL_EXTENSION ".rtbw"
+#define SZ_DTZ_EXTENSION ".rtbz"
+static const unsigned char sz_wdl_magic[4]={0x71,0xe8,0x23,0x5d};
+static const unsigned char sz_dtz_magic[4]={0xd7,0x66,0x0c,0xa5};
+
+//flags on each part of a file
+#define SZ_FLAG_STM 1
+#define SZ_FLAG_MAPPED 2
+#define SZ_FLAG_WIN_PLIES 4
+#define SZ_FLAG_LOSS_PLIES 8
+#define SZ_FLAG_WIDE 16
+#define SZ_FLAG_SINGLE_VALUE 128
+
+//how a probe went
+#define SZ_FAIL 0
+#define SZ_OK 1
+//the best move is a capture or pawn move, so a DTZ table has nothing to say about this position
+#define SZ_ZEROING_BEST_MOVE 2
+//a DTZ table only holds one side to move, and this was the other one
+#define SZ_CHANGE_STM 3
+
+//the tables the position index is made with
+//  binomial[k][n] is n choose k
+//  b1h1h7 numbers the squares below the a1-h8 diagonal, and a1d1d4 the a1-d1-d4 triangle (diagonal squares last)
+//  kk numbers every legal placement of two kings, the first in the a1-d1-d4 triangle (462 of them)
+//  pawns numbers a2-h7 so the leading pawn (nearest the a or h file, then lowest) has the highest number
+static unsigned long long sz_binomial[SZ_MAX_PIECES][64];
+static int sz_map_b1h1h7[64];
+static int sz_map_a1d1d4[64];
+static int sz_map_kk[10][64];
+static int sz_map_pawns[64];
+static int sz_lead_pawn_idx[SZ_MAX_PIECES][64];
+static int sz_lead_pawns_size[SZ_MAX_PIECES][4];
+
+//how far a square is above (positive) or below (negative) the a1-h8 diagonal
+static int sz_off_diagonal(int square)
+{
+  return (square/8)-(square%8);
+}
+
+static bool sz_make_tables()
+{
+  int code=0;
+  for(int square=0; square<64; square++)
+  {
+    if(sz_off_diagonal(square)<0)
+    {
+      sz_map_b1h1h7[square]=code++;
+    }
+  }
+  
+  //d4 is square 27
+  vector<int> diagonal;
+  code=0;
+  for(int square=0; square<=27; square++)
+  {
+    if(sz_off_diagonal(square)<0 && (square%8)<=3)
+    {
+      sz_map_a1d1d4[square]=code++;
+    }
+    else if(sz_off_diagonal(square)==0 && (square%8)<=3)
+    {
+      diagonal.push_back(square);
+    }
+  }
+  for(size_t i=0; i<diagonal.size(); i++)
+  {
+    sz_map_a1d1d4[diagonal[i]]=code++;
+  }
+  
+  //when the first king is on the diagonal, the second isn't above it; placements with both on the diagonal come last
+  vector<pair<int,int> > both_on_diagonal;
+  code=0;
+  for(int idx=0; idx<10; idx++)
+  {
+    for(int first=0; first<=27; first++)
+    {
+      //every square outside the triangle is also 0, so b1 (square 1) is the only real 0
+      if(sz_map_a1d1d4[first]!=idx || (idx==0 && first!=1))
+      {
+        continue;
+      }
+      for(int second=0; second<64; second++)
+      {
+        if(abs((first/8)-(second/8))<=1 && abs((first%8)-(second%8))<=1)
+        {
+          continue;
+        }
+        if(sz_off_diagonal(first)==0 && sz_off_diagonal(second)>0)
+        {
+          continue;
+        }
+        if(sz_off_diagonal(first)==0 && sz_off_diagonal(second)==0)
+        {
+          both_on_diagonal.push_back(pair<int,int>(idx,second));
+        }
+        else
+        {
+          sz_map_kk[idx][second]=code++;
+        }
+      }
+    }
+  }
+  for(size_t i=0; i<both_on_diagonal.size(); i++)
+  {
+    sz_map_kk[both_on_diagonal[i].first][both_on_diagonal[i].second]=code++;
+  }
+  
+  sz_binomial[0][0]=1;
+  for(int n=1; n<64; n++)
+  {
+    for(int k=0; k<SZ_MAX_PIECES && k<=n; k++)
+    {
+      sz_binomial[k][n]=((k>0)? sz_binomial[k-1][n-1] : 0)+((k<n)? sz_binomial[k][n-1] : 0);
+    }
+  }
+  
+  //pawn tables are split by the file of the leading pawn (a-d, once mirrored), so each file's index starts over
+  int available=47;
+  for(int lead_count=1; lead_count<=SZ_MAX_PIECES-2; lead_count++)
+  {
+    for(int file=0; file<4; file++)
+    {
+      int idx=0;
+      for(int rank=1; rank<=6; rank++)
+      {
+        int square=(rank*8)+file;
+        if(lead_count==1)
+        {
+          sz_map_pawns[square]=available--;
+          sz_map_pawns[square^7]=available--;
+        }
+        sz_lead_pawn_idx[lead_count][square]=idx;
+        idx+=sz_binomial[lead_count-1][sz_map_pawns[square]];
+      }
+      sz_lead_pawns_size[lead_count][file]=idx;
+    }
+  }
+  return true;
+}
+static bool sz_tables_made=sz_make_tables();
+
+//numbers in the files
+static unsigned int sz_read_le16(const unsigned char *data)
+{
+  return data[0]|(data[1]<<8);
+}
+
+static unsigned int sz_read_le32(const unsigned char *data)
+{
+  return data[0]|(data[1]<<8)|(data[2]<<16)|((unsigned int)(data[3])<<24);
+}
+
+static unsigned int sz_read_be32(const unsigned char *data)
+{
+  return ((unsigned int)(data[0])<<24)|(data[1]<<16)|(data[2]<<8)|data[3];
+}
+
+static unsigned long long sz_read_be64(const unsigned char *data)
+{
+  return (((unsigned long long)(sz_read_be32(data)))<<32)|sz_read_be32(data+4);
+}
+
+//the two symbols a symbol pairs up (12 bits each); a symbol that's just a value has 0xfff on the right
+static int sz_left(const _SZPairs *d, int sym)
+{
+  const unsigned char *lr=d->btree+(3*sym);
+  return ((lr[1]&0xf)<<8)|lr[0];
+}
+
+static int sz_right(const _SZPairs *d, int sym)
+{
+  const unsigned char *lr=d->btree+(3*sym);
+  return (lr[2]<<4)|(lr[1]>>4);
+}
+
+static int sz_sign(int x)
+{
+  return (x>0)-(x<0);
+}
+
+//how many values past the first a symbol stands for
+static int sz_symlen(_SZPairs *d, int sym, vector<bool> *visited)
+{
+  (*visited)[sym]=true;
+  int right=sz_right(d,sym);
+  if(right==0xfff)
+  {
+    return 0;
+  }
+  int left=sz_left(d,sym);
+  if(left>=(int)(d->symlen.size()) || right>=(int)(d->symlen.size()))
+  {
+    return 0;
+  }
+  if(!(*visited)[left])
+  {
+    d->symlen[left]=sz_symlen(d,left,visited);
+  }
+  if(!(*visited)[right])
+  {
+    d->symlen[right]=sz_symlen(d,right,visited);
+  }
+  return d->symlen[left]+d->symlen[right]+1;
+}
+
+//work out how the pieces are grouped in the index, and how much each group is worth in it
+//pieces of the same kind are indexed together (as a combination), and so are the first 2 or 3 pieces (or the leading pawns)
+//order says where the leading group (and the other side's pawns) go among the groups
+static void sz_set_groups(const _SZTable *table, _SZPairs *d, const int order[2], int file)
+{
+  int n=0;
+  int first_len=table->has_pawns? 0 : table->unique_pieces? 3 : 2;
+  d->group_len[n]=1;
+  for(int i=1; i<table->piece_count; i++)
+  {
+    first_len--;
+    if(first_len>0 || d->pieces[i]==d->pieces[i-1])
+    {
+      d->group_len[n]++;
+    }
+    else
+    {
+      n++;
+      d->group_len[n]=1;
+    }
+  }
+  n++;
+  d->group_len[n]=0;
+  
+  bool other_pawns=(table->has_pawns && table->pawn_count[1]>0);
+  int next=other_pawns? 2 : 1;
+  int free_squares=64-d->group_len[0]-(other_pawns? d->group_len[1] : 0);
+  unsigned long long idx=1;
+  for(int k=0; (next<n || k==order[0] || k==order[1]) && k<16; k++)
+  {
+    if(k==order[0])
+    {
+      d->group_idx[0]=idx;
+      idx*=table->has_pawns? sz_lead_pawns_size[d->group_len[0]][file] : table->unique_pieces? 31332 : 462;
+    }
+    else if(k==order[1])
+    {
+      d->group_idx[1]=idx;
+      idx*=sz_binomial[d->group_len[1]][48-d->group_len[0]];
+    }
+    else
+    {
+      d->group_idx[next]=idx;
+      idx*=sz_binomial[d->group_len[next]][free_squares];
+      free_squares-=d->group_len[next];
+      next++;
+    }
+  }
+  d->group_idx[n]=idx;
+}
+
+//read the sizes and the Huffman code for one part of a file; returns where the next part's start
+static const unsigned char *sz_read_sizes(_SZPairs *d, const unsigned char *data)
+{
+  d->flags=*data++;
+  if(d->flags&SZ_FLAG_SINGLE_VALUE)
+  {
+    //every position has the same value, which is all that's stored
+    d->blocks_num=0;
+    d->block_length_size=0;
+    d->span=0;
+    d->sparse_index_size=0;
+    d->min_sym_len=*data++;
+    return data;
+  }
+  
+  int n=0;
+  while(d->group_len[n]!=0)
+  {
+    n++;
+  }
+  unsigned long long size=d->group_idx[n];
+  
+  d->sizeof_block=((size_t)(1))<<(*data++);
+  d->span=((size_t)(1))<<(*data++);
+  d->sparse_index_size=(size+d->span-1)/d->span;
+  int padding=*data++;
+  d->blocks_num=sz_read_le32(data);
+  data+=4;
+  d->block_length_size=d->blocks_num+padding;
+  d->max_sym_len=*data++;
+  d->min_sym_len=*data++;
+  d->lowest_sym=data;
+  
+  //canonical Huffman codes; longer codes have lower values, so the length of the next code in a block is found by comparing against these
+  int lengths=d->max_sym_len-d->min_sym_len+1;
+  if(lengths<1 || d->min_sym_len<1)
+  {
+    return NULL;
+  }
+  d->base64.assign(lengths,0);
+  for(int i=lengths-2; i>=0; i--)
+  {
+    d->base64[i]=(d->base64[i+1]+sz_read_le16(d->lowest_sym+(2*i))-sz_read_le16(d->lowest_sym+(2*(i+1))))/2;
+  }
+  for(int i=0; i<lengths; i++)
+  {
+    d->base64[i]<<=64-i-d->min_sym_len;
+  }
+  data+=lengths*2;
+  
+  int sym_count=sz_read_le16(data);
+  data+=2;
+  d->btree=data;
+  d->symlen.assign(sym_count,0);
+  vector<bool> visited(sym_count,false);
+  for(int sym=0; sym<sym_count; sym++)
+  {
+    if(!visited[sym])
+    {
+      d->symlen[sym]=sz_symlen(d,sym,&visited);
+    }
+  }
+  return data+(sym_count*3)+(sym_count&1);
+}
+
+//the value at an index in one part of a file
+static int sz_decompress(const _SZPairs *d, unsigned long long idx)
+{
+  if(d->flags&SZ_FLAG_SINGLE_VALUE)
+  {
+    return d->min_sym_len;
+  }
+  
+  //the sparse index has the block (and offset in it) for a value every span values; from there, walk to the block with this one
+  size_t k=idx/d->span;
+  if(k>=d->sparse_index_size)
+  {
+    return 0;
+  }
+  long long block=sz_read_le32(d->sparse_index+(6*k));
+  long long offset=sz_read_le16(d->sparse_index+(6*k)+4);
+  offset+=(long long)(idx%d->span)-(long long)(d->span/2);
+  while(offset<0 && block>0)
+  {
+    block--;
+    offset+=sz_read_le16(d->block_length+(2*block))+1;
+  }
+  while(offset>sz_read_le16(d->block_length+(2*block)) && block+1<(long long)(d->block_length_size))
+  {
+    offset-=sz_read_le16(d->block_length+(2*block))+1;
+    block++;
+  }
+  
+  //read symbols through the block until we're at the one covering offset
+  const unsigned char *ptr=d->data+(block*d->sizeof_block);
+  unsigned long long buffer=sz_read_be64(ptr);
+  ptr+=8;
+  int buffer_size=64;
+  int sym;
+  while(true)
+  {
+    int len=0;
+    while(len+1<(int)(d->base64.size()) && buffer<d->base64[len])
+    {
+      len++;
+    }
+    sym=(int)((buffer-d->base64[len])>>(64-len-d->min_sym_len));
+    sym=(sym+sz_read_le16(d->lowest_sym+(2*len)))&0xffff;
+    if(sym>=(int)(d->symlen.size()))
+    {
+      return 0;
+    }
+    if(offset<d->symlen[sym]+1)
+    {
+      break;
+    }
+    offset-=d->symlen[sym]+1;
+    len+=d->min_sym_len;
+    buffer<<=len;
+    buffer_size-=len;
+    if(buffer_size<=32)
+    {
+      buffer_size+=32;
+      buffer|=((unsigned long long)(sz_read_be32(ptr)))<<(64-buffer_size);
+      ptr+=4;
+    }
+  }
+  
+  //then down through the pairs the symbol stands for to the one value we want
+  while(d->symlen[sym]!=0)
+  {
+    int left=sz_left(d,sym);
+    if(offset<d->symlen[left]+1)
+    {
+      sym=left;
+    }
+    else
+    {
+      offset-=d->symlen[left]+1;
+      sym=sz_right(d,sym);
+    }
+  }
+  return sz_left(d,sym);
+}
+
+//the pieces on a board; false if it can't be in a table (castling is still possible, or there are too many pieces)
+static bool sz_read_board(Board *board, _SZPosition *pos)
+{
+  const char types[]=" PNBRQK";
+  const char name_order[]="KQRBNP";
+  
+  pos->count=0;
+  int kings[2]={0,0};
+  bool home_kings[2]={false,false};
+  bool home_rooks[2]={false,false};
+  for(int rank=1; rank<=8; rank++)
+  {
+    for(int file=1; file<=8; file++)
+    {
+      _SuperPiece *piece=board->get_element(file,rank);
+      if(piece==NULL)
+      {
+        continue;
+      }
+      if(pos->count>=SZ_MAX_PIECES)
+      {
+        return false;
+      }
+      
+      int home_rank=(piece->owner==WHITE)? 1 : 8;
+      if(piece->type=='K')
+      {
+        kings[piece->owner]++;
+        home_kings[piece->owner]=(piece->movements==0 && rank==home_rank);
+      }
+      else if(piece->type=='R' && piece->movements==0 && rank==home_rank && (file==1 || file==8))
+      {
+        home_rooks[piece->owner]=true;
+      }
+      
+      pos->square[pos->count]=((rank-1)*8)+(file-1);
+      pos->piece[pos->count]=(strchr(types,piece->type)-types)+((piece->owner==BLACK)? 8 : 0);
+      pos->count++;
+    }
+  }
+  if(kings[WHITE]!=1 || kings[BLACK]!=1 || (home_kings[WHITE] && home_rooks[WHITE]) || (home_kings[BLACK] && home_rooks[BLACK]))
+  {
+    return false;
+  }
+  
+  for(int color=WHITE; color<=BLACK; color++)
+  {
+    int length=0;
+    for(int t=0; name_order[t]!='\0'; t++)
+    {
+      for(int i=0; i<pos->count; i++)
+      {
+        if(types[pos->piece[i]&7]==name_order[t] && (pos->piece[i]>>3)==color)
+        {
+          pos->material[color][length++]=name_order[t];
+        }
+      }
+    }
+    pos->material[color][length]='\0';
+  }
+  return true;
+}
+
+//how many pieces are on a board
+static int sz_board_pieces(Board *board)
+{
+  int count=0;
+  for(int rank=1; rank<=8; rank++)
+  {
+    for(int file=1; file<=8; file++)
+    {
+      count+=(board->get_element(file,rank)!=NULL);
+    }
+  }
+  return count;
+}
+
+//whether a child's move was a capture or a pawn move (which reset the 50 move count)
+static bool sz_zeroing(Board *board, Board *child, bool *capture)
+{
+  _Move *move=child->get_last_move_made();
+  _SuperPiece *piece=board->get_element(move->fromFile,move->fromRank);
+  bool pawn=(piece!=NULL && piece->type=='P');
+  *capture=(board->get_element(move->toFile,move->toRank)!=NULL || (pawn && move->fromFile!=move->toFile));
+  return (*capture || pawn);
+}
+
+//whether player_id is checkmated on board
+static bool sz_mated(Board *board, int player_id)
+{
+  if(!board->get_check(player_id))
+  {
+    return false;
+  }
+  bool mated=TreeSearch::generate_moves(board,player_id).empty();
+  board->clear_children();
+  return mated;
+}
+
+//the DTZ right before a capture or pawn move that gets this result
+static int sz_dtz_before_zeroing(int wdl)
+{
+  return (wdl==SZ_WIN)? 1 : (wdl==SZ_CURSED_WIN)? 101 : (wdl==SZ_BLESSED_LOSS)? -101 : (wdl==SZ_LOSS)? -1 : 0;
+}
+
+Syzygy::Syzygy()
+{
+  max_pieces=0;
+}
+
+Syzygy::~Syzygy()
+{
+  close();
+}
+
+//note a table file found in dir
+void Syzygy::add_table(const char *dir, const char *name, bool dtz)
+{
+  //KQRvKP; a K, then more pieces, on each side of the v
+  const char *v=strchr(name,'v');
+  size_t length=strlen(name);
+  if(v==NULL || name[0]!='K' || v[1]!='K' || length>=SZ_NAME_SIZE || strspn(name,"KQRBNPv")!=length || (int)(length-1)>SZ_MAX_PIECES)
+  {
+    return;
+  }
+  
+  map<string, _SZTable*>::iterator found=table_names.find(name);
+  if(found!=table_names.end())
+  {
+    //the DTZ file can be in a different directory than the WDL one; only the first of each is used
+    if(dtz && !found->second->has_dtz)
+    {
+      found->second->has_dtz=true;
+      if(strcmp(found->second->dir,dir))
+      {
+        fprintf(stderr,"Warn: %s%s isn't in the same directory as %s%s; it won't be used\n",name,SZ_DTZ_EXTENSION,name,SZ_WDL_EXTENSION);
+        found->second->has_dtz=false;
+      }
+    }
+    return;
+  }
+  if(dtz)
+  {
+    //just a DTZ file isn't any use; wait for the WDL one
+    return;
+  }
+  
+  _SZTable *table=new _SZTable();
+  strncpy(table->name,name,SZ_NAME_SIZE-1);
+  table->name[SZ_NAME_SIZE-1]='\0';
+  strncpy(table->dir,dir,PATH_MAX-1);
+  table->dir[PATH_MAX-1]='\0';
+  table->piece_count=length-1;
+  table->has_pawns=(strchr(name,'P')!=NULL);
+  table->has_dtz=false;
+  
+  //count pieces on each side
+  int counts[2][128];
+  memset(counts,0,sizeof(counts));
+  int side=0;
+  for(size_t i=0; i<length; i++)
+  {
+    if(name[i]=='v')
+    {
+      side=1;
+      continue;
+    }
+    counts[side][(int)(name[i])]++;
+  }
+  table->unique_pieces=false;
+  const char *types="QRBNP";
+  for(int s=0; s<2; s++)
+  {
+    for(int t=0; types[t]!='\0'; t++)
+    {
+      if(counts[s][(int)(types[t])]==1)
+      {
+        table->unique_pieces=true;
+      }
+    }
+  }
+  //when both sides have pawns, the side with fewer leads (white when it's even)
+  int white_pawns=counts[0][(int)('P')];
+  int black_pawns=counts[1][(int)('P')];
+  bool white_leads=(black_pawns==0 || (white_pawns>0 && black_pawns>=white_pawns));
+  table->pawn_count[0]=white_leads? white_pawns : black_pawns;
+  table->pawn_count[1]=white_leads? black_pawns : white_pawns;
+  table->symmetric=(strlen(v+1)==(size_t)(v-name) && !strncmp(name,v+1,v-name));
+  
+  table->wdl.loaded.store(false);
+  table->wdl.data=NULL;
+  table->dtz.loaded.store(false);
+  table->dtz.data=NULL;
+  
+  tables.push_back(table);
+  table_names[name]=table;
+  if(table->piece_count>max_pieces)
+  {
+    max_pieces=table->piece_count;
+  }
+}
+
+//find the tables in a directory (or several, separated by ':')
+bool Syzygy::open(const char *paths)
+{
+  close();
+  
+  //WDL files first, so DTZ files have a table to go with
+  for(int pass=0; pass<2; pass++)
+  {
+    const char *extension=(pass==0)? SZ_WDL_EXTENSION : SZ_DTZ_EXTENSION;
+    const char *start=paths;
+    while(*start!='\0')
+    {
+      const char *end=strchr(start,':');
+      size_t length=(end==NULL)? strlen(start) : (size_t)(end-start);
+      char dir[PATH_MAX];
+      snprintf(dir,PATH_MAX,"%.*s",(int)(length),start);
+      start+=length;
+      if(*start==':')
+      {
+        start++;
+      }
+      
+      DIR *listing=opendir(dir);
+      if(listing==NULL)
+      {
+        if(pass==0)
+        {
+          fprintf(stderr,"Warn: Could not read directory %s\n",dir);
+        }
+        continue;
+      }
+      struct dirent *entry;
+      while((entry=readdir(listing))!=NULL)
+      {
+        size_t name_length=strlen(entry->d_name);
+        size_t extension_length=strlen(extension);
+        if(name_length>extension_length && name_length-extension_length<SZ_NAME_SIZE && !strcmp(entry->d_name+name_length-extension_length,extension))
+        {
+          char name[SZ_NAME_SIZE];
+          snprintf(name,SZ_NAME_SIZE,"%.*s",(int)(name_length-extension_length),entry->d_name);
+          add_table(dir,name,pass==1);
+        }
+      }
+      closedir(listing);
+    }
+  }
+  
+  if(tables.empty())
+  {
+    fprintf(stderr,"Err: No Syzygy tables in %s\n",paths);
+    return false;
+  }
+  return true;
+}
+
+void Syzygy::close()
+{
+  for(size_t i=0; i<tables.size(); i++)
+  {
+    if(tables[i]->wdl.data!=NULL)
+    {
+      munmap((void*)(tables[i]->wdl.data),tables[i]->wdl.data_size);
+    }
+    if(tables[i]->dtz.data!=NULL)
+    {
+      munmap((void*)(tables[i]->dtz.data),tables[i]->dtz.data_size);
+    }
+    delete tables[i];
+  }
+  tables.clear();
+  table_names.clear();
+  max_pieces=0;
+}
+
+//map and read a table file
+//this happens once per file, under the lock; after that anyone can read it
+bool Syzygy::load(_SZTable *table, bool dtz)
+{
+  _SZFile *file=dtz? &(table->dtz) : &(table->wdl);
+  if(file->loaded.load(memory_order_acquire))
+  {
+    return file->data!=NULL;
+  }
+  
+  load_lock.lock();
+  if(file->loaded.load(memory_order_relaxed))
+  {
+    load_lock.unlock();
+    return file->data!=NULL;
+  }
+  
+  char fname[PATH_MAX+SZ_NAME_SIZE+8];
+  snprintf(fname,sizeof(fname),"%s/%s%s",table->dir,table->name,dtz? SZ_DTZ_EXTENSION : SZ_WDL_EXTENSION);
+  int fd=::open(fname,O_RDONLY);
+  struct stat file_stat;
+  void *mapped=MAP_FAILED;
+  if(fd>=0 && fstat(fd,&file_stat)>=0 && file_stat.st_size>16)
+  {
+    mapped=mmap(NULL,file_stat.st_size,PROT_READ,MAP_SHARED,fd,0);
+  }
+  if(fd>=0)
+  {
+    ::close(fd);
+  }
+  const unsigned char *magic=dtz? sz_dtz_magic : sz_wdl_magic;
+  if(mapped==MAP_FAILED || memcmp(mapped,magic,4))
+  {
+    fprintf(stderr,"Warn: Could not read Syzygy table %s; it won't be used\n",fname);
+    if(mapped!=MAP_FAILED)
+    {
+      munmap(mapped,file_stat.st_size);
+    }
+    file->loaded.store(true,memory_order_release);
+    load_lock.unlock();
+    return false;
+  }
+  
+  const unsigned char *start=(const unsigned char*)(mapped);
+  const unsigned char *end=start+file_stat.st_size;
+  const unsigned char *data=start+4;
+  
+  //a DTZ file only has one side to move, as does a table with the same material on both sides
+  int sides=(!dtz && !table->symmetric)? 2 : 1;
+  //pawn tables have a part for each file of the leading pawn
+  int files=table->has_pawns? 4 : 1;
+  bool other_pawns=(table->has_pawns && table->pawn_count[1]>0);
+  bool valid=(((data[0]&2)!=0)==table->has_pawns);
+  data++;
+  
+  //the order pieces are indexed in, and where the groups go, for each part
+  for(int f=0; f<files && valid; f++)
+  {
+    int order[2][2]={{data[0]&0xf,other_pawns? (data[1]&0xf) : 0xf},{data[0]>>4,other_pawns? (data[1]>>4) : 0xf}};
+    data+=other_pawns? 2 : 1;
+    for(int k=0; k<table->piece_count; k++)
+    {
+      for(int i=0; i<sides; i++)
+      {
+        file->pairs[i][f].pieces[k]=(i==0)? (data[0]&0xf) : (data[0]>>4);
+      }
+      data++;
+    }
+    for(int i=0; i<sides; i++)
+    {
+      sz_set_groups(table,&(file->pairs[i][f]),order[i],f);
+    }
+  }
+  data+=(data-start)&1;
+  
+  for(int f=0; f<files && valid; f++)
+  {
+    for(int i=0; i<sides && valid; i++)
+    {
+      data=sz_read_sizes(&(file->pairs[i][f]),data);
+      valid=(data!=NULL && data<end);
+    }
+  }
+  
+  //DTZ values are stored as indexes into a map of the values actually used (one map per kind of result)
+  if(dtz && valid)
+  {
+    file->map=data;
+    for(int f=0; f<files; f++)
+    {
+      _SZPairs *d=&(file->pairs[0][f]);
+      if(!(d->flags&SZ_FLAG_MAPPED))
+      {
+        continue;
+      }
+      if(d->flags&SZ_FLAG_WIDE)
+      {
+        data+=(data-start)&1;
+        for(int i=0; i<4; i++)
+        {
+          d->map_idx[i]=((data-file->map)/2)+1;
+          data+=(2*sz_read_le16(data))+2;
+        }
+      }
+      else
+      {
+        for(int i=0; i<4; i++)
+        {
+          d->map_idx[i]=(data-file->map)+1;
+          data+=(*data)+1;
+        }
+      }
+    }
+    data+=(data-start)&1;
+  }
+  
+  for(int f=0; f<files && valid; f++)
+  {
+    for(int i=0; i<sides; i++)
+    {
+      file->pairs[i][f].sparse_index=data;
+      data+=file->pairs[i][f].sparse_index_size*6;
+    }
+  }
+  for(int f=0; f<files && valid; f++)
+  {
+    for(int i=0; i<sides; i++)
+    {
+      file->pairs[i][f].block_length=data;
+      data+=file->pairs[i][f].block_length_size*2;
+    }
+  }
+  for(int f=0; f<files && valid; f++)
+  {
+    for(int i=0; i<sides; i++)
+    {
+      //the blocks start on a 64 byte boundary
+      data=start+(((data-start)+63)&~63);
+      file->pairs[i][f].data=data;
+      data+=file->pairs[i][f].blocks_num*file->pairs[i][f].sizeof_block;
+    }
+  }
+  
+  if(!valid || data>end)
+  {
+    fprintf(stderr,"Warn: Syzygy table %s is damaged; it won't be used\n",fname);
+    munmap(mapped,file_stat.st_size);
+  }
+  else
+  {
+    file->data=start;
+    file->data_size=file_stat.st_size;
+  }
+  file->loaded.store(true,memory_order_release);
+  load_lock.unlock();
+  return file->data!=NULL;
+}
+
+//the table for a position's material (NULL if we don't have one)
+//tables are named with the stronger side first and hold it as white, so when it's the other way around the board gets flipped
+_SZTable *Syzygy::find_table(const _SZPosition *pos, bool *black_stronger)
+{
+  char name[SZ_NAME_SIZE];
+  snprintf(name,SZ_NAME_SIZE,"%sv%s",pos->material[WHITE],pos->material[BLACK]);
+  *black_stronger=false;
+  map<string, _SZTable*>::iterator found=table_names.find(name);
+  if(found==table_names.end())
+  {
+    snprintf(name,SZ_NAME_SIZE,"%sv%s",pos->material[BLACK],pos->material[WHITE]);
+    *black_stronger=true;
+    found=table_names.find(name);
+  }
+  return (found==table_names.end())? NULL : found->second;
+}
+
+//look up a position in its table
+bool Syzygy::probe_table(const _SZPosition *pos, int player_id, bool dtz, int wdl, int *value, int *state)
+{
+  //two kings is always a draw, and has no table
+  if(pos->count==2)
+  {
+    *value=SZ_DRAW;
+    *state=SZ_OK;
+    return true;
+  }
+  
+  bool black_stronger;
+  _SZTable *table=find_table(pos,&black_stronger);
+  if(table==NULL || (dtz && !table->has_dtz) || !load(table,dtz))
+  {
+    *state=SZ_FAIL;
+    return false;
+  }
+  _SZFile *file=dtz? &(table->dtz) : &(table->wdl);
+  
+  //a symmetric table only holds white to move, so black to move is flipped too
+  bool flip=(black_stronger || (table->symmetric && player_id==BLACK));
+  int flip_color=flip? 8 : 0;
+  int flip_squares=flip? 56 : 0;
+  int stm=(flip? 1 : 0)^player_id;
+  
+  int squares[SZ_MAX_PIECES];
+  int pieces[SZ_MAX_PIECES];
+  bool placed[SZ_MAX_PIECES];
+  int size=0;
+  int lead_count=0;
+  int tb_file=0;
+  for(int i=0; i<pos->count; i++)
+  {
+    placed[i]=false;
+  }
+  
+  //pawns of the leading color come first; the one nearest the edge (then lowest) picks which part of the table to use
+  if(table->has_pawns)
+  {
+    int lead_piece=file->pairs[0][0].pieces[0]^flip_color;
+    for(int i=0; i<pos->count; i++)
+    {
+      if(pos->piece[i]==lead_piece)
+      {
+        squares[size]=pos->square[i]^flip_squares;
+        pieces[size]=lead_piece^flip_color;
+        placed[i]=true;
+        size++;
+      }
+    }
+    lead_count=size;
+    int lead=0;
+    for(int i=1; i<lead_count; i++)
+    {
+      if(sz_map_pawns[squares[i]]>sz_map_pawns[squares[lead]])
+      {
+        lead=i;
+      }
+    }
+    swap(squares[0],squares[lead]);
+    tb_file=min(squares[0]%8,7-(squares[0]%8));
+  }
+  
+  _SZPairs *d=&(file->pairs[dtz? 0 : stm][tb_file]);
+  if(dtz && (d->flags&SZ_FLAG_STM)!=stm && !(table->symmetric && !table->has_pawns))
+  {
+    *state=SZ_CHANGE_STM;
+    return false;
+  }
+  
+  for(int i=0; i<pos->count; i++)
+  {
+    if(!placed[i])
+    {
+      squares[size]=pos->square[i]^flip_squares;
+      pieces[size]=pos->piece[i]^flip_color;
+      size++;
+    }
+  }
+  
+  //put the pieces in the order the table indexes them in
+  for(int i=lead_count; i<size-1; i++)
+  {
+    for(int j=i+1; j<size; j++)
+    {
+      if(d->pieces[i]==pieces[j])
+      {
+        swap(pieces[i],pieces[j]);
+        swap(squares[i],squares[j]);
+        break;
+      }
+    }
+  }
+  
+  //mirror so the first piece is on files a-d
+  if((squares[0]%8)>3)
+  {
+    for(int i=0; i<size; i++)
+    {
+      squares[i]^=7;
+    }
+  }
+  
+  unsigned long long idx;
+  if(table->has_pawns)
+  {
+    idx=sz_lead_pawn_idx[lead_count][squares[0]];
+    for(int i=1; i<lead_count; i++)
+    {
+      for(int j=i; j>1 && sz_map_pawns[squares[j]]<sz_map_pawns[squares[j-1]]; j--)
+      {
+        swap(squares[j],squares[j-1]);
+      }
+    }
+    for(int i=1; i<lead_count; i++)
+    {
+      idx+=sz_binomial[i][sz_map_pawns[squares[i]]];
+    }
+  }
+  else
+  {
+    //without pawns there's more symmetry; mirror so the first piece is on ranks 1-4, then below the a1-h8 diagonal
+    if((squares[0]/8)>3)
+    {
+      for(int i=0; i<size; i++)
+      {
+        squares[i]^=56;
+      }
+    }
+    for(int i=0; i<d->group_len[0]; i++)
+    {
+      int off=sz_off_diagonal(squares[i]);
+      if(off==0)
+      {
+        continue;
+      }
+      if(off>0)
+      {
+        for(int j=i; j<size; j++)
+        {
+          squares[j]=((squares[j]>>3)|(squares[j]<<3))&63;
+        }
+      }
+      break;
+    }
+    
+    if(table->unique_pieces)
+    {
+      //the first three pieces together, taking out what the diagonal makes the same
+      int adjust1=(squares[1]>squares[0]);
+      int adjust2=(squares[2]>squares[0])+(squares[2]>squares[1]);
+      if(sz_off_diagonal(squares[0]))
+      {
+        idx=(((sz_map_a1d1d4[squares[0]]*63)+(squares[1]-adjust1))*62)+squares[2]-adjust2;
+      }
+      else if(sz_off_diagonal(squares[1]))
+      {
+        idx=((((6*63)+((squares[0]/8)*28))+sz_map_b1h1h7[squares[1]])*62)+squares[2]-adjust2;
+      }
+      else if(sz_off_diagonal(squares[2]))
+      {
+        idx=(6*63*62)+(4*28*62)+((squares[0]/8)*7*28)+(((squares[1]/8)-adjust1)*28)+sz_map_b1h1h7[squares[2]];
+      }
+      else
+      {
+        idx=(6*63*62)+(4*28*62)+(4*7*28)+((squares[0]/8)*7*6)+(((squares[1]/8)-adjust1)*6)+((squares[2]/8)-adjust2);
+      }
+    }
+    else
+    {
+      idx=sz_map_kk[sz_map_a1d1d4[squares[0]]][squares[1]];
+    }
+  }
+  idx*=d->group_idx[0];
+  
+  //then each group of the same piece, as a combination of the squares that are left
+  int *group=squares+d->group_len[0];
+  bool remaining_pawns=(table->has_pawns && table->pawn_count[1]>0);
+  for(int next=1; d->group_len[next]!=0; next++)
+  {
+    sort(group,group+d->group_len[next]);
+    unsigned long long n=0;
+    for(int i=0; i<d->group_len[next]; i++)
+    {
+      int adjust=0;
+      for(int *s=squares; s<group; s++)
+      {
+        adjust+=(group[i]>*s);
+      }
+      n+=sz_binomial[i+1][group[i]-adjust-(remaining_pawns? 8 : 0)];
+    }
+    remaining_pawns=false;
+    idx+=n*d->group_idx[next];
+    group+=d->group_len[next];
+  }
+  
+  int v=sz_decompress(d,idx);
+  *state=SZ_OK;
+  if(!dtz)
+  {
+    *value=v-2;
+    return true;
+  }
+  
+  //DTZ values may be in moves rather than plies
+  static const int wdl_map[]={1,3,0,2,0};
+  if(d->flags&SZ_FLAG_MAPPED)
+  {
+    int map_index=d->map_idx[wdl_map[wdl+2]]+v;
+    v=(d->flags&SZ_FLAG_WIDE)? sz_read_le16(file->map+(2*map_index)) : file->map[map_index];
+  }
+  if((wdl==SZ_WIN && !(d->flags&SZ_FLAG_WIN_PLIES)) || (wdl==SZ_LOSS && !(d->flags&SZ_FLAG_LOSS_PLIES)) || wdl==SZ_CURSED_WIN || wdl==SZ_BLESSED_LOSS)
+  {
+    v*=2;
+  }
+  *value=v+1;
+  return true;
+}
+
+//the WDL result for a board, searching captures (and pawn moves, if zeroing is true) first
+//a WDL table can store anything for a position where a capture wins, and a loss where a capture draws, if that compresses better
+//so the real value is the best of the captures and the table
+int Syzygy::search(Board *board, int player_id, bool zeroing, int *state)
+{
+  //(no point searching captures if there's no table to finish with)
+  _SZPosition pos;
+  bool black_stronger;
+  if(!sz_read_board(board,&pos) || (pos.count>2 && find_table(&pos,&black_stronger)==NULL))
+  {
+    *state=SZ_FAIL;
+    return SZ_DRAW;
+  }
+  
+  int best=SZ_LOSS;
+  int value;
+  size_t searched=0;
+  TreeSearch::generate_moves(board,player_id);
+  vector<Board*> children=board->get_children();
+  for(size_t i=0; i<children.size(); i++)
+  {
+    bool capture;
+    if(!sz_zeroing(board,children[i],&capture) || (!capture && !zeroing))
+    {
+      continue;
+    }
+    searched++;
+    value=-search(children[i],!player_id,false,state);
+    if(*state==SZ_FAIL)
+    {
+      board->clear_children();
+      return SZ_DRAW;
+    }
+    if(value>best)
+    {
+      best=value;
+      if(value>=SZ_WIN)
+      {
+        board->clear_children();
+        *state=SZ_ZEROING_BEST_MOVE;
+        return value;
+      }
+    }
+  }
+  board->clear_children();
+  
+  //when every move was searched, that's the answer, whatever the table says (it doesn't know about en passant, for one)
+  bool all_searched=(searched>0 && searched==children.size());
+  if(all_searched)
+  {
+    value=best;
+  }
+  else if(!probe_table(&pos,player_id,false,0,&value,state))
+  {
+    return SZ_DRAW;
+  }
+  
+  if(best>=value)
+  {
+    *state=(best>SZ_DRAW || all_searched)? SZ_ZEROING_BEST_MOVE : SZ_OK;
+    return best;
+  }
+  *state=SZ_OK;
+  return value;
+}
+
+//plies to the next capture or pawn move, positive when winning and negative when losing (0 for a draw)
+//when the table is for the other side to move, that's found from the replies
+int Syzygy::dtz(Board *board, int player_id, int *state)
+{
+  *state=SZ_OK;
+  int wdl=search(board,player_id,true,state);
+  if(*state==SZ_FAIL || wdl==SZ_DRAW)
+  {
+    return 0;
+  }
+  if(*state==SZ_ZEROING_BEST_MOVE)
+  {
+    return sz_dtz_before_zeroing(wdl);
+  }
+  
+  _SZPosition pos;
+  sz_read_board(board,&pos);
+  int value;
+  if(probe_table(&pos,player_id,true,wdl,&value,state))
+  {
+    return (value+((wdl==SZ_BLESSED_LOSS || wdl==SZ_CURSED_WIN)? 100 : 0))*sz_sign(wdl);
+  }
+  if(*state==SZ_FAIL)
+  {
+    return 0;
+  }
+  
+  int min_dtz=0xffff;
+  TreeSearch::generate_moves(board,player_id);
+  vector<Board*> children=board->get_children();
+  for(size_t i=0; i<children.size(); i++)
+  {
+    bool capture;
+    bool zeroing=sz_zeroing(board,children[i],&capture);
+    //for a capture or pawn move it's the DTZ before making it that counts (the sign is what it leads to)
+    int child_dtz=zeroing? -sz_dtz_before_zeroing(search(children[i],!player_id,false,state)) : -dtz(children[i],!player_id,state);
+    if(child_dtz==1 && sz_mated(children[i],!player_id))
+    {
+      min_dtz=1;
+    }
+    if(!zeroing)
+    {
+      child_dtz+=sz_sign(child_dtz);
+    }
+    if(child_dtz<min_dtz && sz_sign(child_dtz)==sz_sign(wdl))
+    {
+      min_dtz=child_dtz;
+    }
+    if(*state==SZ_FAIL)
+    {
+      board->clear_children();
+      return 0;
+    }
+  }
+  board->clear_children();
+  
+  //no moves at all is mate
+  return (min_dtz==0xffff)? -1 : min_dtz;
+}
+
+//the WDL result for a board with player_id to move
+bool Syzygy::probe_wdl(Board *board, int player_id, int *wdl)
+{
+  if(tables.empty() || sz_board_pieces(board)>max_pieces)
+  {
+    return false;
+  }
+  int state=SZ_OK;
+  *wdl=search(board,player_id,false,&state);
+  return state!=SZ_FAIL;
+}
+
+//the move the tables say to play
+//every move is ranked by DTZ counting from here; wins that come in time for the 50 move rule are best (the quickest of them), then wins that don't,
+//then draws, then losses the 50 move rule saves us from, then losses (put off as long as possible)
+_Move *Syzygy::root_move(Board *board, int player_id)
+{
+  _SZPosition pos;
+  if(tables.empty() || !sz_read_board(board,&pos) || pos.count>max_pieces)
+  {
+    return NULL;
+  }
+  int count50=board->get_halfmove_clock();
+  
+  _Move *best_move=NULL;
+  int best_rank=0;
+  int best_dtz=0;
+  TreeSearch::generate_moves(board,player_id);
+  vector<Board*> children=board->get_children();
+  for(size_t i=0; i<children.size(); i++)
+  {
+    int state=SZ_OK;
+    bool capture;
+    int dtz;
+    if(sz_zeroing(board,children[i],&capture))
+    {
+      dtz=sz_dtz_before_zeroing(-search(children[i],!player_id,false,&state));
+    }
+    else
+    {
+      dtz=-this->dtz(children[i],!player_id,&state);
+      dtz+=sz_sign(dtz);
+    }
+    if(dtz==2 && sz_mated(children[i],!player_id))
+    {
+      dtz=1;
+    }
+    if(state==SZ_FAIL)
+    {
+      best_move=NULL;
+      break;
+    }
+    
+    //a loss is only saved when the next capture or pawn move (-dtz plies away) would come after the 50 move rule's 100 plies are up
+    int rank=(dtz>0)? ((dtz+count50<=99)? 1000 : 1000-(dtz+count50)) : (dtz<0)? ((-dtz+count50>100)? -1000+(-dtz+count50) : -1000) : 0;
+    //among moves that rank the same, the shortest win (or longest loss) has the smallest dtz
+    if(best_move==NULL || rank>best_rank || (rank==best_rank && dtz<best_dtz))
+    {
+      best_move=children[i]->get_last_move_made();
+      best_rank=rank;
+      best_dtz=dtz;
+    }
+  }
+  
+  if(best_move!=NULL)
+  {
+    best_move=board->copy_move(best_move);
+  }
+  board->clear_children();
+  return best_move;
+}
+
+
+//check the tables against our own for every table of up to TB_MAX_PIECES pieces they both have
+//(the move check needs the DTZ file; without it only WDL is checked)
+//positions are random (but the same every run), with the Syzygy table's material as its name gives it and either side to move
+//WDL has to agree with our tables on win, draw or loss (the 50 move rule aside, so a cursed win is a win), and root_move has to keep that result
+bool Syzygy::verify(const char *syzygy_paths, const char *tb_path, int positions)
+{
+  Syzygy syzygy;
+  Tablebase tb;
+  if(!syzygy.open(syzygy_paths) || !tb.open(tb_path))
+  {
+    return false;
+  }
+  
+  srand(1);
+  int tables_checked=0;
+  unsigned long long total_positions=0;
+  unsigned long long total_mismatches=0;
+  for(size_t t=0; t<syzygy.tables.size(); t++)
+  {
+    _SZTable *table=syzygy.tables[t];
+    if(table->piece_count>TB_MAX_PIECES)
+    {
+      continue;
+    }
+    
+    int checked=0;
+    int uncovered=0;
+    int wdl_mismatches=0;
+    int move_mismatches=0;
+    for(int n=0; n<positions; n++)
+    {
+      //place the pieces, white's before the v and black's after it (and pawns off the first and last ranks)
+      char squares[64];
+      memset(squares,'1',64);
+      bool black=false;
+      for(const char *c=table->name; *c!='\0'; c++)
+      {
+        if(*c=='v')
+        {
+          black=true;
+          continue;
+        }
+        int square;
+        do
+        {
+          square=rand()%64;
+        }
+        while(squares[square]!='1' || (*c=='P' && ((square/8)==0 || (square/8)==7)));
+        squares[square]=black? tolower(*c) : *c;
+      }
+      int player_id=rand()%2;
+      
+      char fen[FEN_SIZE];
+      int len=0;
+      for(int rank=7; rank>=0; rank--)
+      {
+        for(int file=0; file<8; file++)
+        {
+          fen[len++]=squares[(rank*8)+file];
+        }
+        fen[len++]=(rank>0)? '/' : ' ';
+      }
+      snprintf(fen+len,FEN_SIZE-len,"%c - - 0 1",(player_id==WHITE)? 'w' : 'b');
+      
+      //the side that just moved can't be in check (that takes care of kings next to each other too)
+      Board *board=new Board();
+      int fen_player_id;
+      if(!board->from_fen(fen,&fen_player_id) || board->get_check(!player_id))
+      {
+        delete board;
+        n--;
+        continue;
+      }
+      
+      int result;
+      int plies;
+      int wdl;
+      if(!tb.probe(board,player_id,&result,&plies) || !syzygy.probe_wdl(board,player_id,&wdl))
+      {
+        uncovered++;
+        delete board;
+        continue;
+      }
+      checked++;
+      
+      if(sz_sign(wdl)!=result)
+      {
+        wdl_mismatches++;
+        fprintf(stderr,"Warn: %s WDL is %i but our tables say %i for %s\n",table->name,wdl,result,fen);
+      }
+      
+      //the move it picks has to leave the opponent no better off than our tables say they should be
+      _Move *move=syzygy.root_move(board,player_id);
+      if(move!=NULL)
+      {
+        Board *after=new Board(board);
+        after->apply_move(move,true);
+        int reply_result;
+        TreeSearch::generate_moves(after,!player_id);
+        bool mated=after->get_children().empty() && after->get_check(!player_id);
+        after->clear_children();
+        if(!mated && tb.probe(after,!player_id,&reply_result,&plies) && -reply_result<result)
+        {
+          move_mismatches++;
+          fprintf(stderr,"Warn: %s move from %s gives up the result (%i, then %i for the opponent)\n",table->name,fen,result,reply_result);
+        }
+        delete after;
+      }
+      delete board;
+    }
+    
+    printf("syzygy_verify table=%s positions=%i uncovered=%i wdl_mismatches=%i move_mismatches=%i\n",table->name,checked,uncovered,wdl_mismatches,move_mismatches);
+    tables_checked++;
+    total_positions+=checked;
+    total_mismatches+=wdl_mismatches+move_mismatches;
+  }
+  
+  printf("syzygy_verify_summary tables=%i positions=%llu mismatches=%llu\n",tables_checked,total_positions,total_mismatches);
+  return tables_checked>0 && total_mismatches==0;
+}
@@ -0,0 +1,172 @@
+
+#ifndef SYZYGY_H
+#define SYZYGY_H
+
+#include <stdio.h>
+#include <limits.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Board.h"
+
+using namespace std;
+
+//the most pieces (kings included) a Syzygy table can have
+#define SZ_MAX_PIECES 7
+//room for a table name (like KQRvKR), plus a null terminator
+#define SZ_NAME_SIZE 16
+
+//what a WDL probe finds, for the side to move
+//cursed wins and blessed losses are wins and losses that the 50 move rule turns into draws
+#define SZ_LOSS -2
+#define SZ_BLESSED_LOSS -1
+#define SZ_DRAW 0
+#define SZ_CURSED_WIN 1
+#define SZ_WIN 2
+
+//what a Syzygy win is worth in a search, less the plies from the root to where it was found (like a mate, but well short of any mate)
+#define SZ_WIN_SCORE (HEURISTIC_MAXIMUM/2)
+#define SZ_IS_WIN_SCORE(X) ((X)<=SZ_WIN_SCORE && (X)>=(SZ_WIN_SCORE-MATE_PLIES))
+#define SZ_IS_LOSS_SCORE(X) ((X)>=-SZ_WIN_SCORE && (X)<=(-SZ_WIN_SCORE+MATE_PLIES))
+
+struct _SZPosition;
+struct _SZPairs;
+struct _SZFile;
+struct _SZTable;
+
+//the pieces on a board, for a probe
+//squares are (rank*8)+file, 0-indexed, in increasing order; pieces are the file format's codes (1-6 for pawn to king, plus 8 for black)
+struct _SZPosition
+{
+  int count;
+  int square[SZ_MAX_PIECES];
+  int piece[SZ_MAX_PIECES];
+  //the material on each side, the way table names write it (KQR, KP, ...)
+  char material[2][SZ_MAX_PIECES+1];
+};
+
+//one compressed part of a file; a table has one per side to move (WDL only) and per file of the leading pawn (pawn tables only)
+//values are Huffman coded symbols, each standing for a run of values (recursive pairing), stored in fixed-size blocks
+struct _SZPairs
+{
+  int flags;
+  //the pieces in the order they're indexed, and how they're grouped for that
+  int pieces[SZ_MAX_PIECES];
+  int group_len[SZ_MAX_PIECES+1];
+  unsigned long long group_idx[SZ_MAX_PIECES+1];
+  
+  size_t sizeof_block;
+  size_t span;
+  size_t blocks_num;
+  int max_sym_len;
+  int min_sym_len;
+  //these point into the mapped file (all little-endian there)
+  const unsigned char *lowest_sym;
+  const unsigned char *btree;
+  const unsigned char *sparse_index;
+  size_t sparse_index_size;
+  const unsigned char *block_length;
+  size_t block_length_size;
+  const unsigned char *data;
+  //made when the file's read: the lowest code of each length (left-aligned), and how many values past the first each symbol stands for
+  vector<unsigned long long> base64;
+  vector<int> symlen;
+  
+  //DTZ only; where the value map for each kind of result starts
+  int map_idx[4];
+};
+
+//one .rtbw or .rtbz file; these are mapped the first time they're probed
+struct _SZFile
+{
+  atomic<bool> loaded;
+  const unsigned char *data;
+  size_t data_size;
+  //by side to move (WDL only; a DTZ file just has one) and by file of the leading pawn
+  _SZPairs pairs[2][4];
+  //DTZ only; the values results map to
+  const unsigned char *map;
+};
+
+//one table (a set of material), and the files it has
+struct _SZTable
+{
+  char name[SZ_NAME_SIZE];
+  char dir[PATH_MAX];
+  int piece_count;
+  bool has_pawns;
+  //true if some piece other than a king is the only one of its kind on its side
+  bool unique_pieces;
+  //pawns on the leading side (the one with fewer pawns, when both have some) and on the other side
+  int pawn_count[2];
+  //both sides have the same material (KRvKR), so only white to move is stored
+  bool symmetric;
+  bool has_dtz;
+  
+  _SZFile wdl;
+  _SZFile dtz;
+};
+
+//Syzygy endgame tablebases, the common format other engines use (files like KQvKR.rtbw and KQvKR.rtbz)
+//
+//WDL files say whether a position is won, drawn or lost; DTZ files say how far it is to the next capture or pawn move on the way there
+//so between the two the 50 move rule is taken into account, unlike our own tables, which know distance to mate
+//WDL tables leave out positions where the best move is a capture, so a probe searches captures itself first (and pawn moves too, for DTZ)
+//
+//the search uses WDL probes right after captures and pawn moves (the only times material changes, so anything else was covered the move before)
+//and at the root DTZ is used to pick the move, so a won ending gets converted in time
+//
+//tables are found by name in the given directories when opened, but a file isn't mapped until a position needs it
+//files are memory-mapped and read only, so any number of threads can probe at once; only mapping a file takes a lock
+//positions where castling is still possible aren't covered
+class Syzygy
+{
+private:
+  vector<_SZTable*> tables;
+  map<string, _SZTable*> table_names;
+  int max_pieces;
+  //held while a file is being mapped
+  mutex load_lock;
+  
+  //note a table file found in dir (name is the file name without an extension)
+  void add_table(const char *dir, const char *name, bool dtz);
+  //the table for a position's material (NULL if we don't have one); black_stronger is set when it's found with the colors swapped
+  _SZTable *find_table(const _SZPosition *pos, bool *black_stronger);
+  //map and read a table file, the first time it's needed; false if it can't be used
+  bool load(_SZTable *table, bool dtz);
+  
+  //look up a position in its table; value is the result (WDL) or plies to zero (DTZ, which needs the WDL result)
+  //false if there's no table, or if it's a DTZ table for the other side to move; state says which
+  bool probe_table(const _SZPosition *pos, int player_id, bool dtz, int wdl, int *value, int *state);
+  //the WDL result for a board, searching captures (and pawn moves, if zeroing is true) since the table can't be trusted when those are best
+  int search(Board *board, int player_id, bool zeroing, int *state);
+  //plies to the next capture or pawn move, positive when winning and negative when losing (0 for a draw)
+  int dtz(Board *board, int player_id, int *state);
+
+public:
+  Syzygy();
+  ~Syzygy();
+  
+  //find the tables in a directory (or several, separated by ':'); false (with an error) if there weren't any
+  bool open(const char *paths);
+  void close();
+  bool is_open(){ return !tables.empty(); }
+  //the most pieces any table has
+  int get_max_pieces(){ return max_pieces; }
+  
+  //the WDL result for a board with player_id to move (SZ_LOSS to SZ_WIN); false if it isn't covered
+  bool probe_wdl(Board *board, int player_id, int *wdl);
+  
+  //the move the tables say to play, keeping a win (or putting off a loss) within the 50 move rule (remember to free this later)
+  //NULL if the position isn't covered, or there's no DTZ table for it
+  _Move *root_move(Board *board, int player_id);
+  
+  //check the tables against our own (made with --make-tables, in tb_path) on positions random positions per table of up to 4 pieces;
+  //prints a line per table starting with "syzygy_verify" and a summary, and returns true if everything agreed
+  static bool verify(const char *syzygy_paths, const char *tb_path, int positions);
+};
+
+#endif
+
@@ -0,0 +1,1334 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "Tablebase.h"
+
+//how many ways there are to place the two kings once the board's symmetries are taken out
+#define TB_KING_PAIRS 462
+//and with pawns on the board, where only the left-right mirror is left (the white king on files a-d, the black king anywhere)
+#define TB_PAWN_KING_PAIRS 2048
+//the most moves a position can have (two queens and a king is 62)
+#define TB_MAX_MOVES 80
+//how many positions a thread takes at a time in the first pass
+#define TB_CHUNK_SIZE 4096
+//how many positions a thread takes at a time in later passes (where each one is more work)
+#define TB_WORK_CHUNK_SIZE 256
+
+//every table, in the order they're made (a table needs the ones its captures and promotions go to, so the pawn tables come last)
+//KBK and KNK aren't here since there's no mate in them at all
+static const char *tb_table_names[]={"KQK","KRK","KQQK","KQRK","KQBK","KQNK","KRRK","KRBK","KRNK","KBBK","KBNK","KNNK","KQKQ","KQKR","KQKB","KQKN","KRKR","KRKB","KRKN","KBKB","KBKN","KNKN",
+  "KPK","KQKP","KRKP","KBKP","KNKP","KQPK","KRPK","KBPK","KNPK","KPKP","KPPK"};
+#define TB_TABLE_COUNT 33
+
+//the king index for every placement of the white and black king (-1 if it's not one we index), and back
+static int tb_king_index[64][64];
+static int tb_king_squares[TB_KING_PAIRS][2];
+
+//king and queen directions (rooks use the first 4, bishops the last 4), and knight jumps; as (file, rank) steps
+static const int tb_steps[8][2]={{1,0},{0,1},{-1,0},{0,-1},{1,1},{-1,1},{-1,-1},{1,-1}};
+static const int tb_knight_steps[8][2]={{1,2},{2,1},{2,-1},{1,-2},{-1,-2},{-2,-1},{-2,1},{-1,2}};
+
+//apply one of the 8 board symmetries to a square; bit 0 flips files, bit 1 flips ranks and bit 2 swaps files with ranks (in that order)
+static int tb_transform_square(int square, int transform)
+{
+  int file=square%8;
+  int rank=square/8;
+  if(transform & 1)
+  {
+    file=7-file;
+  }
+  if(transform & 2)
+  {
+    rank=7-rank;
+  }
+  if(transform & 4)
+  {
+    int swap=file;
+    file=rank;
+    rank=swap;
+  }
+  return (rank*8)+file;
+}
+
+//the symmetry that puts the white king in the a1-d1-d4 triangle
+//(and the black king on or below the a1-h8 diagonal when the white king is on it, since then that's the one symmetry left)
+static int tb_king_transform(int white_king, int black_king)
+{
+  int transform=0;
+  if((white_king%8)>3)
+  {
+    transform|=1;
+  }
+  if((white_king/8)>3)
+  {
+    transform|=2;
+  }
+  
+  int wk=tb_transform_square(white_king,transform);
+  int bk=tb_transform_square(black_king,transform);
+  if((wk/8)>(wk%8) || ((wk/8)==(wk%8) && (bk/8)>(bk%8)))
+  {
+    transform|=4;
+  }
+  return transform;
+}
+
+static bool tb_make_king_index()
+{
+  int pairs=0;
+  for(int wk=0; wk<64; wk++)
+  {
+    for(int bk=0; bk<64; bk++)
+    {
+      tb_king_index[wk][bk]=-1;
+      
+      //kings can't touch, and only placements that are already in the triangle get an index
+      if(abs((wk%8)-(bk%8))<=1 && abs((wk/8)-(bk/8))<=1)
+      {
+        continue;
+      }
+      if(tb_king_transform(wk,bk)!=0)
+      {
+        continue;
+      }
+      
+      tb_king_index[wk][bk]=pairs;
+      tb_king_squares[pairs][0]=wk;
+      tb_king_squares[pairs][1]=bk;
+      pairs++;
+    }
+  }
+  return (pairs==TB_KING_PAIRS);
+}
+static bool tb_king_index_made=tb_make_king_index();
+
+//the order pieces go in within a table's name and index
+static int tb_type_order(int type)
+{
+  switch(type)
+  {
+    case 'Q':
+      return 0;
+    case 'R':
+      return 1;
+    case 'B':
+      return 2;
+    case 'N':
+      return 3;
+    case 'P':
+      return 4;
+  }
+  return 5;
+}
+
+//whether there are any pawns (which leaves just the one symmetry)
+static bool tb_has_pawns(const _TBPosition *pos)
+{
+  for(int i=2; i<pos->count; i++)
+  {
+    if(pos->type[i]=='P')
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//the king placements times 64 to the power of how many pieces there are besides the kings
+static size_t tb_table_size(int extra_count, bool pawns)
+{
+  size_t size=pawns? TB_PAWN_KING_PAIRS : TB_KING_PAIRS;
+  for(int i=0; i<extra_count; i++)
+  {
+    size*=64;
+  }
+  return size;
+}
+
+//the index of a position with a given symmetry applied; -1 if the kings are touching
+static long long tb_index_with(const _TBPosition *pos, bool flip, int transform)
+{
+  int kings[2];
+  for(int color=0; color<2; color++)
+  {
+    kings[color]=tb_transform_square(flip? (pos->square[1-color]^56) : pos->square[color],transform);
+  }
+  int king_index=tb_king_index[kings[0]][kings[1]];
+  if(tb_has_pawns(pos))
+  {
+    //the white king is on files a-d here, so that's 32 squares for it
+    king_index=(abs((kings[0]%8)-(kings[1]%8))<=1 && abs((kings[0]/8)-(kings[1]/8))<=1)? -1 : (((((kings[0]/8)*4)+(kings[0]%8))*64)+kings[1]);
+  }
+  if(king_index<0)
+  {
+    return -1;
+  }
+  
+  //a sort key and square for every other piece; insertion sort since there are at most 2
+  int keys[TB_MAX_PIECES];
+  int squares[TB_MAX_PIECES];
+  int extra_count=0;
+  for(int i=2; i<pos->count; i++)
+  {
+    int color=flip? (1-pos->color[i]) : pos->color[i];
+    int square=tb_transform_square(flip? (pos->square[i]^56) : pos->square[i],transform);
+    int key=(color*8)+tb_type_order(pos->type[i]);
+    
+    int n=extra_count;
+    while(n>0 && (keys[n-1]>key || (keys[n-1]==key && squares[n-1]>square)))
+    {
+      keys[n]=keys[n-1];
+      squares[n]=squares[n-1];
+      n--;
+    }
+    keys[n]=key;
+    squares[n]=square;
+    extra_count++;
+  }
+  
+  long long index=king_index;
+  for(int i=0; i<extra_count; i++)
+  {
+    index=(index*64)+squares[i];
+  }
+  return index;
+}
+
+//the index of a position in its table; -1 if the kings are touching or two pieces are on one square
+//flip reads the position with the colors swapped and the board upside down (for a table that has the stronger side as white)
+//the other pieces go white's first, in name order, with identical pieces by square
+//with both kings on the a1-h8 diagonal, flipping over it gives another index for the same position; the lower one is used
+//so every position has just one index (which matters, since positions are found from each other's indices)
+//with pawns, the board is only ever mirrored left to right, to put the white king on files a-d
+static long long tb_index(const _TBPosition *pos, bool flip)
+{
+  //no sharing squares
+  for(int i=0; i<pos->count; i++)
+  {
+    for(int j=i+1; j<pos->count; j++)
+    {
+      if(pos->square[i]==pos->square[j])
+      {
+        return -1;
+      }
+    }
+  }
+  
+  int kings[2];
+  for(int color=0; color<2; color++)
+  {
+    kings[color]=flip? (pos->square[1-color]^56) : pos->square[color];
+  }
+  if(tb_has_pawns(pos))
+  {
+    return tb_index_with(pos,flip,((kings[0]%8)>3)? 1 : 0);
+  }
+  int transform=tb_king_transform(kings[0],kings[1]);
+  long long index=tb_index_with(pos,flip,transform);
+  
+  int wk=tb_transform_square(kings[0],transform);
+  int bk=tb_transform_square(kings[1],transform);
+  if(index>=0 && (wk/8)==(wk%8) && (bk/8)==(bk%8))
+  {
+    long long mirrored=tb_index_with(pos,flip,transform^4);
+    if(mirrored<index)
+    {
+      index=mirrored;
+    }
+  }
+  return index;
+}
+
+//the piece on a square (-1 for none)
+static int tb_piece_at(const _TBPosition *pos, int square)
+{
+  for(int i=0; i<pos->count; i++)
+  {
+    if(pos->square[i]==square)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+//whether piece i attacks a square (whatever is on that square)
+static bool tb_attacks(const _TBPosition *pos, int i, int square)
+{
+  int file_diff=(square%8)-(pos->square[i]%8);
+  int rank_diff=(square/8)-(pos->square[i]/8);
+  int file_dist=abs(file_diff);
+  int rank_dist=abs(rank_diff);
+  if(file_dist==0 && rank_dist==0)
+  {
+    return false;
+  }
+  
+  switch(pos->type[i])
+  {
+    case 'K':
+      return (file_dist<=1 && rank_dist<=1);
+    case 'P':
+      return (file_dist==1 && rank_diff==((pos->color[i]==WHITE)? 1 : -1));
+    case 'N':
+      return ((file_dist*rank_dist)==2);
+    case 'R':
+      if(file_dist!=0 && rank_dist!=0)
+      {
+        return false;
+      }
+      break;
+    case 'B':
+      if(file_dist!=rank_dist)
+      {
+        return false;
+      }
+      break;
+    case 'Q':
+      if(file_dist!=0 && rank_dist!=0 && file_dist!=rank_dist)
+      {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  
+  //sliders can't go through anything
+  int step=(((rank_diff>0)-(rank_diff<0))*8)+((file_diff>0)-(file_diff<0));
+  for(int s=pos->square[i]+step; s!=square; s+=step)
+  {
+    if(tb_piece_at(pos,s)>=0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//whether color's king is attacked
+static bool tb_in_check(const _TBPosition *pos, int color)
+{
+  for(int i=0; i<pos->count; i++)
+  {
+    if(pos->color[i]!=color && tb_attacks(pos,i,pos->square[color]))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//the steps a piece moves by, and whether it keeps going in each direction
+static const int (*tb_piece_steps(int type, int *first, int *last, bool *slides))[2]
+{
+  *first=(type=='B')? 4 : 0;
+  *last=(type=='R')? 4 : 8;
+  *slides=(type=='Q' || type=='R' || type=='B');
+  return (type=='N')? tb_knight_steps : tb_steps;
+}
+
+//take piece n off the board; the kings are never taken, so they stay at 0 and 1
+static void tb_remove(_TBPosition *pos, int n)
+{
+  for(; n<pos->count-1; n++)
+  {
+    pos->square[n]=pos->square[n+1];
+    pos->type[n]=pos->type[n+1];
+    pos->color[n]=pos->color[n+1];
+  }
+  pos->count--;
+}
+
+//the pawn moves for piece i (color's), added to children from count on; returns the new count
+//a promotion goes to another table just like a capture does, so it counts as one
+static int tb_pawn_children(const _TBPosition *pos, int i, int color, _TBPosition *children, bool *captures, int count)
+{
+  int forward=(color==WHITE)? 8 : -8;
+  int ahead=pos->square[i]+forward;
+  
+  //one square ahead, two from the starting rank, and diagonally ahead to take something
+  int targets[4];
+  int target_count=0;
+  if(tb_piece_at(pos,ahead)<0)
+  {
+    targets[target_count++]=ahead;
+    if((pos->square[i]/8)==((color==WHITE)? 1 : 6) && tb_piece_at(pos,ahead+forward)<0)
+    {
+      targets[target_count++]=ahead+forward;
+    }
+  }
+  for(int side=-1; side<=1; side+=2)
+  {
+    int file=(ahead%8)+side;
+    int target=(file<0 || file>7)? -1 : tb_piece_at(pos,ahead+side);
+    if(target>=0 && pos->color[target]!=color && pos->type[target]!='K')
+    {
+      targets[target_count++]=ahead+side;
+    }
+  }
+  
+  for(int t=0; t<target_count; t++)
+  {
+    int square=targets[t];
+    int target=tb_piece_at(pos,square);
+    const char *promotions=((square/8)==((color==WHITE)? 7 : 0))? "QRBN" : "P";
+    for(const char *type=promotions; *type!='\0'; type++)
+    {
+      _TBPosition *child=&(children[count]);
+      *child=*pos;
+      child->square[i]=square;
+      child->type[i]=*type;
+      child->ep_square=-1;
+      if(target>=0)
+      {
+        tb_remove(child,target);
+      }
+      
+      //after two squares, the other side might be able to take en passant
+      if(abs(square-pos->square[i])==16)
+      {
+        for(int side=-1; side<=1; side+=2)
+        {
+          int file=(square%8)+side;
+          int beside=(file<0 || file>7)? -1 : tb_piece_at(pos,square+side);
+          if(beside>=0 && pos->color[beside]!=color && pos->type[beside]=='P')
+          {
+            child->ep_square=ahead;
+          }
+        }
+      }
+      
+      if(!tb_in_check(child,color))
+      {
+        captures[count]=(target>=0 || *type!='P');
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+//every legal move for color; children gets the position after each one and captures whether it took something (or promoted)
+//en passant isn't one of them; positions right after a pawn moved two squares have ep_square set for that instead
+//returns how many there are
+static int tb_children(const _TBPosition *pos, int color, _TBPosition *children, bool *captures)
+{
+  int count=0;
+  for(int i=0; i<pos->count; i++)
+  {
+    if(pos->color[i]!=color)
+    {
+      continue;
+    }
+    if(pos->type[i]=='P')
+    {
+      count=tb_pawn_children(pos,i,color,children,captures,count);
+      continue;
+    }
+    
+    int first;
+    int last;
+    bool slides;
+    const int (*steps)[2]=tb_piece_steps(pos->type[i],&first,&last,&slides);
+    for(int d=first; d<last; d++)
+    {
+      int file=pos->square[i]%8;
+      int rank=pos->square[i]/8;
+      while(true)
+      {
+        file+=steps[d][0];
+        rank+=steps[d][1];
+        if(file<0 || file>7 || rank<0 || rank>7)
+        {
+          break;
+        }
+        
+        int square=(rank*8)+file;
+        int target=tb_piece_at(pos,square);
+        if(target>=0 && (pos->color[target]==color || pos->type[target]=='K'))
+        {
+          break;
+        }
+        
+        _TBPosition *child=&(children[count]);
+        *child=*pos;
+        child->square[i]=square;
+        child->ep_square=-1;
+        if(target>=0)
+        {
+          tb_remove(child,target);
+        }
+        
+        if(!tb_in_check(child,color))
+        {
+          captures[count]=(target>=0);
+          count++;
+        }
+        
+        if(target>=0 || !slides)
+        {
+          break;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+//every position color could have moved from (without a capture or a promotion) to get to pos; color is to move in all of them
+//double_steps is whether that move was a pawn going two squares (which en passant makes different from other moves)
+//returns how many there are
+static int tb_parents(const _TBPosition *pos, int color, _TBPosition *parents, bool *double_steps)
+{
+  int count=0;
+  for(int i=0; i<pos->count; i++)
+  {
+    if(pos->color[i]!=color)
+    {
+      continue;
+    }
+    
+    //pawns come back one square, or two to their starting rank, and never from the first or last rank
+    if(pos->type[i]=='P')
+    {
+      int back=(color==WHITE)? -8 : 8;
+      int square=pos->square[i];
+      for(int n=1; n<=2; n++)
+      {
+        square+=back;
+        if((square/8)==0 || (square/8)==7 || tb_piece_at(pos,square)>=0 || (n==2 && (square/8)!=((color==WHITE)? 1 : 6)))
+        {
+          break;
+        }
+        
+        _TBPosition *parent=&(parents[count]);
+        *parent=*pos;
+        parent->square[i]=square;
+        if(!tb_in_check(parent,1-color))
+        {
+          double_steps[count]=(n==2);
+          count++;
+        }
+      }
+      continue;
+    }
+    
+    //every other piece moves the same way backwards as forwards
+    int first;
+    int last;
+    bool slides;
+    const int (*steps)[2]=tb_piece_steps(pos->type[i],&first,&last,&slides);
+    for(int d=first; d<last; d++)
+    {
+      int file=pos->square[i]%8;
+      int rank=pos->square[i]/8;
+      while(true)
+      {
+        file+=steps[d][0];
+        rank+=steps[d][1];
+        if(file<0 || file>7 || rank<0 || rank>7)
+        {
+          break;
+        }
+        
+        int square=(rank*8)+file;
+        if(tb_piece_at(pos,square)>=0)
+        {
+          break;
+        }
+        
+        _TBPosition *parent=&(parents[count]);
+        *parent=*pos;
+        parent->square[i]=square;
+        //the other side can't be left in check with color to move
+        if(!tb_in_check(parent,1-color))
+        {
+          double_steps[count]=false;
+          count++;
+        }
+        
+        if(!slides)
+        {
+          break;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+//helpers for table values
+static bool tb_is_win(unsigned char value)
+{
+  return (value>TB_DRAW && value<TB_LOSS);
+}
+
+static bool tb_is_loss(unsigned char value)
+{
+  return (value>=TB_LOSS && value!=TB_ILLEGAL);
+}
+
+//how many plies to mate a win or loss is
+static int tb_plies(unsigned char value)
+{
+  return (value<TB_LOSS)? ((value*2)-1) : ((value-TB_LOSS)*2);
+}
+
+//the value of a move for the side making it, from the value of the position after it
+static unsigned char tb_after_move(unsigned char value)
+{
+  if(tb_is_loss(value))
+  {
+    return (tb_plies(value)+2)/2;
+  }
+  if(tb_is_win(value))
+  {
+    return TB_LOSS+((tb_plies(value)+1)/2);
+  }
+  return TB_DRAW;
+}
+
+//the better of two values for the side to move; a quicker win, then a draw, then a slower loss (TB_ILLEGAL is no value at all)
+static unsigned char tb_better(unsigned char a, unsigned char b)
+{
+  if(a==TB_ILLEGAL || b==TB_ILLEGAL)
+  {
+    return (a==TB_ILLEGAL)? b : a;
+  }
+  int scores[2];
+  unsigned char values[2]={a,b};
+  for(int i=0; i<2; i++)
+  {
+    scores[i]=tb_is_win(values[i])? (1000-tb_plies(values[i])) : tb_is_loss(values[i])? (tb_plies(values[i])-1000) : 0;
+  }
+  return (scores[0]>=scores[1])? a : b;
+}
+
+//the best color (to move) can do by taking en passant, with pos->ep_square set; TB_ILLEGAL if it can't
+//the capture leaves a position with fewer pieces, so it's looked up in tables that are already made
+static unsigned char tb_ep_value(Tablebase *tables, const _TBPosition *pos, int color)
+{
+  //the pawn that moved two squares is just past the square it went over
+  int pawn=tb_piece_at(pos,pos->ep_square+((color==WHITE)? -8 : 8));
+  unsigned char best=TB_ILLEGAL;
+  if(pawn<0)
+  {
+    return best;
+  }
+  
+  for(int side=-1; side<=1; side+=2)
+  {
+    int file=(pos->square[pawn]%8)+side;
+    int taker=(file<0 || file>7)? -1 : tb_piece_at(pos,pos->square[pawn]+side);
+    if(taker<0 || pos->color[taker]!=color || pos->type[taker]!='P')
+    {
+      continue;
+    }
+    
+    _TBPosition after=*pos;
+    after.square[taker]=pos->ep_square;
+    after.ep_square=-1;
+    tb_remove(&after,pawn);
+    unsigned char value;
+    if(!tb_in_check(&after,color) && tables->lookup(&after,1-color,&value) && value!=TB_ILLEGAL)
+    {
+      best=tb_better(best,tb_after_move(value));
+    }
+  }
+  return best;
+}
+
+Tablebase::Tablebase()
+{
+}
+
+Tablebase::~Tablebase()
+{
+  close();
+}
+
+//map one table file; false if it isn't there or isn't the right size
+bool Tablebase::open_table(const char *path, const char *name)
+{
+  char fname[PATH_MAX];
+  snprintf(fname,PATH_MAX,"%s/%s%s",path,name,TB_EXTENSION);
+  int fd=::open(fname,O_RDONLY);
+  if(fd<0)
+  {
+    return false;
+  }
+  
+  _TBTable table;
+  strncpy(table.name,name,TB_NAME_SIZE-1);
+  table.name[TB_NAME_SIZE-1]='\0';
+  table.extra_count=strlen(name)-2;
+  table.size=tb_table_size(table.extra_count,strchr(name,'P')!=NULL);
+  
+  struct stat file_stat;
+  if(fstat(fd,&file_stat)<0 || (size_t)(file_stat.st_size)!=(table.size*2))
+  {
+    fprintf(stderr,"Warn: %s is the wrong size for a table; it won't be used\n",fname);
+    ::close(fd);
+    return false;
+  }
+  
+  void *mapped=mmap(NULL,file_stat.st_size,PROT_READ,MAP_SHARED,fd,0);
+  ::close(fd);
+  if(mapped==MAP_FAILED)
+  {
+    fprintf(stderr,"Warn: Could not map table %s\n",fname);
+    return false;
+  }
+  
+  table.data=(const unsigned char*)(mapped);
+  table.data_size=file_stat.st_size;
+  tables.push_back(table);
+  return true;
+}
+
+//the table for a material name (NULL if we don't have one)
+_TBTable *Tablebase::find_table(const char *name)
+{
+  for(size_t i=0; i<tables.size(); i++)
+  {
+    if(!strcmp(tables[i].name,name))
+    {
+      return &(tables[i]);
+    }
+  }
+  return NULL;
+}
+
+//map every table file in a directory
+bool Tablebase::open(const char *path)
+{
+  close();
+  for(int i=0; i<TB_TABLE_COUNT; i++)
+  {
+    open_table(path,tb_table_names[i]);
+  }
+  
+  if(tables.empty())
+  {
+    fprintf(stderr,"Err: No tablebase files in %s\n",path);
+    return false;
+  }
+  return true;
+}
+
+void Tablebase::close()
+{
+  for(size_t i=0; i<tables.size(); i++)
+  {
+    munmap((void*)(tables[i].data),tables[i].data_size);
+  }
+  tables.clear();
+}
+
+//look up a position with player_id to move
+bool Tablebase::lookup(const _TBPosition *pos, int player_id, unsigned char *value)
+{
+  //each side's pieces other than the king, in name order
+  char material[2][TB_MAX_PIECES+1];
+  int material_count[2]={0,0};
+  for(int i=2; i<pos->count; i++)
+  {
+    char *side=material[pos->color[i]];
+    int n=material_count[pos->color[i]];
+    while(n>0 && tb_type_order(side[n-1])>tb_type_order(pos->type[i]))
+    {
+      side[n]=side[n-1];
+      n--;
+    }
+    side[n]=pos->type[i];
+    material_count[pos->color[i]]++;
+  }
+  material[WHITE][material_count[WHITE]]='\0';
+  material[BLACK][material_count[BLACK]]='\0';
+  
+  //there's no mate at all with bare kings or a single minor piece
+  int extra_count=pos->count-2;
+  if(extra_count==0 || (extra_count==1 && (pos->type[2]=='B' || pos->type[2]=='N')))
+  {
+    *value=TB_DRAW;
+    return true;
+  }
+  
+  //tables have the stronger side as white; if black has the pieces for this one, flip the board
+  char name[TB_NAME_SIZE];
+  snprintf(name,TB_NAME_SIZE,"K%sK%s",material[WHITE],material[BLACK]);
+  bool flip=false;
+  _TBTable *table=find_table(name);
+  if(table==NULL)
+  {
+    snprintf(name,TB_NAME_SIZE,"K%sK%s",material[BLACK],material[WHITE]);
+    flip=true;
+    table=find_table(name);
+  }
+  if(table==NULL)
+  {
+    return false;
+  }
+  
+  long long index=tb_index(pos,flip);
+  if(index<0)
+  {
+    return false;
+  }
+  int side=flip? (1-player_id) : player_id;
+  *value=table->data[(side*table->size)+index];
+  return true;
+}
+
+//look up a board with player_id to move
+bool Tablebase::probe(Board *board, int player_id, int *result, int *plies)
+{
+  if(tables.empty())
+  {
+    return false;
+  }
+  
+  _TBPosition pos;
+  pos.count=2;
+  pos.ep_square=-1;
+  bool kings[2]={false,false};
+  //unmoved kings and rooks on their home squares, which could still castle
+  bool home_kings[2]={false,false};
+  bool home_rooks[2]={false,false};
+  for(int rank=1; rank<=8; rank++)
+  {
+    for(int file=1; file<=8; file++)
+    {
+      _SuperPiece *piece=board->get_element(file,rank);
+      if(piece==NULL)
+      {
+        continue;
+      }
+      
+      int home_rank=(piece->owner==WHITE)? 1 : 8;
+      int i;
+      if(piece->type=='K')
+      {
+        i=piece->owner;
+        kings[piece->owner]=true;
+        home_kings[piece->owner]=(piece->movements==0 && rank==home_rank);
+      }
+      else
+      {
+        if(pos.count>=TB_MAX_PIECES)
+        {
+          return false;
+        }
+        i=pos.count;
+        pos.count++;
+        if(piece->type=='R' && piece->movements==0 && rank==home_rank && (file==1 || file==8))
+        {
+          home_rooks[piece->owner]=true;
+        }
+      }
+      pos.square[i]=((rank-1)*8)+(file-1);
+      pos.type[i]=piece->type;
+      pos.color[i]=piece->owner;
+    }
+  }
+  if(!kings[WHITE] || !kings[BLACK] || (home_kings[WHITE] && home_rooks[WHITE]) || (home_kings[BLACK] && home_rooks[BLACK]))
+  {
+    return false;
+  }
+  
+  //a pawn that just moved two squares can be taken en passant, which the tables don't have as a move
+  _SuperPiece *last_moved=board->get_last_moved();
+  if(last_moved!=NULL && last_moved->type=='P' && last_moved->owner!=player_id && last_moved->movements==1 && last_moved->rank==((last_moved->owner==WHITE)? 4 : 5))
+  {
+    pos.ep_square=((last_moved->rank-1)*8)+(last_moved->file-1)+((last_moved->owner==WHITE)? -8 : 8);
+  }
+  
+  unsigned char value;
+  if(!lookup(&pos,player_id,&value) || value==TB_ILLEGAL)
+  {
+    return false;
+  }
+  if(pos.ep_square>=0)
+  {
+    value=tb_better(value,tb_ep_value(this,&pos,player_id));
+  }
+  
+  *result=tb_is_win(value)? 1 : tb_is_loss(value)? -1 : 0;
+  *plies=(value==TB_DRAW)? 0 : tb_plies(value);
+  return true;
+}
+
+//everything the threads making one table share
+struct _TBGen
+{
+  //the tables that are already made (for positions after a capture or promotion)
+  Tablebase *made;
+  
+  //the table being made; the pieces besides the kings in index order, and the values for both sides to move (an entry is side*size+index)
+  bool pawns;
+  int extra_count;
+  int extra_type[TB_MAX_PIECES];
+  int extra_color[TB_MAX_PIECES];
+  size_t size;
+  atomic<unsigned char> *values;
+  
+  //how far mate is for positions found in this pass
+  int plies;
+  //this pass's work: positions found last pass (whose parents are looked at), and positions that are looked at themselves
+  //next_work counts through both, one after the other
+  vector<size_t> parents_of;
+  vector<size_t> recheck;
+  atomic<size_t> next_work;
+  
+  //positions found this pass, and positions to look at again in a later pass (by the pass), from all threads
+  vector<size_t> found;
+  map<int, vector<size_t> > later;
+  mutex lock;
+};
+
+//the position for an index in the table being made
+static void tb_decode(_TBGen *gen, size_t index, _TBPosition *pos)
+{
+  pos->count=gen->extra_count+2;
+  for(int i=gen->extra_count-1; i>=0; i--)
+  {
+    pos->square[i+2]=index%64;
+    pos->type[i+2]=gen->extra_type[i];
+    pos->color[i+2]=gen->extra_color[i];
+    index/=64;
+  }
+  for(int color=0; color<2; color++)
+  {
+    if(gen->pawns)
+    {
+      //the white king's 32 squares are files a-d
+      pos->square[color]=(color==WHITE)? (((index/256)*8)+((index/64)%4)) : (index%64);
+    }
+    else
+    {
+      pos->square[color]=tb_king_squares[index][color];
+    }
+    pos->type[color]='K';
+    pos->color[color]=color;
+  }
+  pos->ep_square=-1;
+}
+
+//the value of a position after a move, with color to move
+static unsigned char tb_child_value(_TBGen *gen, const _TBPosition *child, int color, bool capture)
+{
+  //captures and promotions go to tables that are already made
+  if(capture)
+  {
+    unsigned char value;
+    return gen->made->lookup(child,color,&value)? value : TB_DRAW;
+  }
+  
+  long long index=tb_index(child,false);
+  if(index<0)
+  {
+    return TB_ILLEGAL;
+  }
+  unsigned char value=gen->values[(color*gen->size)+index].load(memory_order_relaxed);
+  
+  //after a pawn moves two squares, taking it en passant is one more move to choose from
+  if(child->ep_square>=0)
+  {
+    value=tb_better(value,tb_ep_value(gen->made,child,color));
+  }
+  return value;
+}
+
+//whether every move color has leads to a win for the other side; max_plies is set to the longest of those
+//(false with no moves at all; mates and stalemates are found in the first pass)
+static bool tb_all_lose(_TBGen *gen, const _TBPosition *pos, int color, int *max_plies)
+{
+  _TBPosition children[TB_MAX_MOVES];
+  bool captures[TB_MAX_MOVES];
+  int count=tb_children(pos,color,children,captures);
+  if(count==0)
+  {
+    return false;
+  }
+  
+  *max_plies=0;
+  for(int i=0; i<count; i++)
+  {
+    unsigned char value=tb_child_value(gen,&(children[i]),1-color,captures[i]);
+    if(!tb_is_win(value))
+    {
+      return false;
+    }
+    if(tb_plies(value)>*max_plies)
+    {
+      *max_plies=tb_plies(value);
+    }
+  }
+  return true;
+}
+
+//the first pass; marks positions that can't happen, finds every checkmate, and finds what captures lead to
+static void tb_first_pass(_TBGen *gen)
+{
+  vector<size_t> found;
+  map<int, vector<size_t> > later;
+  _TBPosition children[TB_MAX_MOVES];
+  bool captures[TB_MAX_MOVES];
+  
+  size_t total=gen->size*2;
+  for(size_t start=gen->next_work.fetch_add(TB_CHUNK_SIZE); start<total; start=gen->next_work.fetch_add(TB_CHUNK_SIZE))
+  {
+    size_t end=(start+TB_CHUNK_SIZE<total)? (start+TB_CHUNK_SIZE) : total;
+    for(size_t entry=start; entry<end; entry++)
+    {
+      int color=entry/gen->size;
+      size_t index=entry%gen->size;
+      _TBPosition pos;
+      tb_decode(gen,index,&pos);
+      
+      //pieces sharing squares, the side that just moved still in check, and identical pieces the other way around (which have another index) don't count
+      //and neither do pawns on the first or last rank
+      bool pawns_placed=true;
+      for(int i=2; i<pos.count; i++)
+      {
+        pawns_placed=pawns_placed && !(pos.type[i]=='P' && ((pos.square[i]/8)==0 || (pos.square[i]/8)==7));
+      }
+      if(!pawns_placed || tb_index(&pos,false)!=(long long)(index) || tb_in_check(&pos,1-color))
+      {
+        gen->values[entry].store(TB_ILLEGAL,memory_order_relaxed);
+        continue;
+      }
+      
+      int count=tb_children(&pos,color,children,captures);
+      if(count==0)
+      {
+        if(tb_in_check(&pos,color))
+        {
+          gen->values[entry].store(TB_LOSS,memory_order_relaxed);
+          found.push_back(entry);
+        }
+        continue;
+      }
+      
+      //what captures (and promotions) lead to is already known, so a win by capture (or a loss with nothing but captures) is known now
+      //it's still only set in the pass for its distance, since a quiet move might mate sooner
+      //a pawn moving two squares into an en passant capture that wins for the other side is known to lose now too
+      int win_plies=-1;
+      int loss_plies=0;
+      bool all_captures=true;
+      bool all_lose=true;
+      for(int i=0; i<count; i++)
+      {
+        unsigned char value=TB_ILLEGAL;
+        if(captures[i])
+        {
+          value=tb_child_value(gen,&(children[i]),1-color,true);
+        }
+        else if(children[i].ep_square>=0)
+        {
+          value=tb_ep_value(gen->made,&(children[i]),1-color);
+        }
+        if(!captures[i] && !tb_is_win(value))
+        {
+          all_captures=false;
+          continue;
+        }
+        
+        if(tb_is_loss(value))
+        {
+          if(win_plies<0 || tb_plies(value)+1<win_plies)
+          {
+            win_plies=tb_plies(value)+1;
+          }
+        }
+        else if(tb_is_win(value))
+        {
+          if(tb_plies(value)+1>loss_plies)
+          {
+            loss_plies=tb_plies(value)+1;
+          }
+        }
+        else
+        {
+          all_lose=false;
+        }
+      }
+      
+      if(win_plies>0)
+      {
+        later[win_plies].push_back(entry);
+      }
+      else if(all_captures && all_lose)
+      {
+        later[loss_plies].push_back(entry);
+      }
+    }
+  }
+  
+  gen->lock.lock();
+  gen->found.insert(gen->found.end(),found.begin(),found.end());
+  for(map<int, vector<size_t> >::iterator i=later.begin(); i!=later.end(); i++)
+  {
+    gen->later[(*i).first].insert(gen->later[(*i).first].end(),(*i).second.begin(),(*i).second.end());
+  }
+  gen->lock.unlock();
+}
+
+//see if a position is a win or loss at this pass's distance; it's a candidate because of a child found last pass, or because of a capture
+//double_step is whether the move to that child was a pawn going two squares
+static void tb_try(_TBGen *gen, size_t entry, const _TBPosition *pos, int color, bool double_step, vector<size_t> *found, map<int, vector<size_t> > *later)
+{
+  if(gen->values[entry].load(memory_order_relaxed)!=TB_DRAW)
+  {
+    return;
+  }
+  
+  //wins are at odd distances and losses at even ones
+  //a candidate win already has a move to a loss at the last pass's distance, but a loss needs every move checked
+  bool win=((gen->plies%2)==1);
+  if(win && double_step)
+  {
+    //unless that move was two squares with a pawn, since an en passant capture might be better for the other side; find the quickest win there is
+    _TBPosition children[TB_MAX_MOVES];
+    bool captures[TB_MAX_MOVES];
+    int count=tb_children(pos,color,children,captures);
+    int win_plies=-1;
+    for(int i=0; i<count; i++)
+    {
+      unsigned char value=tb_child_value(gen,&(children[i]),1-color,captures[i]);
+      if(tb_is_loss(value) && (win_plies<0 || tb_plies(value)+1<win_plies))
+      {
+        win_plies=tb_plies(value)+1;
+      }
+    }
+    if(win_plies<0)
+    {
+      return;
+    }
+    if(win_plies>gen->plies)
+    {
+      (*later)[win_plies].push_back(entry);
+      return;
+    }
+  }
+  else if(!win)
+  {
+    int max_plies;
+    if(!tb_all_lose(gen,pos,color,&max_plies))
+    {
+      return;
+    }
+    
+    //a capture can lead to a longer mate than anything found yet; wait for that
+    if(max_plies+1>gen->plies)
+    {
+      (*later)[max_plies+1].push_back(entry);
+      return;
+    }
+  }
+  
+  unsigned char value=win? ((gen->plies+1)/2) : (TB_LOSS+(gen->plies/2));
+  unsigned char expected=TB_DRAW;
+  if(gen->values[entry].compare_exchange_strong(expected,value,memory_order_relaxed))
+  {
+    found->push_back(entry);
+  }
+}
+
+//every pass after the first; finds the positions that are mate in exactly gen->plies plies
+static void tb_pass(_TBGen *gen)
+{
+  vector<size_t> found;
+  map<int, vector<size_t> > later;
+  _TBPosition parents[TB_MAX_MOVES];
+  bool double_steps[TB_MAX_MOVES];
+  
+  size_t total=gen->parents_of.size()+gen->recheck.size();
+  for(size_t start=gen->next_work.fetch_add(TB_WORK_CHUNK_SIZE); start<total; start=gen->next_work.fetch_add(TB_WORK_CHUNK_SIZE))
+  {
+    size_t end=(start+TB_WORK_CHUNK_SIZE<total)? (start+TB_WORK_CHUNK_SIZE) : total;
+    for(size_t work=start; work<end; work++)
+    {
+      if(work>=gen->parents_of.size())
+      {
+        size_t entry=gen->recheck[work-gen->parents_of.size()];
+        _TBPosition pos;
+        tb_decode(gen,entry%gen->size,&pos);
+        tb_try(gen,entry,&pos,entry/gen->size,false,&found,&later);
+        continue;
+      }
+      
+      //a position found last pass; whoever moved into it may have done that on purpose
+      size_t entry=gen->parents_of[work];
+      int color=entry/gen->size;
+      _TBPosition pos;
+      tb_decode(gen,entry%gen->size,&pos);
+      
+      int count=tb_parents(&pos,1-color,parents,double_steps);
+      for(int i=0; i<count; i++)
+      {
+        long long index=tb_index(&(parents[i]),false);
+        if(index>=0)
+        {
+          tb_try(gen,((1-color)*gen->size)+index,&(parents[i]),1-color,double_steps[i],&found,&later);
+        }
+      }
+    }
+  }
+  
+  gen->lock.lock();
+  gen->found.insert(gen->found.end(),found.begin(),found.end());
+  for(map<int, vector<size_t> >::iterator i=later.begin(); i!=later.end(); i++)
+  {
+    gen->later[(*i).first].insert(gen->later[(*i).first].end(),(*i).second.begin(),(*i).second.end());
+  }
+  gen->lock.unlock();
+}
+
+//run one pass on every thread
+static void tb_run_pass(_TBGen *gen, void (*pass)(_TBGen*), unsigned int thread_count)
+{
+  gen->next_work.store(0);
+  vector<thread> workers;
+  for(unsigned int i=0; i<thread_count; i++)
+  {
+    workers.push_back(thread(pass,gen));
+  }
+  for(unsigned int i=0; i<thread_count; i++)
+  {
+    workers[i].join();
+  }
+}
+
+//make every table
+//this is retrograde analysis: find every checkmate, then every position that can move into one (mate in 1), then every position that can only move into those (mated in 1), and so on
+//each pass only looks at the parents of what the last pass found, so a table takes a few passes over its positions rather than one per move of the longest mate
+bool Tablebase::generate(const char *path, unsigned int thread_count)
+{
+  //one thread per core unless told otherwise
+  if(thread_count==0)
+  {
+    thread_count=thread::hardware_concurrency();
+    if(thread_count==0)
+    {
+      thread_count=1;
+    }
+  }
+  
+  Tablebase made;
+  for(int t=0; t<TB_TABLE_COUNT; t++)
+  {
+    const char *name=tb_table_names[t];
+    chrono::steady_clock::time_point start_time=chrono::steady_clock::now();
+    
+    _TBGen gen;
+    gen.made=&made;
+    gen.extra_count=0;
+    for(int i=1, color=WHITE; name[i]!='\0'; i++)
+    {
+      if(name[i]=='K')
+      {
+        color=BLACK;
+        continue;
+      }
+      gen.extra_type[gen.extra_count]=name[i];
+      gen.extra_color[gen.extra_count]=color;
+      gen.extra_count++;
+    }
+    gen.pawns=(strchr(name,'P')!=NULL);
+    gen.size=tb_table_size(gen.extra_count,gen.pawns);
+    gen.values=new atomic<unsigned char>[gen.size*2];
+    for(size_t i=0; i<gen.size*2; i++)
+    {
+      gen.values[i].store(TB_DRAW,memory_order_relaxed);
+    }
+    
+    gen.plies=0;
+    tb_run_pass(&gen,tb_first_pass,thread_count);
+    
+    while(!gen.found.empty() || !gen.later.empty())
+    {
+      gen.plies++;
+      gen.parents_of.swap(gen.found);
+      gen.found.clear();
+      gen.recheck.clear();
+      if(gen.later.count(gen.plies)>0)
+      {
+        gen.recheck.swap(gen.later[gen.plies]);
+        gen.later.erase(gen.plies);
+      }
+      tb_run_pass(&gen,tb_pass,thread_count);
+      
+      //there's no room for more in a byte (and nothing with this few pieces comes close)
+      if(gen.plies>=252)
+      {
+        fprintf(stderr,"Err: Mates in table %s are too long to store\n",name);
+        delete[] gen.values;
+        return false;
+      }
+    }
+    
+    //write it out
+    unsigned char *data=(unsigned char*)(malloc(gen.size*2));
+    if(data==NULL)
+    {
+      fprintf(stderr,"Err: Out of RAM!? (malloc failed)\n");
+      exit(1);
+    }
+    size_t wins=0;
+    size_t losses=0;
+    size_t draws=0;
+    int longest=0;
+    for(size_t i=0; i<gen.size*2; i++)
+    {
+      data[i]=gen.values[i].load(memory_order_relaxed);
+      if(tb_is_win(data[i]))
+      {
+        wins++;
+        longest=(tb_plies(data[i])>longest)? tb_plies(data[i]) : longest;
+      }
+      else if(tb_is_loss(data[i]))
+      {
+        losses++;
+      }
+      else if(data[i]==TB_DRAW)
+      {
+        draws++;
+      }
+    }
+    delete[] gen.values;
+    
+    char fname[PATH_MAX];
+    snprintf(fname,PATH_MAX,"%s/%s%s",path,name,TB_EXTENSION);
+    FILE *out=fopen(fname,"wb");
+    if(out==NULL)
+    {
+      fprintf(stderr,"Err: Could not open table file %s for writing\n",fname);
+      free(data);
+      return false;
+    }
+    bool written=(fwrite(data,1,gen.size*2,out)==gen.size*2);
+    written=(fclose(out)==0) && written;
+    free(data);
+    if(!written || !made.open_table(path,name))
+    {
+      fprintf(stderr,"Err: Could not write table file %s\n",fname);
+      return false;
+    }
+    
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start_time).count();
+    printf("tablebase table=%s positions=%lu wins=%lu draws=%lu losses=%lu longest_mate=%i passes=%i time=%.1lf\n",name,(unsigned long)(wins+draws+losses),(unsigned long)(wins),(unsigned long)(draws),(unsigned long)(losses),longest,gen.plies,seconds);
+    fflush(stdout);
+  }
+  return true;
+}
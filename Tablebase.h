@@ -0,0 +1,99 @@
+
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stdio.h>
+#include <vector>
+#include "Board.h"
+
+using namespace std;
+
+//the most pieces (kings included) a table covers
+#define TB_MAX_PIECES 4
+//room for a table name (like KQKR), plus a null terminator
+#define TB_NAME_SIZE 12
+//what table files are called; the table name plus this
+#define TB_EXTENSION ".ftb"
+
+//a table is a byte per position, from the side to move's point of view
+//0 is a draw, 1-127 is a win with mate in that many moves, and 128-254 is a loss, mated in that many moves past 128 (128 itself is checkmate now)
+#define TB_DRAW 0
+#define TB_LOSS 128
+#define TB_ILLEGAL 255
+
+struct _TBPosition;
+struct _TBTable;
+
+//the pieces on a board, for the tablebase
+//squares are (rank*8)+file, 0-indexed, in the same order as Board::state; the kings are always pieces 0 (white) and 1 (black)
+struct _TBPosition
+{
+  int count;
+  int square[TB_MAX_PIECES];
+  //'K', 'Q', 'R', 'B', 'N' or 'P'
+  int type[TB_MAX_PIECES];
+  int color[TB_MAX_PIECES];
+  //the square a pawn just went over by moving two squares, so the side to move could take it there en passant (-1 if the last move wasn't that)
+  int ep_square;
+};
+
+//one mapped table file
+struct _TBTable
+{
+  char name[TB_NAME_SIZE];
+  //how many pieces besides the kings
+  int extra_count;
+  //positions for each side to move (white to move comes first in the file)
+  size_t size;
+  const unsigned char *data;
+  size_t data_size;
+};
+
+//endgame tablebases for every ending of 3 and 4 pieces (KQK, KPK, KRKP, KBNK, ...)
+//
+//these are made here by retrograde analysis (see generate) rather than downloaded, so they're in our own format:
+//a table is named for its material with the stronger side first, and holds a byte per position for white to move and then for black to move
+//positions are indexed by the two kings (462 ways to place them once the board's 8 symmetries are taken out) and then 6 bits per other piece
+//pawns only go one way, so tables with pawns only use the left-right mirror; the white king is kept on files a-d (2048 ways to place the kings)
+//a table for the other colors (KRKQ) is read from the same file with the board flipped
+//
+//en passant isn't part of a position; a table gives the value as if it isn't possible, and when it is (right after a pawn moved two squares)
+//the capture is looked up as well and the better of the two is used (generate does the same, so tables are right about moving two squares)
+//
+//distances are to mate, not to a capture or a pawn move, so they don't know about the 50 move rule (KRKN and KBNK can take longer than that)
+//positions where castling is still possible aren't covered
+//files are memory-mapped, so every AI using the same directory shares one copy in memory
+class Tablebase
+{
+private:
+  vector<_TBTable> tables;
+  
+  //map one table file; false if it isn't there or isn't the right size
+  bool open_table(const char *path, const char *name);
+  //the table for a material name (NULL if we don't have one)
+  _TBTable *find_table(const char *name);
+
+public:
+  Tablebase();
+  ~Tablebase();
+  
+  //map every table file in a directory; false (with an error) if there weren't any
+  bool open(const char *path);
+  void close();
+  bool is_open(){ return !tables.empty(); }
+  
+  //look up a position with player_id to move; false if there's no table for it
+  //endings that can't be won (KK, KBK, KNK) don't need a table and are always found, as draws
+  bool lookup(const _TBPosition *pos, int player_id, unsigned char *value);
+  
+  //look up a board with player_id to move; false if it isn't covered
+  //result is 1 if player_id wins, 0 for a draw and -1 if player_id loses; plies is how many plies away mate is
+  bool probe(Board *board, int player_id, int *result, int *plies);
+  
+  //make every table and write them to the directory path, using thread_count threads (0 for one per core)
+  //smaller tables are made first, since the bigger ones need them for captures
+  static bool generate(const char *path, unsigned int thread_count);
+};
+
+#endif
+
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include "TimeManager.h"
+
+//the branching factor to assume before we've measured one
+//(iterations in this search tend to take 4-8 times as long as the one before)
+const double TimeManager::initial_branching_factor=5.0;
+//how much of a drop in score (in heuristic points) counts as the search being in trouble; a bit more than a pawn
+const double TimeManager::score_drop_threshold=1.5;
+
+TimeManager::TimeManager()
+{
+  init_fixed(0);
+}
+
+//set the limits for a move from the state of the game clock
+void TimeManager::init(double time_remaining, double increment, int moves_to_go)
+{
+  //give us a 5% margin of error right away, just in case (defensively)
+  //plus a little for the time it takes to get the move out once we've picked it
+  double usable=(time_remaining*0.95)-0.05;
+  if(usable<0)
+  {
+    usable=0;
+  }
+  
+  //if there's no time control coming, assume the game goes on about this much longer
+  if(moves_to_go<=0)
+  {
+    moves_to_go=42;
+  }
+  
+  //distribute time evenly according to how many moves we think we have left to make
+  //most of the increment can be spent too since we get it back after this move
+  soft_limit=(usable/moves_to_go)+(increment*0.9);
+  
+  //never go over a few times what we wanted, or over half of what's left (unless this is the last move before more time)
+  hard_limit=soft_limit*4;
+  double most=(moves_to_go==1)? usable : (usable/2)+increment*0.9;
+  if(hard_limit>most)
+  {
+    hard_limit=most;
+  }
+  if(hard_limit>usable)
+  {
+    hard_limit=usable;
+  }
+  if(soft_limit>hard_limit)
+  {
+    soft_limit=hard_limit;
+  }
+  
+  fixed_time=false;
+  
+  stability_scale=1;
+  score_scale=1;
+  have_best=false;
+  last_score=0;
+  stable_iterations=0;
+  last_iteration_time=0;
+  branching_factor=initial_branching_factor;
+  measured_iterations=0;
+}
+
+//set the limits for a move with a fixed amount of time; this is all used, there's no stopping early
+void TimeManager::init_fixed(double time_for_move)
+{
+  init(0,0,0);
+  soft_limit=time_for_move;
+  hard_limit=time_for_move;
+  fixed_time=true;
+}
+
+//tell the manager about an iteration that finished
+void TimeManager::iteration_done(_Move *best, double score, double iteration_time)
+{
+  //measure the branching factor as the ratio of successive iteration times
+  //very short iterations are mostly noise, so those don't count
+  if(last_iteration_time>0.001 && iteration_time>0)
+  {
+    double ratio=iteration_time/last_iteration_time;
+    
+    //average over the iterations so one odd iteration doesn't throw it off
+    if(measured_iterations==0)
+    {
+      branching_factor=ratio;
+    }
+    else
+    {
+      branching_factor=(branching_factor+ratio)/2;
+    }
+    measured_iterations++;
+  }
+  last_iteration_time=iteration_time;
+  
+  //an iteration that ran out of time doesn't tell us anything about the move
+  if(best==NULL)
+  {
+    return;
+  }
+  
+  if(have_best)
+  {
+    bool same=(best->fromFile==last_best.fromFile) && (best->fromRank==last_best.fromRank) && (best->toFile==last_best.toFile) && (best->toRank==last_best.toRank) && (best->promoteType==last_best.promoteType);
+    if(same)
+    {
+      stable_iterations++;
+    }
+    else
+    {
+      stable_iterations=0;
+    }
+    
+    //the best move changing means we're not sure yet; take more time
+    //the same move a few times in a row means more iterations probably won't change it
+    if(stable_iterations==0)
+    {
+      stability_scale=1.5;
+    }
+    else if(stable_iterations>=3)
+    {
+      stability_scale=0.5;
+    }
+    else
+    {
+      stability_scale=1;
+    }
+    
+    //if the score dropped, the last iteration found a problem; spend more time looking for a way out
+    if(score<(last_score-score_drop_threshold))
+    {
+      score_scale=2;
+    }
+    else
+    {
+      score_scale=1;
+    }
+  }
+  
+  last_best=*best;
+  have_best=true;
+  last_score=score;
+}
+
+//the soft limit with the stability and score adjustments applied (never more than the hard limit)
+double TimeManager::get_adjusted_soft_limit()
+{
+  double adjusted=soft_limit*stability_scale*score_scale;
+  if(adjusted>hard_limit)
+  {
+    adjusted=hard_limit;
+  }
+  return adjusted;
+}
+
+//whether to start another iteration, given how much time has been used on this move so far
+bool TimeManager::start_next_iteration(double time_used)
+{
+  //with a fixed time there's nothing to save time for; keep going until the clock cuts us off
+  if(fixed_time)
+  {
+    return (time_used<hard_limit);
+  }
+  
+  //we've spent what we meant to
+  if(time_used>=get_adjusted_soft_limit())
+  {
+    return false;
+  }
+  
+  //estimate the time that will be required for the next iteration
+  //if we don't think there's any real chance we can finish it don't bother starting it; this will save us some valuable play time for later
+  double time_for_next=last_iteration_time*branching_factor;
+  if((time_used+time_for_next)>hard_limit)
+  {
+    return false;
+  }
+  
+  return true;
+}
+
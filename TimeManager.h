@@ -0,0 +1,68 @@
+
+#ifndef TIMEMANAGER_H
+#define TIMEMANAGER_H
+
+#include "structures.h"
+
+//decides how long to think about a move, and between iterations whether to keep going
+//
+//there are two limits; the soft limit is how long we'd like to spend, the hard limit is the most we will ever spend
+//(the hard limit goes to the SearchClock, so a search is cut off there no matter what)
+//between iterations the soft limit is stretched when the best move keeps changing or the score drops,
+//and shrunk when the best move has been the same for a few iterations
+//
+//nothing in here reads a clock; times are all passed in, so this can be driven by made-up numbers
+class TimeManager
+{
+private:
+  double soft_limit;
+  double hard_limit;
+  //true when the time for this move was given to us directly (no game clock)
+  bool fixed_time;
+  
+  //what the soft limit gets multiplied by, based on how the search is going
+  double stability_scale;
+  double score_scale;
+  
+  //the best move and score from the last iteration, to compare against
+  _Move last_best;
+  bool have_best;
+  double last_score;
+  //how many iterations in a row the best move hasn't changed
+  int stable_iterations;
+  
+  //how long the last iteration took, and the measured ratio between successive iteration times
+  double last_iteration_time;
+  double branching_factor;
+  int measured_iterations;
+
+public:
+  //the branching factor to assume before we've measured one
+  static const double initial_branching_factor;
+  //how much of a drop in score (in heuristic points) counts as the search being in trouble
+  static const double score_drop_threshold;
+  
+  TimeManager();
+  
+  //set the limits for a move from the state of the game clock
+  //time_remaining and increment are in seconds; moves_to_go is moves until the next time control (0 if the clock is for the whole game)
+  void init(double time_remaining, double increment, int moves_to_go);
+  //set the limits for a move with a fixed amount of time; this is all used, there's no stopping early
+  void init_fixed(double time_for_move);
+  
+  //tell the manager about an iteration that finished (best is NULL if it didn't give a move)
+  void iteration_done(_Move *best, double score, double iteration_time);
+  
+  //whether to start another iteration, given how much time has been used on this move so far
+  bool start_next_iteration(double time_used);
+  
+  //accessors
+  double get_soft_limit(){ return soft_limit; }
+  double get_hard_limit(){ return hard_limit; }
+  //the soft limit with the stability and score adjustments applied (never more than the hard limit)
+  double get_adjusted_soft_limit();
+  double get_branching_factor(){ return branching_factor; }
+};
+
+#endif
+
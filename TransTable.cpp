@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include "TransTable.h"
+
+TransTable::TransTable(size_t size_mb)
+{
+  entry_count=(size_mb*1024*1024)/sizeof(_TTEntry);
+  if(entry_count<1)
+  {
+    entry_count=1;
+  }
+  
+  entries=(_TTEntry*)(malloc(entry_count*sizeof(_TTEntry)));
+  if(entries==NULL)
+  {
+    fprintf(stderr,"Err: Out of RAM!? (malloc failed)\n");
+    exit(1);
+  }
+  clear();
+}
+
+TransTable::~TransTable()
+{
+  free(entries);
+}
+
+//call at the start of every search
+void TransTable::new_search(int player_id)
+{
+  if(player_id!=root_player)
+  {
+    clear();
+    root_player=player_id;
+  }
+  generation++;
+}
+
+//forget everything
+void TransTable::clear()
+{
+  memset(entries,0,entry_count*sizeof(_TTEntry));
+  generation=0;
+  root_player=-1;
+}
+
+//look up a position by its hash
+_TTEntry *TransTable::probe(unsigned long long key)
+{
+  _TTEntry *entry=&(entries[key%entry_count]);
+  if(entry->key==key)
+  {
+    return entry;
+  }
+  return NULL;
+}
+
+//remember what a search found for a position
+void TransTable::store(unsigned long long key, int depth, double value, int bound, _Move *best_move)
+{
+  _TTEntry *entry=&(entries[key%entry_count]);
+  
+  //keep what's there if it's from this search and was searched deeper (it cost more to find)
+  if(entry->key!=0 && entry->generation==generation && entry->depth>depth)
+  {
+    return;
+  }
+  
+  //a new value for the same position without a move keeps the move we already had
+  if(entry->key!=key || best_move!=NULL)
+  {
+    entry->has_move=(best_move!=NULL);
+    if(best_move!=NULL)
+    {
+      entry->from_file=best_move->fromFile;
+      entry->from_rank=best_move->fromRank;
+      entry->to_file=best_move->toFile;
+      entry->to_rank=best_move->toRank;
+      entry->promote_type=best_move->promoteType;
+    }
+  }
+  
+  entry->key=key;
+  entry->value=value;
+  entry->depth=depth;
+  entry->bound=bound;
+  entry->generation=generation;
+}
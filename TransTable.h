@@ -0,0 +1,67 @@
+
+#ifndef TRANSTABLE_H
+#define TRANSTABLE_H
+
+#include <stdlib.h>
+#include "structures.h"
+
+struct _TTEntry;
+
+//what kind of value an entry holds
+//(with alpha-beta a node's value is only exact when it's between the bounds; otherwise it's just a bound on the real value)
+#define TT_EXACT 0
+#define TT_LOWER 1
+#define TT_UPPER 2
+
+//one remembered node
+struct _TTEntry
+{
+  //the full hash, to tell positions sharing a slot apart (0 for an empty slot)
+  unsigned long long key;
+  double value;
+  //the best move found here (valid when has_move is true), to be searched first next time
+  char from_file;
+  char from_rank;
+  char to_file;
+  char to_rank;
+  char promote_type;
+  bool has_move;
+  //how many plies were searched below this node, and what kind of value that gave
+  short depth;
+  unsigned char bound;
+  //the search this was stored in
+  unsigned char generation;
+};
+
+//a transposition table; remembers what was found for positions already searched
+//
+//entries are kept between iterations and between moves, so a new search starts with everything the last one learned
+//every search bumps the generation; when slots collide, entries from older searches are replaced first, then shallower ones
+//values are from the searching player's point of view (like everything in TreeSearch), so the table starts over when that player changes
+class TransTable
+{
+private:
+  _TTEntry *entries;
+  size_t entry_count;
+  unsigned char generation;
+  //the player the values are for (-1 before the first search)
+  int root_player;
+
+public:
+  //size_mb is how much memory to use, in megabytes
+  TransTable(size_t size_mb);
+  ~TransTable();
+  
+  //call at the start of every search; the table is cleared if player_id isn't who it was last time
+  void new_search(int player_id);
+  //forget everything
+  void clear();
+  
+  //look up a position by its hash; returns the entry (NULL if it's not there)
+  _TTEntry *probe(unsigned long long key);
+  //remember what a search found for a position (best_move may be NULL)
+  void store(unsigned long long key, int depth, double value, int bound, _Move *best_move);
+};
+
+#endif
+
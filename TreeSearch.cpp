@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include "TreeSearch.h"
 
 //returns a list of valid moves and creates associated children in board->children as a side-effect
@@ -240,13 +241,13 @@ bool TreeSearch::stalemate(Board *node, vector<_Move*> move_accumulator)
     node->clear_children();
     
     //if repetition has occured in such a way that it's a stalemate
-    if(node->get_moves_since_capture()>=8 && node->get_moves_since_advancement()>=8 && stalemate_by_repeat(move_accumulator))
+    if(node->get_halfmove_clock()>=8 && stalemate_by_repeat(move_accumulator))
     {
       return true;
     }
     
-    //if no pawn advancements or captures have occured in forever it's a stalemate
-    if(node->get_moves_since_capture()>=100 && node->get_moves_since_advancement()>=100)
+    //if no pawn advancements or captures have occured in fifty moves it's a stalemate
+    if(node->get_halfmove_clock()>=100)
     {
       return true;
     }
@@ -267,42 +268,51 @@ void TreeSearch::free_move_acc(vector <_Move*> move_accumulator)
 {
   for(size_t i=0; i<move_accumulator.size(); i++)
   {
-    free(move_accumulator[i]);
+    NodeArena::node_free(move_accumulator[i]);
   }
 }
 
-//how much time to allocate to this move given the board and how much time we have left
-double TreeSearch::time_for_this_move(Board *board, int player_id, double time_remaining, double enemy_time_remaining, int moves_made)
+//zero out all the counts in a stats structure (the output setting is left alone)
+void TreeSearch::clear_stats(_SearchStats *stats)
 {
-  //give us a 5% margin of error right away, just in case (defensively)
-  //this means we will under-estimate the time we think we have so we don't accidentally time out
-  time_remaining*=0.95;
-  
-  //if we have fewer than 15 seconds left, just allocate a quarter second per move no matter what, that should guarantee completion of at least 1 iteration, probably 2
-  if(time_remaining<15)
+  stats->nodes=0;
+  stats->qnodes=0;
+  stats->tt_hits=0;
+  stats->tb_hits=0;
+  stats->extensions=0;
+  stats->pruned=0;
+  stats->cutoffs=0;
+  for(int i=0; i<STATS_CUTOFF_SLOTS; i++)
   {
-    return 0.25;
+    stats->cutoffs_at[i]=0;
   }
+  stats->depth=0;
+  stats->complete=false;
+  stats->iteration_nodes=0;
+  stats->prev_iteration_nodes=0;
+  stats->iteration_time=0;
+  stats->total_time=0;
+  stats->value=0;
+  stats->have_best=false;
+  stats->line_count=0;
+}
+
+//print a stats structure as a single line of key=value pairs
+//(so it's easy to pull out of a log with a script)
+void TreeSearch::output_stats(FILE *outfile, _SearchStats *stats)
+{
+  //how often the first move searched was good enough to cut off the rest
+  double first_cutoff_rate=(stats->cutoffs>0)? ((double)(stats->cutoffs_at[0])/stats->cutoffs) : 0;
+  //effective branching factor; how many times more nodes this iteration took than the last one
+  double branching_factor=(stats->prev_iteration_nodes>0)? ((double)(stats->iteration_nodes)/stats->prev_iteration_nodes) : 0;
+  double nps=(stats->total_time>0)? (stats->nodes/stats->total_time) : 0;
   
-  double time_for_move;
-  
-  //how many moves we think will be after this one; we'll revise it in a second
-  double moves_remaining=42.0;
-  
-  //if we're losing and can afford some time, allocate more time to this move, in the hopes of catching up
-  //this naive_points heuristic is too simple for actual game use, but serves well enough here
-  if((time_remaining>enemy_time_remaining) && (board->points(player_id,false,false) > board->points(!player_id,false,false)))
+  fprintf(outfile,"stats depth=%i complete=%i nodes=%llu qnodes=%llu tt_hits=%llu tb_hits=%llu extensions=%llu pruned=%llu cutoffs=%llu first_cutoff_rate=%.3lf ebf=%.2lf iteration_nodes=%llu iteration_time=%.3lf total_time=%.3lf nps=%.0lf cutoffs_at=",stats->depth,stats->complete? 1 : 0,stats->nodes,stats->qnodes,stats->tt_hits,stats->tb_hits,stats->extensions,stats->pruned,stats->cutoffs,first_cutoff_rate,branching_factor,stats->iteration_nodes,stats->iteration_time,stats->total_time,nps);
+  for(int i=0; i<STATS_CUTOFF_SLOTS; i++)
   {
-    //really look forward this move
-    //if this uses too much time
-    //then on the next move we won't be ahead in time and the above condition won't trigger
-    moves_remaining/=4.0;
+    fprintf(outfile,(i==0)? "%llu" : ",%llu",stats->cutoffs_at[i]);
   }
-  
-  //distribute time evenly according to how many moves we think we have left to make
-  time_for_move=time_remaining/moves_remaining;
-  
-  return time_for_move;
+  fprintf(outfile,"\n");
 }
 
 //make a random [legal] move
@@ -328,6 +338,167 @@ _Move *TreeSearch::random_move(Board *board, int player_id)
   return move;
 }
 
+//move the child reached by move to index position, keeping the order of the others
+bool TreeSearch::bring_forward(Board *node, size_t position, const _Move *move)
+{
+  vector<Board*> children=node->get_children();
+  for(size_t i=position; i<children.size(); i++)
+  {
+    _Move *m=children[i]->get_last_move_made();
+    if(m->fromFile==move->fromFile && m->fromRank==move->fromRank && m->toFile==move->toFile && m->toRank==move->toRank && m->promoteType==move->promoteType)
+    {
+      for(size_t n=i; n>position; n--)
+      {
+        node->swap_children(n,n-1);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+//carry a line on past where the search's own line stopped by following the transposition table's best moves
+//(the search's line stops short where a node's value came straight from the table)
+//every move is checked to be legal (an entry could be from a different position with the same slot), and it stops at a repeat
+void TreeSearch::extend_line(Board *root, int player_id, _SearchLine *line, int max_length, TransTable *tt)
+{
+  if(tt==NULL || line->pv_length>=max_length || line->pv_length==0)
+  {
+    return;
+  }
+  
+  Board *board=new Board(root);
+  for(int i=0; i<line->pv_length; i++)
+  {
+    board->apply_move(board->copy_move(&(line->pv[i])),true);
+    player_id=!player_id;
+  }
+  vector<unsigned long long> seen;
+  while(line->pv_length<max_length)
+  {
+    unsigned long long key=board->hash_key(player_id);
+    if(find(seen.begin(),seen.end(),key)!=seen.end())
+    {
+      break;
+    }
+    seen.push_back(key);
+    
+    _TTEntry *entry=tt->probe(key);
+    if(entry==NULL || !entry->has_move)
+    {
+      break;
+    }
+    _Move tt_move;
+    tt_move.fromFile=entry->from_file;
+    tt_move.fromRank=entry->from_rank;
+    tt_move.toFile=entry->to_file;
+    tt_move.toRank=entry->to_rank;
+    tt_move.promoteType=entry->promote_type;
+    generate_moves(board,player_id);
+    _Move *move=NULL;
+    if(bring_forward(board,0,&tt_move))
+    {
+      move=board->copy_move(board->get_children()[0]->get_last_move_made());
+    }
+    board->clear_children();
+    if(move==NULL)
+    {
+      break;
+    }
+    
+    line->pv[line->pv_length++]=*move;
+    board->apply_move(move,true);
+    player_id=!player_id;
+  }
+  delete board;
+}
+
+//make line the move to a child followed by the child's own line (as much of it as fits)
+static void search_line_set(_SearchLine *line, _Move *move, const _SearchLine *child_line)
+{
+  line->pv[0]=*move;
+  line->pv_length=1;
+  for(int i=0; i<child_line->pv_length && line->pv_length<STATS_MAX_PV; i++)
+  {
+    line->pv[line->pv_length++]=child_line->pv[i];
+  }
+}
+
+//whether child i of node is worth searching a ply deeper; its move gives check, is the only legal move,
+//or takes back on the square the move before it captured on (which usually just evens the material back up)
+static bool search_forcing(Board *node, size_t i)
+{
+  Board *child=node->get_children()[i];
+  if(node->get_children().size()==1 || child->get_check(WHITE) || child->get_check(BLACK))
+  {
+    return true;
+  }
+  _Move *last=node->get_last_move_made();
+  _Move *move=child->get_last_move_made();
+  return (last!=NULL && node->last_move_captured() && child->last_move_captured() && move->toFile==last->toFile && move->toRank==last->toRank);
+}
+
+//mate scores (and Syzygy wins and losses) count plies from the root, but a table entry can be found again at a different ply
+//(from another line, or a later search), so they're stored counting from the node instead, and turned back when they're read
+static double tt_value_stored(double value, int ply)
+{
+  if(value>=HEURISTIC_MAXIMUM-MATE_PLIES || SZ_IS_WIN_SCORE(value))
+  {
+    return value+ply;
+  }
+  else if(value<=HEURISTIC_MINIMUM+MATE_PLIES || SZ_IS_LOSS_SCORE(value))
+  {
+    return value-ply;
+  }
+  return value;
+}
+
+static double tt_value_read(double value, int ply)
+{
+  if(value>=HEURISTIC_MAXIMUM-MATE_PLIES || SZ_IS_WIN_SCORE(value))
+  {
+    return value-ply;
+  }
+  else if(value<=HEURISTIC_MINIMUM+MATE_PLIES || SZ_IS_LOSS_SCORE(value))
+  {
+    return value+ply;
+  }
+  return value;
+}
+
+//order children with the transposition table's move first and then the killer moves for this ply
+//(these go in front of whatever order the history table gave, since they're more specific to this position)
+void TreeSearch::order_remembered(Board *node, _TTEntry *entry, KillerTable *killers, int ply)
+{
+  size_t position=0;
+  
+  if(entry!=NULL && entry->has_move)
+  {
+    _Move tt_move;
+    tt_move.fromFile=entry->from_file;
+    tt_move.fromRank=entry->from_rank;
+    tt_move.toFile=entry->to_file;
+    tt_move.toRank=entry->to_rank;
+    tt_move.promoteType=entry->promote_type;
+    if(bring_forward(node,position,&tt_move))
+    {
+      position++;
+    }
+  }
+  
+  if(killers!=NULL)
+  {
+    for(int slot=0; slot<KILLER_SLOTS; slot++)
+    {
+      _Move *killer=killers->get(ply,slot);
+      if(killer!=NULL && bring_forward(node,position,killer))
+      {
+        position++;
+      }
+    }
+  }
+}
+
 //a helper for beam search
 void TreeSearch::beam_prune(Board *node, unsigned int beam_width, int player_id, bool max, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight)
 {
@@ -355,8 +526,170 @@ void TreeSearch::beam_prune(Board *node, unsigned int beam_width, int player_id,
 //this serves the functions of dl_maxV and dl_minV, with various optional additions
 //those functions themselves just carefully choose the arguments to give to this
 //max should be true to max, false to min
-double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit, int player_id, bool max, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, double alpha, double beta, vector<_Move*> move_accumulator, bool time_limit, HistTable *hist, unsigned int beam_width, double time_for_move, double time_used)
+double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit, int ply, int player_id, bool max, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, double alpha, double beta, vector<_Move*> move_accumulator, HistTable *hist, TransTable *tt, KillerTable *killers, Tablebase *tb, Syzygy *syzygy, unsigned int beam_width, int extensions, bool singular, double futility_margin, double reverse_futility_margin, double razor_margin, double contempt, SearchClock *clock, _SearchStats *stats, vector<unsigned long long> *path, const _SearchLine *follow, _SearchLine *line)
 {
+  //nothing below here yet; this is filled in when a best child is found
+  line->pv_length=0;
+  
+  stats->nodes++;
+  if(depth_limit<=0)
+  {
+    stats->qnodes++;
+  }
+  
+  //(the clock is only actually read every so many nodes, so this is cheap)
+  if(clock->out_of_time())
+  {
+    free_move_acc(move_accumulator);
+    return OUT_OF_TIME;
+  }
+  
+  //mate distance pruning: nothing here can be better than mating right now or worse than being mated right now,
+  //so if the window is past either of those already there's nothing to find
+  if(prune && !entropy_heuristic)
+  {
+    if(HEURISTIC_MAXIMUM-ply<=alpha)
+    {
+      stats->pruned++;
+      free_move_acc(move_accumulator);
+      return HEURISTIC_MAXIMUM-ply;
+    }
+    if(HEURISTIC_MINIMUM+ply>=beta)
+    {
+      stats->pruned++;
+      free_move_acc(move_accumulator);
+      return HEURISTIC_MINIMUM+ply;
+    }
+  }
+  
+  //what a draw is worth to us; a little worse than even, by contempt, so we'd rather play on against an equal opponent
+  //(since the heuristic range can change with the entropy heuristic, that's just the middle of the range)
+  double draw=entropy_heuristic? AVG(HEURISTIC_MINIMUM,HEURISTIC_MAXIMUM) : -contempt;
+  
+  //draws that don't need the moves from here are found before generating them, which is most of the cost of a node:
+  //the fifty move rule (unless the player to move is in check, since a mate on the last move still counts; that's checked below),
+  //not enough material to mate, a position that came up earlier in this line (the same side could repeat it again, so it's as good as a draw),
+  //and the moves leading here repeating ones from before the search
+  //only positions since the last capture or pawn move can be repeats, and only every other ply has the same side to move
+  unsigned long long key=node->hash_key(player_id);
+  bool repeated=false;
+  int since=node->get_halfmove_clock();
+  for(int back=4; back<=since && back<=(int)(path->size()) && !repeated; back+=2)
+  {
+    repeated=((*path)[path->size()-back]==key);
+  }
+  if((since>=100 && !node->get_check(player_id)) || repeated || (since>=8 && stalemate_by_repeat(move_accumulator)) || insufficient_material(node,player_id))
+  {
+    free_move_acc(move_accumulator);
+    return draw;
+  }
+  
+  //an endgame table knows the real value, so there's nothing to search
+  //(wins are worth a little less the further away mate is, so the search heads for the fastest one)
+  int tb_result;
+  int tb_plies;
+  if(tb!=NULL && !entropy_heuristic && tb->probe(node,player_id,&tb_result,&tb_plies))
+  {
+    stats->tb_hits++;
+    free_move_acc(move_accumulator);
+    if(tb_result==0)
+    {
+      return draw;
+    }
+    
+    //the score for the player to move here, then from the root player's side
+    double score=(tb_result>0)? (HEURISTIC_MAXIMUM-ply-tb_plies) : (HEURISTIC_MINIMUM+ply+tb_plies);
+    return max? score : -score;
+  }
+  
+  //Syzygy tables only know win, draw or loss, so they're checked when material has just changed (a capture or pawn move) rather than at every node
+  //(and not in quiescence, where nearly every node is a capture; a probe has to search captures itself)
+  //a win that isn't mate yet is worth less than any mate found, but more than anything else, and a little less the further away it is
+  //wins and losses the 50 move rule would turn into draws count as draws
+  int wdl;
+  if(syzygy!=NULL && !entropy_heuristic && depth_limit>0 && node->get_halfmove_clock()==0 && syzygy->probe_wdl(node,player_id,&wdl))
+  {
+    stats->tb_hits++;
+    free_move_acc(move_accumulator);
+    if(wdl>SZ_LOSS && wdl<SZ_WIN)
+    {
+      return draw;
+    }
+    
+    double score=(wdl==SZ_WIN)? (SZ_WIN_SCORE-ply) : (-SZ_WIN_SCORE+ply);
+    return max? score : -score;
+  }
+  
+  //if we've searched this position before (in this search or an earlier one) to at least this depth, we may already know enough
+  //(this is before move generation since that's most of the cost of a node; quiescent nodes aren't remembered)
+  //NOTE: the entry is copied out since searching the children can overwrite it
+  _TTEntry entry;
+  bool have_entry=false;
+  if(tt!=NULL && depth_limit>0)
+  {
+    _TTEntry *found=tt->probe(key);
+    if(found!=NULL)
+    {
+      stats->tt_hits++;
+      entry=*found;
+      entry.value=tt_value_read(entry.value,ply);
+      have_entry=true;
+      
+      if(entry.depth>=depth_limit && (entry.bound==TT_EXACT || (entry.bound==TT_LOWER && entry.value>=beta) || (entry.bound==TT_UPPER && entry.value<=alpha)))
+      {
+        free_move_acc(move_accumulator);
+        return entry.value;
+      }
+    }
+  }
+  //the window this node was searched with, to tell what kind of value it ends up with
+  double original_alpha=alpha;
+  double original_beta=beta;
+  
+  //near the depth limit, what the position is worth as it stands says a lot about what searching it would find
+  //(not in check, where standing still isn't an option, and not on the last iteration's line, which should get a real search)
+  //margins are per ply left, in points (a pawn is worth 1); a margin of 0 turns that kind of pruning off
+  bool frontier=(prune && !entropy_heuristic && depth_limit>0 && depth_limit<=FUTILITY_DEPTH && follow==NULL && !node->get_check(player_id));
+  double static_eval=0;
+  if(frontier)
+  {
+    static_eval=node->heuristic_value(player_id, max, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight);
+    
+    //reverse futility: when we're this far past beta already, the opponent won't let us get here, so it's a cutoff without a search
+    double reverse_margin=reverse_futility_margin*depth_limit;
+    if(reverse_futility_margin>0 && ((max && static_eval-reverse_margin>=beta) || (!max && static_eval+reverse_margin<=alpha)))
+    {
+      stats->pruned++;
+      free_move_acc(move_accumulator);
+      return max? (static_eval-reverse_margin) : (static_eval+reverse_margin);
+    }
+    
+    //razoring: when we're this far short of alpha, only captures and checks could get us back, so see what quiescent search says;
+    //if it agrees there's no way back, that's the value, otherwise the node gets its full search after all
+    double razor=razor_margin*depth_limit;
+    if(razor_margin>0 && depth_limit<=RAZOR_DEPTH && qs_depth_limit>0 && ((max && static_eval+razor<=alpha) || (!max && static_eval-razor>=beta)))
+    {
+      vector <_Move*> new_move_acc;
+      for(size_t n=0; n<move_accumulator.size(); n++)
+      {
+        new_move_acc.push_back(node->copy_move(move_accumulator[n]));
+      }
+      double qs_value=min_or_max(node, 0, qs_depth_limit, ply, player_id, max, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, prune, alpha, beta, new_move_acc, hist, tt, killers, tb, syzygy, beam_width, 0, false, 0, 0, 0, contempt, clock, stats, path, NULL, line);
+      //the probe starts at this same node, which was already counted above
+      stats->nodes--;
+      stats->qnodes--;
+      if(qs_value==OUT_OF_TIME || (max && qs_value<=alpha) || (!max && qs_value>=beta))
+      {
+        stats->pruned++;
+        free_move_acc(move_accumulator);
+        return qs_value;
+      }
+    }
+  }
+  //futility: when even a margin's worth of improvement wouldn't get us to alpha, quiet moves aren't searched (see below)
+  bool futile=(frontier && futility_margin>0 && ((max && static_eval+(futility_margin*depth_limit)<=alpha) || (!max && static_eval-(futility_margin*depth_limit)>=beta)));
+  double futile_value=max? (static_eval+(futility_margin*depth_limit)) : (static_eval-(futility_margin*depth_limit));
+  
   //NOTE: we can't do the terminal node checks before the generate_moves call
   //because whether it's a terminal node or not depends on move generation
   
@@ -381,30 +714,30 @@ double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit,
     node->history_order_children(hist);
   }
   
+  //the best move from the last time we were here, and moves that were good elsewhere at this ply, go first
+  order_remembered(node,have_entry? &entry : NULL,killers,ply);
+  //and in front of those, the last iteration's line, if we're still on it
+  //(the table usually has that move too, but its entry can have been replaced since)
+  bool pv_first=(follow!=NULL && ply<follow->pv_length && bring_forward(node,0,&(follow->pv[ply])));
+  
   //set the move count for the current next state, so we don't have to keep re-computing it
   size_t move_count=node->get_children().size();
   
   //NOTE: only the player at move can be in checkmate
-  //if we are in checkmate, return heuristic minimum (for max player)
+  //if we are in checkmate, return heuristic minimum (for max player), less how far away it is (so a faster mate scores better)
   if(node->get_check(player_id) && node->get_children().empty())
   {
     free_move_acc(move_accumulator);
     //worst case for this player
-    return max? HEURISTIC_MINIMUM : HEURISTIC_MAXIMUM;
+    return max? (HEURISTIC_MINIMUM+ply) : (HEURISTIC_MAXIMUM-ply);
   }
-  //if it's a stalemate
-  else if((node->get_children().empty()) || (node->get_moves_since_capture()>=8 && node->get_moves_since_advancement()>=8 && stalemate_by_repeat(move_accumulator)) || (node->get_moves_since_capture()>=100 && node->get_moves_since_advancement()>=100) || insufficient_material(node,player_id))
+  //if it's a stalemate (or the fifty move rule, when we're in check but not mated)
+  else if(node->get_children().empty() || since>=100)
   {
     free_move_acc(move_accumulator);
     
-    //since the heuristic range can change with the entropy heurstic, return something a little different
-    if(entropy_heuristic){
-      return AVG(HEURISTIC_MINIMUM,HEURISTIC_MAXIMUM);
-    }
-    
     //this isn't great, but it's not that bad either
-//    return AVG(HEURISTIC_MINIMUM,HEURISTIC_MAXIMUM);
-    return -9.0;
+    return draw;
   }
   //if we hit the depth limit, use the heuristic
   //if this is a quiescent state or we've hit the quiscent search depth limit also
@@ -431,9 +764,56 @@ double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit,
   double best=(max)? HEURISTIC_MINIMUM : HEURISTIC_MAXIMUM;
   //the child that gives us the best heuristic value (so we can increment its history value)
   size_t best_child=0;
+  //the line below the child being searched
+  _SearchLine child_line;
+  //this position is part of every line below here
+  path->push_back(key);
+  
+  //the table's move is singular if every other move is clearly worse than what the table says it's worth;
+  //that's found by searching the others to half the depth, with a null window just past that, and stopping at the first one that isn't
+  //a move that's so much better than the rest is worth being sure of, so it gets extended
+  //(the table's value only counts if it's good for the side to move here, and the test's own searches don't do singular tests)
+  bool singular_first=false;
+  if(singular && prune && extensions>0 && depth_limit>=SINGULAR_DEPTH && move_count>1 && have_entry && entry.has_move && entry.depth>=depth_limit-3 && (entry.bound==TT_EXACT || entry.bound==(max? TT_LOWER : TT_UPPER)))
+  {
+    _Move *first=node->get_children()[0]->get_last_move_made();
+    if(first->fromFile==entry.from_file && first->fromRank==entry.from_rank && first->toFile==entry.to_file && first->toRank==entry.to_rank && first->promoteType==entry.promote_type)
+    {
+      double singular_bound=max? (entry.value-SINGULAR_MARGIN) : (entry.value+SINGULAR_MARGIN);
+      singular_first=true;
+      for(size_t i=1; i<move_count && singular_first; i++)
+      {
+        vector <_Move*> new_move_acc;
+        for(size_t n=0; n<move_accumulator.size(); n++)
+        {
+          new_move_acc.push_back(node->copy_move(move_accumulator[n]));
+        }
+        new_move_acc.push_back(node->copy_move(node->get_children()[i]->get_last_move_made()));
+        
+        double value=min_or_max(node->get_children()[i], (depth_limit/2)-1, qs_depth_limit, ply+1, !player_id, !max, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, true, max? singular_bound : (singular_bound-0.001), max? (singular_bound+0.001) : singular_bound, new_move_acc, hist, tt, killers, tb, syzygy, beam_width, 0, false, 0, 0, 0, contempt, clock, stats, path, NULL, &child_line);
+        if(value==OUT_OF_TIME || (max && value>singular_bound) || (!max && value<singular_bound))
+        {
+          singular_first=false;
+        }
+      }
+    }
+  }
   
   for(size_t i=0; i<move_count; i++)
   {
+    //at a futile node only moves that change the material or give check get searched (pawn moves count too, since they can promote)
+    //what's skipped is counted as worth the margin, which is still no better than alpha, so the value here is just a bound either way
+    Board *child=node->get_children()[i];
+    if(futile && i>0 && child->get_halfmove_clock()!=0 && !child->get_check(!player_id))
+    {
+      stats->pruned++;
+      if((max && futile_value>best) || (!max && futile_value<best))
+      {
+        best=futile_value;
+      }
+      continue;
+    }
+    
     //make a new move accumulator to pass to the recursive call
     vector <_Move*> new_move_acc;
     for(size_t n=0; n<move_accumulator.size(); n++)
@@ -443,23 +823,21 @@ double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit,
     //add on the move made to get to this child
     new_move_acc.push_back(node->copy_move(node->get_children()[i]->get_last_move_made()));
     
-    //time the recursive calls so we can stop early if we run out of time
-    struct timeval start_time;
-    gettimeofday(&start_time,NULL);
+    //a forcing move is searched a ply deeper, while this line has extensions left (not in quiescent search, which follows those anyway)
+    int child_depth=depth_limit-1;
+    int child_extensions=extensions;
+    if(depth_limit>0 && extensions>0 && ((singular_first && i==0) || search_forcing(node,i)))
+    {
+      child_depth=depth_limit;
+      child_extensions--;
+      stats->extensions++;
+    }
     
     //NOTE: on the recursive calls we generate the moves for the /other/ player
-    double opponent_move=min_or_max(node->get_children()[i], depth_limit-1, qs_depth_limit, !player_id, !max, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, prune, alpha, beta, new_move_acc, time_limit, hist, beam_width, time_for_move, time_used);
-    
-    struct timeval end_time;
-    gettimeofday(&end_time,NULL);
-    
-    //compute the difference between start and end times and add that to the time used
-    double before=start_time.tv_sec+(start_time.tv_usec/1000000.0);
-    double after=end_time.tv_sec+(end_time.tv_usec/1000000.0);
-    time_used+=(after-before);
+    double opponent_move=min_or_max(node->get_children()[i], child_depth, qs_depth_limit, ply+1, !player_id, !max, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, prune, alpha, beta, new_move_acc, hist, tt, killers, tb, syzygy, beam_width, child_extensions, singular, futility_margin, reverse_futility_margin, razor_margin, contempt, clock, stats, path, (pv_first && i==0)? follow : NULL, &child_line);
     
-    //if we're out of time, return NULL (as an error code) and clean up memory
-    if((opponent_move==OUT_OF_TIME) || (time_limit && (time_used>=time_for_move)))
+    //if we're out of time (or were told to stop), return OUT_OF_TIME (as an error code) and clean up memory
+    if((opponent_move==OUT_OF_TIME) || clock->stopped())
     {
 #ifdef DEBUG
       printf("min_or_max debug 2, OUT OF TIME, returning early\n");
@@ -474,6 +852,15 @@ double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit,
       //fail low for min player or fail high for max player
       if(((opponent_move<=alpha) && (!max)) || ((opponent_move>=beta) && (max)))
       {
+        stats->cutoffs++;
+        stats->cutoffs_at[(i<STATS_CUTOFF_SLOTS)? i : (STATS_CUTOFF_SLOTS-1)]++;
+        
+        //a quiet move that refutes this is worth trying first in the positions next to it
+        if(killers!=NULL && !node->get_children()[i]->last_move_captured())
+        {
+          killers->add(ply,node->get_children()[i]->get_last_move_made());
+        }
+        
         best_child=i;
         //return the fail up so that the other recursion levels can handle it accordingly
         best=opponent_move;
@@ -488,6 +875,7 @@ double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit,
     {
       best_child=i;
       best=opponent_move;
+      search_line_set(line,node->get_children()[i]->get_last_move_made(),&child_line);
       
       //NOTE: if prune is not true, these values will still be set, but they won't be used for anything
       //if I'm the max player and I have some best value, I will no longer accept anything lower than that
@@ -509,8 +897,28 @@ double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit,
     hist->increment_or_make(node->get_children()[best_child]);
   }
   
+  //remember what we found here for next time
+  //a value outside the window we were given is only a bound (the search below stopped once it knew it was out of the window)
+  if(tt!=NULL && depth_limit>0 && best!=OUT_OF_TIME)
+  {
+    int bound=TT_EXACT;
+    if(prune)
+    {
+      if(best<=original_alpha)
+      {
+        bound=TT_UPPER;
+      }
+      else if(best>=original_beta)
+      {
+        bound=TT_LOWER;
+      }
+    }
+    tt->store(key,depth_limit,tt_value_stored(best,ply),bound,node->get_children()[best_child]->get_last_move_made());
+  }
+  
   //manage memory; we won't need this any more
   node->clear_children();
+  path->pop_back();
   
   free_move_acc(move_accumulator);
   
@@ -519,13 +927,16 @@ double TreeSearch::min_or_max(Board *node, int depth_limit, int qs_depth_limit,
 }
 
 //depth-limited minimax
-_Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, bool time_limit, HistTable *hist, unsigned int beam_width, double time_for_move, double time_used)
+_Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, HistTable *hist, TransTable *tt, KillerTable *killers, Tablebase *tb, Syzygy *syzygy, unsigned int beam_width, unsigned int multipv, int extensions, bool singular, double futility_margin, double reverse_futility_margin, double razor_margin, double contempt, SearchClock *clock, _SearchStats *stats, double *value, _SearchLine *lines, int *line_count)
 {
 //  printf("dl_minimax debug 0, got a board with %i children\n", root->get_children().size());
   
   double alpha=HEURISTIC_MINIMUM;
   double beta=HEURISTIC_MAXIMUM;
   
+  //the root counts as a node too
+  stats->nodes++;
+  
   //the tree-search frontier
   std::vector<Board*> frontier;
   
@@ -553,6 +964,19 @@ _Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit,
     root->history_order_children(hist);
   }
   
+  //the best move from the last iteration (or from the last search, if the game went the way it expected) goes first
+  unsigned long long key=root->hash_key(player_id);
+  if(tt!=NULL)
+  {
+    order_remembered(root,tt->probe(key),NULL,0);
+  }
+  
+  //the last iteration's lines go first (best first); with more than one line wanted, this makes the bar for getting in high from the start
+  for(int i=stats->line_count-1; i>=0; i--)
+  {
+    bring_forward(root,0,&(stats->lines[i].pv[0]));
+  }
+
 //  printf("dl_minimax debug 1, now have a board with %i children\n", root->get_children().size());
   
   //the first player is always max-ing
@@ -563,6 +987,21 @@ _Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit,
   _Move *max_move=NULL;
   size_t best_child=0;
   
+  //the best multipv children so far (child index and value), best first
+  //a child only has to beat the worst of these to get in, so that's what alpha is; the ones that do get an exact value
+  //(with one line this is just current_max and best_child)
+  if(multipv<1)
+  {
+    multipv=1;
+  }
+  vector<pair<size_t,double> > best_children;
+  //and their lines, in the same order
+  vector<_SearchLine> best_lines;
+  _SearchLine child_line;
+  //the positions along the line being searched, for finding repetitions (starting from this one)
+  vector<unsigned long long> path;
+  path.push_back(key);
+  
   //find the max value of all children (which will be determined recursively)
   for(size_t i=0; i<(root->get_children().size()); i++)
   {
@@ -575,52 +1014,90 @@ _Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit,
     //add on the move made to get to this child
     new_move_acc.push_back(root->copy_move(root->get_children()[i]->get_last_move_made()));
     
-    //time the recursive calls so we can stop early if we run out of time
-    struct timeval start_time;
-    gettimeofday(&start_time,NULL);
-    
     //NOTE: this section depends on the heuristic used
     //get the heuristic value for this node (or better, if available; see dl_minV for more information)
     
     //this is a dl_minV call, using a more general function
-    double heuristic=min_or_max(root->get_children()[i], depth_limit-1, qs_depth_limit, !player_id, false, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, prune, alpha, beta, new_move_acc, time_limit, hist, beam_width, time_for_move, time_used);
+    //a move that started one of the last iteration's lines follows the rest of that line down
+    _Move *move=root->get_children()[i]->get_last_move_made();
+    const _SearchLine *follow=NULL;
+    for(int n=0; n<stats->line_count && follow==NULL; n++)
+    {
+      _Move *first=&(stats->lines[n].pv[0]);
+      if(first->fromFile==move->fromFile && first->fromRank==move->fromRank && first->toFile==move->toFile && first->toRank==move->toRank && first->promoteType==move->promoteType)
+      {
+        follow=&(stats->lines[n]);
+      }
+    }
     
-    struct timeval end_time;
-    gettimeofday(&end_time,NULL);
+    //forcing moves get a ply more here too
+    int child_depth=depth_limit-1;
+    int child_extensions=extensions;
+    if(extensions>0 && search_forcing(root,i))
+    {
+      child_depth=depth_limit;
+      child_extensions--;
+      stats->extensions++;
+    }
     
-    double before=start_time.tv_sec+(start_time.tv_usec/1000000.0);
-    double after=end_time.tv_sec+(end_time.tv_usec/1000000.0);
-    time_used+=(after-before);
+    double heuristic=min_or_max(root->get_children()[i], child_depth, qs_depth_limit, 1, !player_id, false, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, prune, alpha, beta, new_move_acc, hist, tt, killers, tb, syzygy, beam_width, child_extensions, singular, futility_margin, reverse_futility_margin, razor_margin, contempt, clock, stats, &path, follow, &child_line);
     
-    //if we're out of time, return NULL (as an error code) and clean up memory
-    if((heuristic==OUT_OF_TIME) || (time_limit && (time_used>=time_for_move)))
+    //if we're out of time (or were told to stop), return NULL (as an error code) and clean up memory
+    if((heuristic==OUT_OF_TIME) || clock->stopped())
     {
       current_max=OUT_OF_TIME;
 #ifdef DEBUG
       printf("dl_minimax debug 1.5, OUT OF TIME, returning early\n");
 #endif
-      free(max_move);
+      NodeArena::node_free(max_move);
       max_move=NULL;
       break;
     }
     
-    //if we don't have a move yet take this one regardless of heuristic
-    if(heuristic>current_max || max_move==NULL)
+    //a child that isn't better than the worst line we have isn't a line (and its value is only a bound)
+    if(best_children.size()>=multipv && heuristic<=best_children.back().second)
+    {
+      continue;
+    }
+    size_t position=best_children.size();
+    while(position>0 && heuristic>best_children[position-1].second)
+    {
+      position--;
+    }
+    best_children.insert(best_children.begin()+position,make_pair(i,heuristic));
+    _SearchLine line;
+    search_line_set(&line,move,&child_line);
+    best_lines.insert(best_lines.begin()+position,line);
+    if(best_children.size()>multipv)
+    {
+      best_children.pop_back();
+      best_lines.pop_back();
+    }
+    
+    //as the max player we will no longer accept anything worse than the worst line we're keeping
+    //in the no-pruning case this value gets ignored, but it doesn't hurt to set it anyway
+    if(best_children.size()>=multipv)
+    {
+      alpha=best_children.back().second;
+    }
+    
+    //a new best line (or the first one) is the move to play
+    if(position==0)
     {
       best_child=i;
       current_max=heuristic;
       
-      //as the max player we will no longer accept anything worse than what we just got
-      //in the no-pruning case this value gets ignored, but it doesn't hurt to set it anyway
-      alpha=current_max;
-      
       //we won't be using the old move so free it
       if(max_move!=NULL)
       {
-        free(max_move);
+        NodeArena::node_free(max_move);
       }
       
+      //the move we return has to outlive this search's arena, so it comes from the heap
+      NodeArena *arena=NodeArena::get_active();
+      NodeArena::set_active(NULL);
       max_move=root->copy_move(root->get_children()[i]->get_last_move_made());
+      NodeArena::set_active(arena);
     }
   }
   
@@ -630,6 +1107,25 @@ _Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit,
     hist->increment_or_make(root->get_children()[best_child]);
   }
   
+  //the root's value is always exact (its window is never narrowed from above)
+  if(tt!=NULL && current_max!=OUT_OF_TIME && max_move!=NULL)
+  {
+    tt->store(key,depth_limit,current_max,TT_EXACT,max_move);
+  }
+  
+  //the lines, each carried on through the transposition table to the depth searched, if it stopped short of that
+  if(lines!=NULL && current_max!=OUT_OF_TIME && max_move!=NULL)
+  {
+    *line_count=0;
+    for(size_t i=0; i<best_lines.size() && i<STATS_MAX_LINES; i++)
+    {
+      lines[i]=best_lines[i];
+      lines[i].value=best_children[i].second;
+      extend_line(root,player_id,&(lines[i]),(depth_limit<STATS_MAX_PV)? depth_limit : STATS_MAX_PV,tt);
+      (*line_count)++;
+    }
+  }
+  
   //clean up memory from those recursive calls
   root->clear_children();
   
@@ -642,6 +1138,11 @@ _Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit,
   
   free_move_acc(move_accumulator);
   
+  if(value!=NULL)
+  {
+    *value=current_max;
+  }
+  
   //make (read: return) the move that got us to the best position
   //(stored as Board::last_move_made in the child we chose earlier)
   //note that for memory management purposes this is a copy (made when setting max_move)
@@ -649,28 +1150,55 @@ _Move *TreeSearch::dl_minimax(Board *root, int depth_limit, int qs_depth_limit,
 }
 
 //iterative deepening depth-limited minimax with an option to time-limit instead of using a given max depth
-_Move *TreeSearch::id_minimax(Board *root, int max_depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, bool time_limit, HistTable *hist, unsigned int beam_width, double time_remaining, double enemy_time_remaining, bool fixed_time)
+_Move *TreeSearch::id_minimax(Board *root, int max_depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, bool time_limit, HistTable *hist, TransTable *tt, KillerTable *killers, Tablebase *tb, Syzygy *syzygy, unsigned int beam_width, unsigned int multipv, int extensions, bool singular, double futility_margin, double reverse_futility_margin, double razor_margin, double contempt, double time_remaining, double increment, int moves_to_go, bool fixed_time, SearchClock *clock, _SearchStats *stats)
 {
   _Move *end_move=NULL;
   
-  //how much time we have used so far
-  double time_used=0;
+  //if the caller doesn't want stats we still need somewhere to count things
+  _SearchStats local_stats;
+  if(stats==NULL)
+  {
+    local_stats.output=NULL;
+    local_stats.iteration_hook=NULL;
+    stats=&local_stats;
+  }
+  clear_stats(stats);
+  
+  //entries from earlier searches are kept (they're still good), but new ones take priority over them
+  if(tt!=NULL)
+  {
+    tt->new_search(player_id);
+  }
+  
+  //all the boards, pieces, and moves an iteration makes come out of this, and are thrown away together after it
+  NodeArena arena;
+  NodeArena *outer_arena=NodeArena::get_active();
   
   //how much time to allocate for this move
-  double time_for_move;
+  //(the time manager's hard limit is where the clock cuts us off; between iterations it decides whether to keep going)
+  TimeManager time_manager;
   if(fixed_time)
   {
-    time_for_move=time_remaining;
+    time_manager.init_fixed(time_remaining);
   }
   else
   {
-    time_for_move=time_for_this_move(root,player_id,time_remaining,enemy_time_remaining,move_accumulator.size());
+    time_manager.init(time_remaining,increment,moves_to_go);
   }
+  double time_for_move=time_manager.get_hard_limit();
   
 #ifdef DEBUG
   printf("id_minimax debug 0, allocating %lf seconds to this move\n",time_for_move);
 #endif
   
+  //if the caller isn't going to stop this search from elsewhere, it just needs a clock of its own
+  SearchClock local_clock;
+  if(clock==NULL)
+  {
+    clock=&local_clock;
+  }
+  clock->start(time_for_move,time_limit);
+  
   //the <= here is so max_depth_limit is inclusive
   //in the case we're doing a time-limited version of this we don't want to stop on max depth limit
   for(int depth_limit=1; time_limit || (depth_limit<=max_depth_limit); depth_limit++)
@@ -679,6 +1207,9 @@ _Move *TreeSearch::id_minimax(Board *root, int max_depth_limit, int qs_depth_lim
     printf("id_minimax debug 1, getting a move from dl_minimax with depth limit %i, prune is %s\n", depth_limit, prune? "True" : "False");
 #endif
     
+    arena.reset();
+    NodeArena::set_active(&arena);
+    
     //make a new move accumulator to pass to the depth-limited call
     vector <_Move*> new_move_acc;
     for(size_t n=0; n<move_accumulator.size(); n++)
@@ -686,20 +1217,30 @@ _Move *TreeSearch::id_minimax(Board *root, int max_depth_limit, int qs_depth_lim
       new_move_acc.push_back(root->copy_move(move_accumulator[n]));
     }
     
-    //track time usage on this call by storing the start and end times
-    struct timeval start_time;
-    gettimeofday(&start_time,NULL);
+    //track time usage on this call by storing the start time
+    double iteration_start=clock->elapsed();
     
     _Move *old_move=end_move;
+    unsigned long long nodes_before=stats->nodes;
+    unsigned long long tb_hits_before=stats->tb_hits;
+    double value=0;
+    _SearchLine lines[STATS_MAX_LINES];
+    int line_count=0;
     
     //NOTE: when not using a history table, hist will be NULL
-    end_move=dl_minimax(root, depth_limit, qs_depth_limit, player_id, new_move_acc, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, prune, time_limit, hist, beam_width, time_for_move, time_used);
+    end_move=dl_minimax(root, depth_limit, qs_depth_limit, player_id, new_move_acc, entropy_heuristic, distance_sum, heur_pawn_additions, heur_position_additions, enemy_weight, owned_weight, prune, hist, tt, killers, tb, syzygy, beam_width, multipv, extensions, singular, futility_margin, reverse_futility_margin, razor_margin, contempt, clock, stats, &value, lines, &line_count);
+    
+    //everything from the arena is gone by now (dl_minimax clears the tree before returning)
+    NodeArena::set_active(outer_arena);
+    
+    //an iteration which ran out of time doesn't give a move
+    bool complete=(end_move!=NULL);
     
     //if a new move was successfully generated
     if(end_move!=NULL)
     {
       //free the memory from before
-      free(old_move);
+      NodeArena::node_free(old_move);
     }
     //otherwise make use of the previously generated move
     else
@@ -707,39 +1248,68 @@ _Move *TreeSearch::id_minimax(Board *root, int max_depth_limit, int qs_depth_lim
       end_move=old_move;
     }
     
-    struct timeval end_time;
-    gettimeofday(&end_time,NULL);
+    //how much time we have used so far, and how much of that was this iteration
+    double time_used=clock->elapsed();
+    double iteration_time=time_used-iteration_start;
     
-    //compute the difference between start and end times and add that to the time used
-    double before=start_time.tv_sec+(start_time.tv_usec/1000000.0);
-    double after=end_time.tv_sec+(end_time.tv_usec/1000000.0);
-    time_used+=(after-before);
+    //only complete iterations are worth comparing for a branching factor
+    if(stats->complete)
+    {
+      stats->prev_iteration_nodes=stats->iteration_nodes;
+    }
+    stats->depth=depth_limit;
+    stats->complete=complete;
+    stats->iteration_nodes=stats->nodes-nodes_before;
+    stats->iteration_time=iteration_time;
+    stats->total_time=time_used;
+    if(complete)
+    {
+      stats->best_move=*end_move;
+      stats->value=value;
+      stats->have_best=true;
+      for(int i=0; i<line_count; i++)
+      {
+        stats->lines[i]=lines[i];
+      }
+      stats->line_count=line_count;
+    }
     
+    if(stats->output!=NULL)
+    {
+      output_stats(stats->output,stats);
+    }
+    if(stats->iteration_hook!=NULL)
+    {
+      stats->iteration_hook(stats,stats->hook_data);
+    }
+
 #ifdef DEBUG
     printf("id_minimax debug 2, time used for this move so far is %lf seconds\n",time_used);
 #endif
     
-    //estimate the time that will be required for the next iteration
-    //and take into account whether we will possibly be able to finish another iteration
-    //if we don't think there's any real chance we can finish it don't bother starting it; this will save us some valuable play time for later
+    //let the time manager know how this iteration went, and ask it whether there's time for another
+    time_manager.iteration_done(complete? end_move : NULL,value,iteration_time);
     
-    //NOTE: this estimate is based on O(b^d) being the time complexity; thus b*(O(b^(d-1))) is used to compute it, figuring 2 as a VERY optimistic branch factor
-    double time_for_next=2*(after-before);
+    //time limit stop loop condition (since we're not using the loop condition in the for statement)
+    if(time_limit && !time_manager.start_next_iteration(time_used))
+    {
+      break;
+    }
     
-/*
-    //the next iteration will almost always take at least as long as this iteration did, since it'll have to check all those nodes, and probably many additional ones
-    //this assumes no crazy amazing pruning benefits happen
-    double time_for_next=after-before;
-*/
+    //if we were told to stop from elsewhere, there's no point starting another iteration
+    if(clock->stopped())
+    {
+      break;
+    }
     
-    //if trying an iteration we don't complete is not deterimental, try it no matter what
-    if(fixed_time)
+    //if every move from the root went straight to an endgame table, a deeper search would only find the same thing
+    if(complete && stats->iteration_nodes==(stats->tb_hits-tb_hits_before)+1)
     {
-      time_for_next=0;
+      break;
     }
     
-    //time limit stop loop condition (since we're not using the loop condition in the for statement)
-    if(time_limit && ((time_used+time_for_next)>=time_for_move))
+    //if the best move mates within the depth just searched, a deeper search would only find the same mate
+    if(complete && value>=HEURISTIC_MAXIMUM-MATE_PLIES && HEURISTIC_MAXIMUM-value<=depth_limit)
     {
       break;
     }
@@ -1,14 +1,28 @@
 #ifndef TREESEARCH_H
 #define TREESEARCH_H
-#include <sys/time.h>
 #include "AI.h"
 #include "structures.h"
 #include "HistTable.h"
+#include "TransTable.h"
+#include "KillerTable.h"
+#include "Tablebase.h"
+#include "Syzygy.h"
+#include "SearchStats.h"
+#include "SearchClock.h"
+#include "TimeManager.h"
 
 #define AVG(X,Y) ((X+Y)/2)
 //an out-of-bounds return code to tell when a call ran out of time
 #define OUT_OF_TIME (HEURISTIC_MINIMUM*2)
 
+//the least depth left for a node to test whether the table's move is singular (the test searches every other move to half that)
+#define SINGULAR_DEPTH 4
+//how much worse than the table's value every other move has to be for the table's move to be singular (a pawn is worth 1)
+#define SINGULAR_MARGIN 1.0
+//how close to the depth limit futility and reverse futility pruning are done, and razoring (which is only worth it closer in)
+#define FUTILITY_DEPTH 3
+#define RAZOR_DEPTH 2
+
 typedef enum
 {
   PAWN,
@@ -41,12 +55,23 @@ public:
   //free the memory referenced by a move accumulator vector
   static void free_move_acc(vector <_Move*> move_accumulator);
   
-  //how much time to allocate to this move given the board and how much time we have left
-  static double time_for_this_move(Board *board, int player_id, double time_remaining, double enemy_time_remaining, int moves_made);
+  //zero out all the counts in a stats structure (the output setting and hook are left alone)
+  static void clear_stats(_SearchStats *stats);
+  
+  //print a stats structure as a single line of key=value pairs
+  static void output_stats(FILE *outfile, _SearchStats *stats);
   
   //make a random [legal] move
   static _Move *random_move(Board *board, int player_id);
   
+  //move the child reached by move to index position (keeping the order of the others); false if no child has that move
+  static bool bring_forward(Board *node, size_t position, const _Move *move);
+  //carry on a line from root (with player_id to move) by following the transposition table's best moves, until it's max_length moves long
+  //or the table runs out (tt can be NULL, in which case the line is left alone)
+  static void extend_line(Board *root, int player_id, _SearchLine *line, int max_length, TransTable *tt);
+  //order children with the transposition table's move first (if there's an entry with one) and then the killer moves for this ply
+  static void order_remembered(Board *node, _TTEntry *entry, KillerTable *killers, int ply);
+  
   //a helper for beam search
   static void beam_prune(Board *node, unsigned int beam_width, int player_id, bool max, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight);
   
@@ -58,17 +83,43 @@ public:
   //max should be true to max, false to min
   //prune should be true for pruning, false for not; alpha and beta are ignored when prune is false
   //QS depth should be 0 when quiescent search is not being used
+  //ply is how far node is from the root (for killer moves)
   //hist is NULL when history is not being used
+  //tt is NULL when a transposition table is not being used, and killers is NULL when killer moves are not
+  //tb is NULL when there are no endgame tables; when there are, positions they cover (past the root) aren't searched at all
+  //syzygy is likewise NULL for no Syzygy tables; those are probed right after captures and pawn moves
   //beam_width is 0 when forward pruning is not being used, and >0 when it is (this is the max number of children to consider)
-  static double min_or_max(Board *node, int depth_limit, int qs_depth_limit, int player_id, bool max, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, double alpha, double beta, vector<_Move*> move_accumulator, bool time_limit, HistTable *hist, unsigned int beam_width, double time_for_move, double time_used);
+  //extensions is how many more times the line down to here can be extended; a child is searched a ply deeper (using one up) when
+  //its move gives check, is the only legal move, or recaptures on the square the last move captured on
+  //with singular (and a table, and pruning) the table's move is also extended when every other move is clearly worse (see SINGULAR_MARGIN)
+  //futility_margin, reverse_futility_margin and razor_margin are for pruning near the depth limit (within FUTILITY_DEPTH plies) by the static value;
+  //each is points per ply left, and 0 turns that kind of pruning off (all of them are off without prune)
+  //a draw is worth -contempt (from the root player's side), so a positive contempt plays on rather than settle for a draw
+  //clock says when to stop (because time ran out or because another thread said so)
+  //path has the hash keys of the positions from the root down to node's parent, for finding repetitions; node's is added while its children are searched
+  //follow is the last iteration's line when node is on it (the move at index ply is searched first here), and NULL otherwise
+  //line is set to the best line from node (the principal variation); every node fills in its own from its best child's,
+  //so the root ends up with the whole line (a triangular PV table, with each row on the stack of the call it belongs to)
+  static double min_or_max(Board *node, int depth_limit, int qs_depth_limit, int ply, int player_id, bool max, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, double alpha, double beta, vector<_Move*> move_accumulator, HistTable *hist, TransTable *tt, KillerTable *killers, Tablebase *tb, Syzygy *syzygy, unsigned int beam_width, int extensions, bool singular, double futility_margin, double reverse_futility_margin, double razor_margin, double contempt, SearchClock *clock, _SearchStats *stats, vector<unsigned long long> *path, const _SearchLine *follow, _SearchLine *line);
   
   //depth-limited minimax
-  //hist is NULL when history is not being used
-  static _Move *dl_minimax(Board *root, int depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, bool time_limit, HistTable *hist, unsigned int beam_width, double time_for_move, double time_used);
+  //hist, tt, killers, tb and syzygy are NULL when they're not being used
+  //value is set to the heuristic value of the move returned (NULL if that's not wanted)
+  //multipv is how many of the best moves at the root get an exact value (1 for just the best); those come back in lines, best first,
+  //with line_count set to how many there are (lines is NULL if they're not wanted)
+  //stats->lines from the last iteration are searched first, all the way down each line
+  static _Move *dl_minimax(Board *root, int depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, HistTable *hist, TransTable *tt, KillerTable *killers, Tablebase *tb, Syzygy *syzygy, unsigned int beam_width, unsigned int multipv, int extensions, bool singular, double futility_margin, double reverse_futility_margin, double razor_margin, double contempt, SearchClock *clock, _SearchStats *stats, double *value, _SearchLine *lines, int *line_count);
   
   //NOTE: the way a non-quiescent search is done is to set the quiescent depth limit as 0
   //iterative deepening depth-limited minimax with an option to time-limit instead of using a given max depth
-  static _Move *id_minimax(Board *root, int max_depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, bool time_limit, HistTable *hist, unsigned int beam_width, double time_remaining, double enemy_time_remaining, bool fixed_time);
+  //stats is filled in with counts from the search (NULL when they aren't wanted)
+  //when fixed_time is true time_remaining is the time for this move; otherwise it's what's left on our game clock
+  //(with increment seconds added per move and moves_to_go moves until the next time control, 0 for none)
+  //clock is for stopping the search from another thread (NULL when that won't happen); id_minimax starts it
+  //tt and killers are kept by the caller between searches (NULL when not used), as are tb and syzygy, so each search starts with what the last one learned
+  //extensions, singular, the margins and contempt are as for min_or_max (0 and false for no extensions, and 0 margins for no pruning by them)
+  //multipv is how many lines to find (see dl_minimax); they're in stats->lines after every complete iteration, and the first is the principal variation
+  static _Move *id_minimax(Board *root, int max_depth_limit, int qs_depth_limit, int player_id, vector<_Move*> move_accumulator, bool entropy_heuristic, bool distance_sum, bool heur_pawn_additions, bool heur_position_additions, double enemy_weight, double owned_weight, bool prune, bool time_limit, HistTable *hist, TransTable *tt, KillerTable *killers, Tablebase *tb, Syzygy *syzygy, unsigned int beam_width, unsigned int multipv, int extensions, bool singular, double futility_margin, double reverse_futility_margin, double razor_margin, double contempt, double time_remaining, double increment, int moves_to_go, bool fixed_time, SearchClock *clock, _SearchStats *stats);
 };
 
 #endif
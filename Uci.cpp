@@ -0,0 +1,491 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "Uci.h"
+#include "Notation.h"
+#include "TreeSearch.h"
+#include "TimeManager.h"
+
+UciEngine::UciEngine(const char *name)
+{
+  engine_name=name;
+  
+  board=NULL;
+  player_id=WHITE;
+  
+  ai=new AI();
+  ai->init();
+  
+  infinite=false;
+  pondering.store(false);
+  ponder_time_limited=false;
+  ponder_time=0;
+  ponder_increment=0;
+  ponder_moves_to_go=0;
+  ponder_fixed_time=true;
+  
+  new_position();
+}
+
+UciEngine::~UciEngine()
+{
+  stop();
+  
+  if(board!=NULL)
+  {
+    delete board;
+  }
+  
+  ai->end();
+  delete ai;
+}
+
+//write one line of protocol output; this is safe from either thread
+//(and flushed right away, since whoever is reading is waiting on it)
+void UciEngine::output_line(const char *line)
+{
+  output_lock.lock();
+  printf("%s\n",line);
+  fflush(stdout);
+  output_lock.unlock();
+}
+
+//go back to the starting position with no history
+void UciEngine::new_position()
+{
+  if(board!=NULL)
+  {
+    delete board;
+  }
+  board=new Board();
+  player_id=WHITE;
+  ai->clear_moves();
+}
+
+//position [startpos | fen <fen>] [moves <move> ...]
+void UciEngine::position(char *args)
+{
+  new_position();
+  
+  char *token=strtok(args," \t");
+  if(token==NULL)
+  {
+    return;
+  }
+  
+  if(!strcmp(token,"fen"))
+  {
+    //the fen is everything up to the moves (or the end of the line)
+    char fen[BUFFER_SIZE];
+    strncpy(fen,"",BUFFER_SIZE);
+    for(token=strtok(NULL," \t"); token!=NULL && strcmp(token,"moves"); token=strtok(NULL," \t"))
+    {
+      strncat(fen,token,BUFFER_SIZE-strlen(fen)-2);
+      strcat(fen," ");
+    }
+    
+    if(!board->from_fen(fen,&player_id))
+    {
+      output_line("info string invalid fen; using startpos");
+    }
+  }
+  else
+  {
+    //startpos; the board is already there
+    token=strtok(NULL," \t");
+  }
+  
+  if(token==NULL || strcmp(token,"moves"))
+  {
+    return;
+  }
+  
+  //play out every move given, remembering them (for repetition) same as in a normal game
+  for(token=strtok(NULL," \t"); token!=NULL; token=strtok(NULL," \t"))
+  {
+    _Move *move=Notation::coord_to_move(board,player_id,token);
+    if(move==NULL)
+    {
+      char buffer[BUFFER_SIZE];
+      snprintf(buffer,BUFFER_SIZE,"info string illegal move %s; ignoring it and the rest of the moves",token);
+      output_line(buffer);
+      return;
+    }
+    
+    ai->remember_move(board->copy_move(move));
+    board->apply_move(move,true);
+    player_id=!player_id;
+  }
+}
+
+//go [ponder] [depth <n>] [movetime <ms>] [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [infinite]
+void UciEngine::go(char *args)
+{
+  stop();
+  
+  int depth_limit=-1;
+  double move_time=-1;
+  double time_left[2]={-1,-1};
+  double increment[2]={0,0};
+  int moves_to_go=0;
+  infinite=false;
+  bool ponder=false;
+  
+  char *token=strtok(args," \t");
+  while(token!=NULL)
+  {
+    //everything but infinite takes a number after it
+    char *value=NULL;
+    if(strcmp(token,"infinite") && strcmp(token,"ponder"))
+    {
+      value=strtok(NULL," \t");
+      if(value==NULL)
+      {
+        break;
+      }
+    }
+    
+    if(!strcmp(token,"infinite"))
+    {
+      infinite=true;
+    }
+    else if(!strcmp(token,"ponder"))
+    {
+      ponder=true;
+    }
+    else if(!strcmp(token,"depth"))
+    {
+      depth_limit=atoi(value);
+    }
+    else if(!strcmp(token,"movetime"))
+    {
+      move_time=atof(value)/1000.0;
+    }
+    else if(!strcmp(token,"wtime"))
+    {
+      time_left[WHITE]=atof(value)/1000.0;
+    }
+    else if(!strcmp(token,"btime"))
+    {
+      time_left[BLACK]=atof(value)/1000.0;
+    }
+    else if(!strcmp(token,"winc"))
+    {
+      increment[WHITE]=atof(value)/1000.0;
+    }
+    else if(!strcmp(token,"binc"))
+    {
+      increment[BLACK]=atof(value)/1000.0;
+    }
+    else if(!strcmp(token,"movestogo"))
+    {
+      moves_to_go=atoi(value);
+    }
+    //anything else (nodes, mate, searchmoves) isn't supported, and is ignored
+    
+    token=strtok(NULL," \t");
+  }
+  
+  //work out which limit to search with; with none at all we go until told to stop
+  bool time_limited=false;
+  bool fixed_time=true;
+  double time_remaining=0;
+  double search_increment=0;
+  if(infinite)
+  {
+    depth_limit=UCI_MAX_DEPTH;
+  }
+  else if(move_time>=0)
+  {
+    time_limited=true;
+    time_remaining=move_time;
+  }
+  else if(time_left[player_id]>=0)
+  {
+    time_limited=true;
+    fixed_time=false;
+    time_remaining=time_left[player_id];
+    search_increment=increment[player_id];
+  }
+  else if(depth_limit<=0)
+  {
+    infinite=true;
+    depth_limit=UCI_MAX_DEPTH;
+  }
+  
+  //a ponder search has no time limit until the ponderhit, which gives it the one worked out here
+  //(the position already has the move we're pondering on; the GUI sends it that way)
+  ponder_time_limited=time_limited;
+  ponder_time=time_remaining;
+  ponder_increment=search_increment;
+  ponder_moves_to_go=moves_to_go;
+  ponder_fixed_time=fixed_time;
+  pondering.store(ponder && !infinite);
+  if(pondering.load() && time_limited)
+  {
+    time_limited=false;
+    depth_limit=UCI_MAX_DEPTH;
+  }
+  
+  //stats lines (if they're on) go to stderr so they don't get mixed in with the protocol
+  ai->get_stats()->output=ai->get_search_stats()? stderr : NULL;
+  ai->set_iteration_hook(output_info,this);
+  
+  searcher.start(ai,board,player_id,depth_limit,time_limited,time_remaining,search_increment,moves_to_go,fixed_time,search_done,this);
+}
+
+//setoption name <name> value <value>
+void UciEngine::setoption(char *args)
+{
+  char variable[BUFFER_SIZE];
+  char value[BUFFER_SIZE];
+  strncpy(variable,"",BUFFER_SIZE);
+  strncpy(value,"",BUFFER_SIZE);
+  
+  char *token=strtok(args," \t");
+  if(token==NULL || strcmp(token,"name"))
+  {
+    return;
+  }
+  
+  //the name is every word up to value (names can have spaces in them), and the value is the rest of the line (so can paths)
+  for(token=strtok(NULL," \t"); token!=NULL && strcmp(token,"value"); token=strtok(NULL," \t"))
+  {
+    if(strlen(variable)>0)
+    {
+      strncat(variable," ",BUFFER_SIZE-strlen(variable)-1);
+    }
+    strncat(variable,token,BUFFER_SIZE-strlen(variable)-1);
+  }
+  if(strlen(variable)==0)
+  {
+    return;
+  }
+  
+  if(token!=NULL)
+  {
+    token=strtok(NULL,"");
+    if(token!=NULL)
+    {
+      while(isspace(*token))
+      {
+        token++;
+      }
+      strncpy(value,token,BUFFER_SIZE-1);
+      size_t value_len=strlen(value);
+      while(value_len>0 && isspace(value[value_len-1]))
+      {
+        value[--value_len]='\0';
+      }
+    }
+  }
+  
+  //NOTE: this changes the settings the search reads, so it can't happen during a search
+  stop();
+  ai->set_ts_option(variable,value,BUFFER_SIZE);
+}
+
+//the opponent played the move we were pondering on
+void UciEngine::ponderhit()
+{
+  if(!pondering.load())
+  {
+    return;
+  }
+  
+  //whatever we've pondered is free; this move gets the time it would have had from now
+  //(the clock has been timing since the search was started, and a limit set now holds even if the search hasn't started its own clock yet)
+  if(ponder_time_limited)
+  {
+    TimeManager time_manager;
+    if(ponder_fixed_time)
+    {
+      time_manager.init_fixed(ponder_time);
+    }
+    else
+    {
+      time_manager.init(ponder_time,ponder_increment,ponder_moves_to_go);
+    }
+    SearchClock *clock=searcher.get_clock();
+    clock->set_limit(clock->elapsed()+time_manager.get_soft_limit());
+  }
+  
+  //now the worker is free to give its move when it's done
+  pondering.store(false);
+}
+
+//stop any search that's running and wait for the worker to finish
+void UciEngine::stop()
+{
+  searcher.stop();
+  pondering.store(false);
+}
+
+//called on the worker thread when a search is done, to print the bestmove
+void UciEngine::search_done(_Move *move, Board *root, void *done_data)
+{
+  UciEngine *engine=(UciEngine*)(done_data);
+  
+  //an infinite search doesn't get to give its move until it's told to stop, even if it's done early, and a ponder search until the ponderhit
+  while((engine->infinite || engine->pondering.load()) && !engine->searcher.get_clock()->stopped())
+  {
+    usleep(1000);
+  }
+  
+  char buffer[BUFFER_SIZE];
+  if(move!=NULL)
+  {
+    char coord[COORD_MOVE_SIZE];
+    Notation::move_to_coord(root,move,coord);
+    snprintf(buffer,BUFFER_SIZE,"bestmove %s",coord);
+  }
+  else
+  {
+    //no legal moves; the GUI should know the game is over, but it still gets an answer
+    snprintf(buffer,BUFFER_SIZE,"bestmove 0000");
+  }
+  
+  engine->output_line(buffer);
+}
+
+//called (on the worker thread) after every search iteration to print an info line
+void UciEngine::output_info(_SearchStats *stats, void *hook_data)
+{
+  UciEngine *engine=(UciEngine*)(hook_data);
+  
+  //an iteration that ran out of time has nothing new to say about the best move
+  if(!stats->complete || !stats->have_best)
+  {
+    return;
+  }
+  
+  unsigned long long nps=(stats->total_time>0)? (unsigned long long)(stats->nodes/stats->total_time) : 0;
+  
+  //one info line per line found; with more than one, each says which it is (multipv 1 is the best)
+  for(int i=0; i<stats->line_count; i++)
+  {
+    _SearchLine *line=&(stats->lines[i]);
+    
+    //a checkmate is reported in moves (mate scores count plies from the root, see IS_MATE); otherwise centipawns
+    char score[32];
+    if(line->value>=HEURISTIC_MAXIMUM-MATE_PLIES)
+    {
+      snprintf(score,32,"mate %i",((int)(HEURISTIC_MAXIMUM-line->value)+1)/2);
+    }
+    else if(line->value<=HEURISTIC_MINIMUM+MATE_PLIES)
+    {
+      snprintf(score,32,"mate -%i",((int)(line->value-HEURISTIC_MINIMUM)+1)/2);
+    }
+    else
+    {
+      snprintf(score,32,"cp %i",(int)(line->value*100));
+    }
+    
+    char multipv[32];
+    strncpy(multipv,"",32);
+    if(stats->line_count>1)
+    {
+      snprintf(multipv,32," multipv %i",i+1);
+    }
+    
+    char pv[BUFFER_SIZE/2];
+    Notation::line_to_coord(engine->board,line->pv,line->pv_length,pv,BUFFER_SIZE/2);
+    
+    char buffer[BUFFER_SIZE];
+    snprintf(buffer,BUFFER_SIZE,"info depth %i%s score %s nodes %llu nps %llu time %i pv %s",stats->depth,multipv,score,stats->nodes,nps,(int)(stats->total_time*1000),pv);
+    engine->output_line(buffer);
+  }
+}
+
+//read and handle commands from input until quit (or EOF)
+void UciEngine::run(FILE *input)
+{
+  //a position command can be very long, so this doesn't go on the stack
+  char *line=(char*)(malloc(UCI_LINE_SIZE));
+  if(line==NULL)
+  {
+    fprintf(stderr,"Err: Out of RAM!? (malloc failed)");
+    exit(1);
+  }
+  
+  while(fgets(line,UCI_LINE_SIZE,input)!=NULL)
+  {
+    //trim trailing newline (and carriage return, from some GUIs)
+    size_t len=strlen(line);
+    while(len>0 && (line[len-1]=='\n' || line[len-1]=='\r'))
+    {
+      len--;
+      line[len]='\0';
+    }
+    
+    //split off the command name from its arguments
+    char *args=line;
+    while(*args!='\0' && *args!=' ' && *args!='\t')
+    {
+      args++;
+    }
+    if(*args!='\0')
+    {
+      *args='\0';
+      args++;
+    }
+    
+    if(!strcmp(line,"uci"))
+    {
+      char buffer[BUFFER_SIZE];
+      snprintf(buffer,BUFFER_SIZE,"id name %s",engine_name);
+      output_line(buffer);
+      output_line("id author neutrak");
+      
+      output_lock.lock();
+      ai->output_uci_options(stdout);
+      output_lock.unlock();
+      //GUIs only send go ponder to engines that have this (it's the same as the ponder setting, which is otherwise only for interactive games)
+      output_line("option name Ponder type check default false");
+      
+      output_line("uciok");
+    }
+    else if(!strcmp(line,"isready"))
+    {
+      output_line("readyok");
+    }
+    else if(!strcmp(line,"ucinewgame"))
+    {
+      stop();
+      new_position();
+      //nothing learned in the last game is any use in this one
+      ai->clear_search_state();
+    }
+    else if(!strcmp(line,"position"))
+    {
+      stop();
+      position(args);
+    }
+    else if(!strcmp(line,"go"))
+    {
+      go(args);
+    }
+    else if(!strcmp(line,"stop"))
+    {
+      stop();
+    }
+    else if(!strcmp(line,"ponderhit"))
+    {
+      ponderhit();
+    }
+    else if(!strcmp(line,"setoption"))
+    {
+      setoption(args);
+    }
+    else if(!strcmp(line,"quit"))
+    {
+      break;
+    }
+    //anything else (debug, register, blank lines) is ignored, as the protocol says to
+  }
+  
+  free(line);
+  stop();
+}
+
@@ -0,0 +1,83 @@
+
+#ifndef UCI_H
+#define UCI_H
+
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include "Board.h"
+#include "AI.h"
+#include "SearchThread.h"
+#include "SearchStats.h"
+
+using namespace std;
+
+//the longest command line we'll read; a position command carries the whole game, so this is big
+#define UCI_LINE_SIZE 65536
+//how deep "go infinite" (or a go with no limits) is allowed to look; in practice stop comes long before this
+#define UCI_MAX_DEPTH 100
+
+//plays as an engine under a GUI or tournament manager, speaking the Universal Chess Interface protocol on stdin/stdout
+//
+//commands are read on the main thread and searches run on a worker thread, so stop (and isready) get answered while searching
+//the search settings are an AI object's treesearch settings; setoption sets them the same way the interactive prompt does
+class UciEngine
+{
+private:
+  //what to call ourselves in "id name"
+  const char *engine_name;
+  
+  //the position to search from, and whose move it is there
+  Board *board;
+  int player_id;
+  
+  //the AI whose settings (and move history, for repetition) are used to search
+  AI *ai;
+  
+  //the search running on the worker thread (if any)
+  //the board doesn't change while a search is running (everything that changes it stops the search first)
+  SearchThread searcher;
+  //true when the search should not give a move until it's told to stop (go infinite)
+  bool infinite;
+  //true while a go ponder search is running on the opponent's time; it gives no move until ponderhit (or stop)
+  //the limits the go command gave are kept for the ponderhit, when they start to apply
+  atomic<bool> pondering;
+  bool ponder_time_limited;
+  double ponder_time;
+  double ponder_increment;
+  int ponder_moves_to_go;
+  bool ponder_fixed_time;
+  
+  //the main thread and the worker both write to stdout, so lines go out one at a time under this lock
+  mutex output_lock;
+  void output_line(const char *line);
+  
+  //go back to the starting position with no history
+  void new_position();
+  
+  //handle the commands with arguments; args is everything after the command name
+  void position(char *args);
+  void go(char *args);
+  void setoption(char *args);
+  //the opponent played the move a go ponder search was started on, so that search carries on as a normal one
+  void ponderhit();
+  
+  //stop any search that's running (it still gives its bestmove) and wait for the worker to finish
+  void stop();
+  
+  //called on the worker thread when a search is done, to print the bestmove
+  static void search_done(_Move *move, Board *root, void *done_data);
+  
+  //called after every search iteration to print an info line
+  static void output_info(_SearchStats *stats, void *hook_data);
+
+public:
+  UciEngine(const char *name);
+  ~UciEngine();
+  
+  //read and handle commands from input until quit (or EOF)
+  void run(FILE *input);
+};
+
+#endif
+
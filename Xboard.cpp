@@ -0,0 +1,653 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <poll.h>
+#include "Xboard.h"
+#include "TreeSearch.h"
+#include "TimeManager.h"
+
+XboardEngine::XboardEngine(const char *name)
+{
+  engine_name=name;
+  
+  start_board=new Board();
+  start_player_id=WHITE;
+  board=NULL;
+  player_id=WHITE;
+  
+  ai=new AI();
+  ai->init();
+  
+  //thinking output is off and pondering is off until we're told otherwise
+  post=false;
+  ponder=false;
+  
+  //until we get a level command, assume 5 minutes for the whole game
+  level_moves=0;
+  level_base=300;
+  level_increment=0;
+  fixed_move_time=-1;
+  depth_limit=0;
+  time_left=-1;
+  
+  pondering.store(false);
+  ponder_pending.store(false);
+  ponder_hit=false;
+  abandoned.store(false);
+  thinking_board=NULL;
+  
+  new_game();
+}
+
+XboardEngine::~XboardEngine()
+{
+  stop_search();
+  
+  if(thinking_board!=NULL)
+  {
+    delete thinking_board;
+  }
+  delete board;
+  delete start_board;
+  
+  ai->end();
+  delete ai;
+}
+
+//write one line of protocol output; this is safe from either thread
+void XboardEngine::output_line(const char *line)
+{
+  output_lock.lock();
+  printf("%s\n",line);
+  fflush(stdout);
+  output_lock.unlock();
+}
+
+//start a new game from start_board
+void XboardEngine::new_game()
+{
+  board_lock.lock();
+  if(board!=NULL)
+  {
+    delete board;
+  }
+  board=new Board(start_board);
+  player_id=start_player_id;
+  ai->clear_moves();
+  ai->clear_search_state();
+  board_lock.unlock();
+  
+  //we play black unless told otherwise
+  engine_side=BLACK;
+  force_mode=false;
+  depth_limit=0;
+}
+
+//put the board back to the start and replay all but the last undo_count moves
+void XboardEngine::undo_moves(int undo_count)
+{
+  //keep a copy of the moves, since starting over forgets them
+  vector<_Move*> history=ai->get_moves();
+  vector<_Move*> replay;
+  for(int i=0; i<((int)(history.size())-undo_count); i++)
+  {
+    replay.push_back(board->copy_move(history[i]));
+  }
+  
+  board_lock.lock();
+  delete board;
+  board=new Board(start_board);
+  player_id=start_player_id;
+  ai->clear_moves();
+  
+  for(size_t i=0; i<replay.size(); i++)
+  {
+    ai->remember_move(board->copy_move(replay[i]));
+    board->apply_move(replay[i],true);
+    player_id=!player_id;
+  }
+  board_lock.unlock();
+}
+
+//apply a move in coordinate notation for whoever's at play; false if it's not legal
+bool XboardEngine::play_move(const char *text)
+{
+  board_lock.lock();
+  _Move *move=Notation::coord_to_move(board,player_id,text);
+  if(move!=NULL)
+  {
+    ai->remember_move(board->copy_move(move));
+    board->apply_move(move,true);
+    player_id=!player_id;
+  }
+  board_lock.unlock();
+  
+  return (move!=NULL);
+}
+
+//the opponent moved; resolves any ponder search and starts thinking if it's our move
+void XboardEngine::user_move(const char *text)
+{
+  if(pondering.load())
+  {
+    _Move *move=Notation::coord_to_move(board,player_id,text);
+    bool hit=(move!=NULL) && (move->fromFile==ponder_move.fromFile) && (move->fromRank==ponder_move.fromRank) && (move->toFile==ponder_move.toFile) && (move->toRank==ponder_move.toRank) && (move->promoteType==ponder_move.promoteType);
+    
+    if(hit)
+    {
+      //the search is already on the right position; play the move on our board and give the search a time limit
+      //NOTE: the move goes into ai's history once the search is done (see finish_ponder_hit)
+      board_lock.lock();
+      board->apply_move(move,true);
+      player_id=!player_id;
+      ponder_hit=true;
+      board_lock.unlock();
+      
+      int search_depth;
+      bool time_limited;
+      double time_remaining;
+      double increment;
+      int moves_to_go;
+      bool fixed_time;
+      search_limits(&search_depth,&time_limited,&time_remaining,&increment,&moves_to_go,&fixed_time);
+      
+      //with only a depth limit there's no way to bring the search in line, so that goes below like a miss
+      if(time_limited)
+      {
+        //whatever we've pondered is free; this move gets the time it would have had from now
+        TimeManager time_manager;
+        if(fixed_time)
+        {
+          time_manager.init_fixed(time_remaining);
+        }
+        else
+        {
+          time_manager.init(time_remaining,increment,moves_to_go);
+        }
+        SearchClock *clock=searcher.get_clock();
+        clock->set_limit(clock->elapsed()+time_manager.get_soft_limit());
+        
+        //now the worker is free to make its move when it's done
+        pondering.store(false);
+        return;
+      }
+      
+      stop_search();
+      think();
+      return;
+    }
+    
+    if(move!=NULL)
+    {
+      NodeArena::node_free(move);
+    }
+  }
+  
+  //a ponder miss (or a move while we were thinking, which shouldn't happen); what we were searching is no use now
+  stop_search();
+  
+  if(!play_move(text))
+  {
+    char buffer[BUFFER_SIZE];
+    snprintf(buffer,BUFFER_SIZE,"Illegal move: %s",text);
+    output_line(buffer);
+    return;
+  }
+  
+  if(!check_game_over())
+  {
+    think();
+  }
+}
+
+//the limits to search with for the current position, from the time controls
+void XboardEngine::search_limits(int *search_depth, bool *time_limited, double *time_remaining, double *increment, int *moves_to_go, bool *fixed_time)
+{
+  *search_depth=XBOARD_MAX_DEPTH;
+  *time_limited=true;
+  *time_remaining=0;
+  *increment=0;
+  *moves_to_go=0;
+  *fixed_time=true;
+  
+  //sd; id_minimax can only go by depth or by time, so a depth limit means no time limit
+  if(depth_limit>0)
+  {
+    *search_depth=depth_limit;
+    *time_limited=false;
+  }
+  //st
+  else if(fixed_move_time>=0)
+  {
+    *time_remaining=fixed_move_time;
+  }
+  //level (with time from the time command, once we have it)
+  else
+  {
+    *fixed_time=false;
+    *time_remaining=(time_left>=0)? time_left : level_base;
+    *increment=level_increment;
+    if(level_moves>0)
+    {
+      //the moves we've made so far are the ones before this fullmove (which counts from a setboard position's own number)
+      int full_moves=board->get_fullmove()-1;
+      *moves_to_go=level_moves-(full_moves%level_moves);
+    }
+  }
+}
+
+//start thinking about our move in the current position
+void XboardEngine::think()
+{
+  if(force_mode || player_id!=engine_side)
+  {
+    return;
+  }
+  
+  int search_depth;
+  bool time_limited;
+  double time_remaining;
+  double increment;
+  int moves_to_go;
+  bool fixed_time;
+  search_limits(&search_depth,&time_limited,&time_remaining,&increment,&moves_to_go,&fixed_time);
+  
+  if(thinking_board!=NULL)
+  {
+    delete thinking_board;
+  }
+  thinking_board=new Board(board);
+  
+  ai->get_stats()->output=ai->get_search_stats()? stderr : NULL;
+  ai->set_iteration_hook(output_thinking,this);
+  searcher.start(ai,board,player_id,search_depth,time_limited,time_remaining,increment,moves_to_go,fixed_time,search_done,this);
+}
+
+//guess the opponent's reply and think about our answer to it
+void XboardEngine::start_ponder()
+{
+  if(!ponder || force_mode || player_id==engine_side)
+  {
+    return;
+  }
+  
+  //the search that made our move is done, but the thread needs to be cleaned up before another can start
+  searcher.wait();
+  
+  //what the opponent will probably play
+  _Move *reply=ai->predict_reply(board,player_id);
+  if(reply==NULL)
+  {
+    return;
+  }
+  ponder_move=*reply;
+  
+  if(thinking_board!=NULL)
+  {
+    delete thinking_board;
+  }
+  thinking_board=new Board(board);
+  thinking_board->apply_move(reply,true);
+  
+  //there's no time limit on this; it's stopped by the opponent's move
+  pondering.store(true);
+  ai->set_search_reply(reply);
+  ai->get_stats()->output=ai->get_search_stats()? stderr : NULL;
+  ai->set_iteration_hook(output_thinking,this);
+  searcher.start(ai,thinking_board,engine_side,XBOARD_MAX_DEPTH,false,0,0,0,true,search_done,this);
+}
+
+//stop any search, throwing away its result
+void XboardEngine::stop_search()
+{
+  abandoned.store(true);
+  searcher.stop();
+  abandoned.store(false);
+  pondering.store(false);
+  ponder_pending.store(false);
+  
+  finish_ponder_hit();
+}
+
+//remember the opponent's move from a ponder hit, now that the search is done with the move history
+void XboardEngine::finish_ponder_hit()
+{
+  board_lock.lock();
+  if(ponder_hit)
+  {
+    ai->remember_move(board->copy_move(&ponder_move));
+    ponder_hit=false;
+  }
+  board_lock.unlock();
+}
+
+//print a result if the game is over in the current position; true if it was
+bool XboardEngine::check_game_over()
+{
+  board_lock.lock();
+  
+  TreeSearch::generate_moves(board,player_id);
+  int legal_moves=board->get_children().size();
+  board->clear_children();
+  
+  const char *result=NULL;
+  //checkmate is when someone is in check and has no legal moves
+  if(legal_moves==0 && board->get_check(player_id))
+  {
+    result=(player_id==WHITE)? "0-1 {Black mates}" : "1-0 {White mates}";
+  }
+  //stalemate is when there are no legal moves or there has been repetition, insufficient material, etc.
+  else if(legal_moves==0 || TreeSearch::stalemate(board,ai->get_moves()))
+  {
+    result="1/2-1/2 {Stalemate}";
+  }
+  
+  board_lock.unlock();
+  
+  if(result!=NULL)
+  {
+    output_line(result);
+    return true;
+  }
+  return false;
+}
+
+//called on the worker thread when a search is done, to make the move
+void XboardEngine::search_done(_Move *move, Board *root, void *done_data)
+{
+  XboardEngine *engine=(XboardEngine*)(done_data);
+  
+  //a ponder search that finished early waits to find out whether the opponent plays what we guessed
+  while(engine->pondering.load() && !engine->searcher.get_clock()->stopped())
+  {
+    usleep(1000);
+  }
+  
+  //a missed ponder, or a search that was stopped by force, new, etc.
+  if(engine->pondering.load() || engine->abandoned.load())
+  {
+    return;
+  }
+  
+  engine->finish_ponder_hit();
+  
+  if(move==NULL)
+  {
+    return;
+  }
+  
+  char coord[COORD_MOVE_SIZE];
+  Notation::move_to_coord(root,move,coord);
+  
+  engine->board_lock.lock();
+  engine->ai->remember_move(engine->board->copy_move(move));
+  engine->board->apply_move(engine->board->copy_move(move),true);
+  engine->player_id=!(engine->player_id);
+  engine->board_lock.unlock();
+  
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer,BUFFER_SIZE,"move %s",coord);
+  engine->output_line(buffer);
+  
+  //on to the opponent's time; the main thread starts pondering (it can't start a search from in here)
+  if(!engine->check_game_over() && engine->ponder)
+  {
+    engine->ponder_pending.store(true);
+  }
+}
+
+//called (on the worker thread) after every search iteration to print thinking output
+//the format is: depth, score in centipawns, time in centiseconds, nodes, principal variation
+void XboardEngine::output_thinking(_SearchStats *stats, void *hook_data)
+{
+  XboardEngine *engine=(XboardEngine*)(hook_data);
+  
+  if(!engine->post || !stats->complete || !stats->have_best)
+  {
+    return;
+  }
+  
+  //a checkmate is 100000 plus the moves to mate (mate scores count plies from the root, see IS_MATE)
+  int score;
+  if(stats->value>=HEURISTIC_MAXIMUM-MATE_PLIES)
+  {
+    score=100000+(((int)(HEURISTIC_MAXIMUM-stats->value)+1)/2);
+  }
+  else if(stats->value<=HEURISTIC_MINIMUM+MATE_PLIES)
+  {
+    score=-100000-(((int)(stats->value-HEURISTIC_MINIMUM)+1)/2);
+  }
+  else
+  {
+    score=(int)(stats->value*100);
+  }
+  
+  char pv[BUFFER_SIZE/2];
+  if(stats->line_count>0)
+  {
+    Notation::line_to_coord(engine->thinking_board,stats->lines[0].pv,stats->lines[0].pv_length,pv,BUFFER_SIZE/2);
+  }
+  else
+  {
+    Notation::move_to_coord(engine->thinking_board,&(stats->best_move),pv);
+  }
+  
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer,BUFFER_SIZE,"%i %i %i %llu %s",stats->depth,score,(int)(stats->total_time*100),stats->nodes,pv);
+  engine->output_line(buffer);
+}
+
+//read and handle commands from input until quit (or EOF)
+void XboardEngine::run(FILE *input)
+{
+  //reading is unbuffered so that poll knows exactly when there's a command waiting
+  setvbuf(input,NULL,_IONBF,0);
+  
+  char line[XBOARD_LINE_SIZE];
+  while(true)
+  {
+    //the worker made a move and wants to think on the opponent's time
+    if(ponder_pending.load())
+    {
+      ponder_pending.store(false);
+      start_ponder();
+    }
+    
+    struct pollfd fd;
+    fd.fd=fileno(input);
+    fd.events=POLLIN;
+    fd.revents=0;
+    if(poll(&fd,1,XBOARD_POLL_MS)<=0)
+    {
+      continue;
+    }
+    
+    if(fgets(line,XBOARD_LINE_SIZE,input)==NULL)
+    {
+      break;
+    }
+    
+    //trim trailing newline (and carriage return)
+    size_t len=strlen(line);
+    while(len>0 && (line[len-1]=='\n' || line[len-1]=='\r'))
+    {
+      len--;
+      line[len]='\0';
+    }
+    
+    //split off the command name from its arguments
+    char *args=line;
+    while(*args!='\0' && *args!=' ' && *args!='\t')
+    {
+      args++;
+    }
+    if(*args!='\0')
+    {
+      *args='\0';
+      args++;
+    }
+    
+    if(!strcmp(line,"protover"))
+    {
+      char buffer[BUFFER_SIZE];
+      snprintf(buffer,BUFFER_SIZE,"feature myname=\"%s\" usermove=1 setboard=1 ping=1 sigint=0 sigterm=0 colors=0 analyze=0 done=1",engine_name);
+      output_line(buffer);
+    }
+    else if(!strcmp(line,"new"))
+    {
+      stop_search();
+      delete start_board;
+      start_board=new Board();
+      start_player_id=WHITE;
+      new_game();
+    }
+    //setboard <fen>; the game starts over from there
+    else if(!strcmp(line,"setboard"))
+    {
+      stop_search();
+      Board *fen_board=new Board();
+      int fen_player_id;
+      if(fen_board->from_fen(args,&fen_player_id))
+      {
+        delete start_board;
+        start_board=fen_board;
+        start_player_id=fen_player_id;
+        
+        //unlike new, setboard leaves force mode, the side we play, and the depth limit alone
+        bool was_force_mode=force_mode;
+        int was_engine_side=engine_side;
+        int was_depth_limit=depth_limit;
+        new_game();
+        force_mode=was_force_mode;
+        engine_side=was_engine_side;
+        depth_limit=was_depth_limit;
+      }
+      else
+      {
+        delete fen_board;
+        output_line("tellusererror Illegal position");
+      }
+    }
+    else if(!strcmp(line,"usermove"))
+    {
+      user_move(args);
+    }
+    else if(!strcmp(line,"go"))
+    {
+      stop_search();
+      force_mode=false;
+      engine_side=player_id;
+      think();
+    }
+    else if(!strcmp(line,"playother"))
+    {
+      stop_search();
+      force_mode=false;
+      engine_side=!player_id;
+      ponder_pending.store(ponder);
+    }
+    else if(!strcmp(line,"force") || !strcmp(line,"result"))
+    {
+      stop_search();
+      force_mode=true;
+    }
+    //move now
+    else if(!strcmp(line,"?"))
+    {
+      if(!pondering.load())
+      {
+        searcher.get_clock()->stop();
+      }
+    }
+    else if(!strcmp(line,"undo"))
+    {
+      stop_search();
+      undo_moves(1);
+    }
+    else if(!strcmp(line,"remove"))
+    {
+      stop_search();
+      undo_moves(2);
+    }
+    //level <moves per control> <base time in minutes, or minutes:seconds> <increment in seconds>
+    else if(!strcmp(line,"level"))
+    {
+      int moves=0;
+      char base[BUFFER_SIZE];
+      double inc=0;
+      if(sscanf(args,"%i %1023s %lf",&moves,base,&inc)==3)
+      {
+        level_moves=moves;
+        int minutes=0;
+        int seconds=0;
+        sscanf(base,"%i:%i",&minutes,&seconds);
+        level_base=(minutes*60)+seconds;
+        level_increment=inc;
+        fixed_move_time=-1;
+        time_left=-1;
+      }
+    }
+    else if(!strcmp(line,"st"))
+    {
+      fixed_move_time=atof(args);
+    }
+    else if(!strcmp(line,"sd"))
+    {
+      depth_limit=atoi(args);
+    }
+    //our clock, in centiseconds
+    else if(!strcmp(line,"time"))
+    {
+      time_left=atof(args)/100.0;
+    }
+    else if(!strcmp(line,"post"))
+    {
+      post=true;
+    }
+    else if(!strcmp(line,"nopost"))
+    {
+      post=false;
+    }
+    else if(!strcmp(line,"hard"))
+    {
+      ponder=true;
+    }
+    else if(!strcmp(line,"easy"))
+    {
+      ponder=false;
+      if(pondering.load())
+      {
+        stop_search();
+      }
+    }
+    else if(!strcmp(line,"ping"))
+    {
+      char buffer[BUFFER_SIZE];
+      snprintf(buffer,BUFFER_SIZE,"pong %.200s",args);
+      output_line(buffer);
+    }
+    else if(!strcmp(line,"quit"))
+    {
+      break;
+    }
+    //things we get told but don't need to do anything about
+    else if(!strcmp(line,"xboard") || !strcmp(line,"otim") || !strcmp(line,"accepted") || !strcmp(line,"rejected") || !strcmp(line,"computer") || !strcmp(line,"random") || !strcmp(line,"name") || !strcmp(line,"ics") || !strcmp(line,"draw") || !strcmp(line,"hint") || !strcmp(line,"bk") || !strcmp(line,"white") || !strcmp(line,"black") || strlen(line)==0)
+    {
+    }
+    //protocol version 1 sends moves without usermove in front of them
+    else if(strlen(line)>=4 && strlen(line)<=5 && isdigit(line[1]) && isdigit(line[3]))
+    {
+      user_move(line);
+    }
+    else
+    {
+      char buffer[BUFFER_SIZE];
+      snprintf(buffer,BUFFER_SIZE,"Error (unknown command): %.200s",line);
+      output_line(buffer);
+    }
+  }
+  
+  stop_search();
+}
+
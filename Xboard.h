@@ -0,0 +1,120 @@
+
+#ifndef XBOARD_H
+#define XBOARD_H
+
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include "Board.h"
+#include "AI.h"
+#include "SearchThread.h"
+#include "SearchStats.h"
+#include "Notation.h"
+
+using namespace std;
+
+//the longest command line we'll read
+#define XBOARD_LINE_SIZE 4096
+//how deep a ponder search (which has no time limit) is allowed to look; in practice it's stopped long before this
+#define XBOARD_MAX_DEPTH 100
+//how often (in milliseconds) the command loop looks for things to do besides reading commands (like starting to ponder)
+#define XBOARD_POLL_MS 10
+
+//plays as an engine under XBoard/WinBoard or anything else speaking the Chess Engine Communication Protocol (version 2) on stdin/stdout
+//
+//commands are read on the main thread and searches run on a worker thread (see SearchThread), so ? and force are handled while thinking
+//when pondering is on (hard), after every move we make we guess the opponent's reply and think about our answer to it on their time
+//if they play what we guessed the search keeps going and just gets a time limit; otherwise it's thrown away
+class XboardEngine
+{
+private:
+  //what to call ourselves in the myname feature
+  const char *engine_name;
+  
+  //the game so far; the position it started from, the position now, and whose move it is
+  //(the moves themselves are remembered by ai, which also uses them to find repetition)
+  Board *start_board;
+  int start_player_id;
+  Board *board;
+  int player_id;
+  //this is locked whenever the board (or ai's move history) changes, since the worker thread makes our moves
+  mutex board_lock;
+  
+  //the AI whose settings are used to search
+  AI *ai;
+  SearchThread searcher;
+  
+  //which side we play, and whether we're in force mode (playing neither side, just keeping track of moves)
+  int engine_side;
+  bool force_mode;
+  //whether to print thinking output, and whether to ponder
+  bool post;
+  bool ponder;
+  
+  //time controls; level gives moves per control (0 for the whole game), base time and increment, all in seconds
+  int level_moves;
+  double level_base;
+  double level_increment;
+  //st gives a fixed time per move (negative when not set), and sd a depth limit (0 when not set)
+  double fixed_move_time;
+  int depth_limit;
+  //what's on our clock, from the time command (negative before we've been told)
+  double time_left;
+  
+  //set while a ponder search is running that hasn't been resolved by the opponent's move yet
+  atomic<bool> pondering;
+  //the reply we're pondering on
+  _Move ponder_move;
+  //set when the opponent played ponder_move and the search is carrying on; the move is only remembered by ai once the search is done
+  //(the search read ai's move history when it started, so it can't change under it)
+  bool ponder_hit;
+  //set when a search is stopped and shouldn't make its move (force, new, etc.)
+  atomic<bool> abandoned;
+  //the position the worker thread is searching, for writing out its moves
+  Board *thinking_board;
+  //set by the worker thread after it moves, to have the main thread start a ponder search
+  atomic<bool> ponder_pending;
+  
+  //the main thread and the worker both write to stdout, so lines go out one at a time under this lock
+  mutex output_lock;
+  void output_line(const char *line);
+  
+  //start a new game from start_board
+  void new_game();
+  //put the board back to the start and replay all but the last undo_count moves
+  void undo_moves(int undo_count);
+  
+  //apply a move in coordinate notation for whoever's at play; false if it's not legal
+  bool play_move(const char *text);
+  //the opponent moved (usermove); resolves any ponder search and starts thinking if it's our move
+  void user_move(const char *text);
+  
+  //the limits to search with for the current position, from the time controls
+  void search_limits(int *search_depth, bool *time_limited, double *time_remaining, double *increment, int *moves_to_go, bool *fixed_time);
+  //start thinking about our move in the current position
+  void think();
+  //guess the opponent's reply and think about our answer to it
+  void start_ponder();
+  //stop any search, throwing away its result
+  void stop_search();
+  //remember the opponent's move from a ponder hit, now that the search is done with the move history
+  void finish_ponder_hit();
+  
+  //print a result if the game is over in the current position; true if it was
+  bool check_game_over();
+  
+  //called on the worker thread when a search is done, to make the move
+  static void search_done(_Move *move, Board *root, void *done_data);
+  //called after every search iteration to print thinking output
+  static void output_thinking(_SearchStats *stats, void *hook_data);
+
+public:
+  XboardEngine(const char *name);
+  ~XboardEngine();
+  
+  //read and handle commands from input until quit (or EOF)
+  void run(FILE *input);
+};
+
+#endif
+
@@ -4,6 +4,14 @@
 #include "Board.h"
 #include "AI.h"
 #include "TreeSearch.h"
+#include "Uci.h"
+#include "Xboard.h"
+#include "EpdRunner.h"
+#include "MatchRunner.h"
+#include "OpeningBook.h"
+#include "Tablebase.h"
+#include "GameStore.h"
+#include "Pgn.h"
 #define VERSION "1.0"
 
 //this is able to play a very configured AI against another very configured AI, either black or white for both user and AI
@@ -12,6 +20,57 @@ int main(int argc, char *argv[])
   char save_file[BUFFER_SIZE];
   strncpy(save_file,"",BUFFER_SIZE);
   
+  //settings for each player, from files and from --set (which applies to both players, after the files)
+  //giving any of these skips the configuration prompts
+  char white_config[BUFFER_SIZE];
+  strncpy(white_config,"",BUFFER_SIZE);
+  char black_config[BUFFER_SIZE];
+  strncpy(black_config,"",BUFFER_SIZE);
+  vector<char*> set_options;
+  bool dump_config=false;
+  
+  //batch mode settings; an EPD file to run, and the limits for each search in it
+  char epd_file[BUFFER_SIZE];
+  strncpy(epd_file,"",BUFFER_SIZE);
+  double batch_time=5.0;
+  int batch_depth=0;
+  unsigned int batch_threads=0;
+  
+  //match mode settings; how many games, each side's settings file, and where the games start
+  int match_games=0;
+  char config_a[BUFFER_SIZE];
+  strncpy(config_a,"",BUFFER_SIZE);
+  char config_b[BUFFER_SIZE];
+  strncpy(config_b,"",BUFFER_SIZE);
+  char openings_file[BUFFER_SIZE];
+  strncpy(openings_file,"",BUFFER_SIZE);
+  //a game store to keep the games in
+  char games_file[BUFFER_SIZE];
+  strncpy(games_file,"",BUFFER_SIZE);
+  
+  //a game store to print out, and which game (0 for all of them)
+  char dump_games_file[BUFFER_SIZE];
+  strncpy(dump_games_file,"",BUFFER_SIZE);
+  int dump_game=0;
+  //a PGN file to write them to instead
+  char export_pgn_file[BUFFER_SIZE];
+  strncpy(export_pgn_file,"",BUFFER_SIZE);
+  
+  //book making settings; the book to write, the games to make it from, and how far into each game to go
+  char book_out_file[BUFFER_SIZE];
+  strncpy(book_out_file,"",BUFFER_SIZE);
+  vector<const char*> pgn_files;
+  int book_plies=BOOK_DEFAULT_PLIES;
+  
+  //where to write endgame tables, when making them
+  char tables_dir[BUFFER_SIZE];
+  strncpy(tables_dir,"",BUFFER_SIZE);
+  //Syzygy tables to check against our own tables
+  char verify_syzygy_dir[BUFFER_SIZE];
+  strncpy(verify_syzygy_dir,"",BUFFER_SIZE);
+  char verify_tables_dir[BUFFER_SIZE];
+  strncpy(verify_tables_dir,"",BUFFER_SIZE);
+  
   //command line arguments, only for help text and loading save files
   int arg_idx;
   for(arg_idx=1;arg_idx<argc;arg_idx++)
@@ -27,6 +86,24 @@ int main(int argc, char *argv[])
       exit(0);
     }
     
+    //run as an engine for a GUI or tournament manager instead of an interactive game
+    if(!strcmp(argv[arg_idx],"--uci"))
+    {
+      UciEngine *engine=new UciEngine("foochess " VERSION);
+      engine->run(stdin);
+      delete engine;
+      exit(0);
+    }
+    
+    //the same, for a GUI speaking the xboard/winboard protocol
+    if(!strcmp(argv[arg_idx],"--xboard"))
+    {
+      XboardEngine *engine=new XboardEngine("foochess " VERSION);
+      engine->run(stdin);
+      delete engine;
+      exit(0);
+    }
+    
     //add an argument to allow a user to import a board state into the starting point of a game
     //via a board state text file (.bst)
     //thus providing a sort of crude save/load functionality
@@ -40,6 +117,267 @@ int main(int argc, char *argv[])
       }
       strncpy(save_file,argv[arg_idx],BUFFER_SIZE);
     }
+    
+    //run a test suite from an EPD file instead of playing a game
+    if(!strcmp(argv[arg_idx],"--epd"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing .epd file argument for --epd\n");
+        exit(1);
+      }
+      strncpy(epd_file,argv[arg_idx],BUFFER_SIZE);
+    }
+    
+    //configure players without the prompts
+    if(!strcmp(argv[arg_idx],"--white-config") || !strcmp(argv[arg_idx],"--black-config"))
+    {
+      char *config=(argv[arg_idx][2]=='w')? white_config : black_config;
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing options file argument for %s\n",argv[arg_idx-1]);
+        exit(1);
+      }
+      strncpy(config,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--set"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing variable=value argument for --set\n");
+        exit(1);
+      }
+      set_options.push_back(argv[arg_idx]);
+    }
+    //print the settings the players would use, and exit
+    if(!strcmp(argv[arg_idx],"--dump-config"))
+    {
+      dump_config=true;
+    }
+    
+    //play games between two configurations instead of an interactive game
+    if(!strcmp(argv[arg_idx],"--match"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing game count argument for --match\n");
+        exit(1);
+      }
+      match_games=atoi(argv[arg_idx]);
+    }
+    if(!strcmp(argv[arg_idx],"--config-a") || !strcmp(argv[arg_idx],"--config-b"))
+    {
+      char *config=(argv[arg_idx][9]=='a')? config_a : config_b;
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing options file argument for %s\n",argv[arg_idx-1]);
+        exit(1);
+      }
+      strncpy(config,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--openings"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing file argument for --openings\n");
+        exit(1);
+      }
+      strncpy(openings_file,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--games"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing game store argument for --games\n");
+        exit(1);
+      }
+      strncpy(games_file,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--dump-games"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing game store argument for --dump-games\n");
+        exit(1);
+      }
+      strncpy(dump_games_file,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--game"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing game number argument for --game\n");
+        exit(1);
+      }
+      dump_game=atoi(argv[arg_idx]);
+    }
+    if(!strcmp(argv[arg_idx],"--export-pgn"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing .pgn file argument for --export-pgn\n");
+        exit(1);
+      }
+      strncpy(export_pgn_file,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--make-book"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing book file argument for --make-book\n");
+        exit(1);
+      }
+      strncpy(book_out_file,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--pgn"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing .pgn file argument for --pgn\n");
+        exit(1);
+      }
+      pgn_files.push_back(argv[arg_idx]);
+    }
+    if(!strcmp(argv[arg_idx],"--book-plies"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing ply count argument for --book-plies\n");
+        exit(1);
+      }
+      book_plies=atoi(argv[arg_idx]);
+    }
+    if(!strcmp(argv[arg_idx],"--make-tables"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing directory argument for --make-tables\n");
+        exit(1);
+      }
+      strncpy(tables_dir,argv[arg_idx],BUFFER_SIZE);
+    }
+    if(!strcmp(argv[arg_idx],"--verify-syzygy"))
+    {
+      arg_idx+=2;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing directory arguments for --verify-syzygy (Syzygy tables, then our own tables)\n");
+        exit(1);
+      }
+      strncpy(verify_syzygy_dir,argv[arg_idx-1],BUFFER_SIZE);
+      strncpy(verify_tables_dir,argv[arg_idx],BUFFER_SIZE);
+    }
+    
+    //limits for batch searches; seconds per search, or a depth (which turns off the time limit)
+    if(!strcmp(argv[arg_idx],"--movetime"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing seconds argument for --movetime\n");
+        exit(1);
+      }
+      batch_time=atof(argv[arg_idx]);
+    }
+    if(!strcmp(argv[arg_idx],"--depth"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing depth argument for --depth\n");
+        exit(1);
+      }
+      batch_depth=atoi(argv[arg_idx]);
+      batch_time=0;
+    }
+    
+    //how many searches to run at once in batch modes (0 for one per core)
+    if(!strcmp(argv[arg_idx],"--threads"))
+    {
+      arg_idx++;
+      if(argc<=arg_idx)
+      {
+        fprintf(stderr,"Err: Missing count argument for --threads\n");
+        exit(1);
+      }
+      batch_threads=atoi(argv[arg_idx]);
+    }
+  }
+  
+  if(strlen(book_out_file)>0)
+  {
+    if(pgn_files.empty())
+    {
+      fprintf(stderr,"Err: --make-book needs at least one --pgn file\n");
+      exit(1);
+    }
+    exit(OpeningBook::build(book_out_file,pgn_files,book_plies)? 0 : 1);
+  }
+  
+  if(strlen(dump_games_file)>0)
+  {
+    if(strlen(export_pgn_file)>0)
+    {
+      exit(Pgn::export_games(dump_games_file,dump_game,export_pgn_file)? 0 : 1);
+    }
+    exit(GameStore::dump(dump_games_file,dump_game)? 0 : 1);
+  }
+  
+  //PGN files without --make-book go into a game store
+  if(!pgn_files.empty() && strlen(games_file)>0 && match_games==0)
+  {
+    exit(Pgn::import_games(pgn_files,games_file)? 0 : 1);
+  }
+  
+  if(strlen(tables_dir)>0)
+  {
+    exit(Tablebase::generate(tables_dir,batch_threads)? 0 : 1);
+  }
+  
+  if(strlen(verify_syzygy_dir)>0)
+  {
+    exit(Syzygy::verify(verify_syzygy_dir,verify_tables_dir,10000)? 0 : 1);
+  }
+  
+  if(strlen(epd_file)>0)
+  {
+    EpdRunner *runner=new EpdRunner(batch_time,batch_depth,batch_threads);
+    for(size_t i=0; i<set_options.size(); i++)
+    {
+      runner->add_option(set_options[i]);
+    }
+    bool success=runner->run(epd_file);
+    delete runner;
+    exit(success? 0 : 1);
+  }
+  
+  if(match_games>0)
+  {
+    MatchRunner *runner=new MatchRunner(match_games,batch_time,batch_depth,batch_threads);
+    runner->set_config_a(config_a);
+    runner->set_config_b(config_b);
+    for(size_t i=0; i<set_options.size(); i++)
+    {
+      runner->add_option(set_options[i]);
+    }
+    bool success=(strlen(openings_file)==0 || runner->load_openings(openings_file));
+    success=success && (strlen(games_file)==0 || runner->set_game_store(games_file)) && runner->run();
+    delete runner;
+    exit(success? 0 : 1);
   }
   
   //make a board to play on
@@ -63,9 +401,54 @@ int main(int argc, char *argv[])
   //by default, white player is a human
   white_player->set_algo(USER);
   
-  //display options, allow user to set them
-  white_player->configure(WHITE);
-  black_player->configure(BLACK);
+  //settings given on the command line
+  bool configured=false;
+  if(strlen(white_config)>0)
+  {
+    if(!white_player->load_options(white_config))
+    {
+      exit(1);
+    }
+    configured=true;
+  }
+  if(strlen(black_config)>0)
+  {
+    if(!black_player->load_options(black_config))
+    {
+      exit(1);
+    }
+    configured=true;
+  }
+  for(size_t i=0; i<set_options.size(); i++)
+  {
+    bool valid=white_player->set_ts_assignment(set_options[i]);
+    valid=black_player->set_ts_assignment(set_options[i]) && valid;
+    if(!valid)
+    {
+      exit(1);
+    }
+    configured=true;
+  }
+  
+  //show what the settings ended up as, in the same format as an options file
+  if(dump_config || configured)
+  {
+    printf("# White player\n");
+    white_player->output_ts_config(stdout);
+    printf("# Black player\n");
+    black_player->output_ts_config(stdout);
+    printf("\n");
+    if(dump_config)
+    {
+      exit(0);
+    }
+  }
+  //otherwise display options, allow user to set them
+  else
+  {
+    white_player->configure(WHITE);
+    black_player->configure(BLACK);
+  }
   
   bool game_over=false;
   int winner=WHITE;